@@ -105,6 +105,13 @@
 #define SQL_DEFAULT_CONNECTION_TIMEOUT 30
 
 
+/**
+ * Default borrow wait in milliseconds above which the reaper thread grows
+ * an autoscaling ConnectionPool
+ */
+#define SQL_DEFAULT_AUTOSCALE_WAIT 10
+
+
 /**
  * Default TCP/IP Connection timeout in seconds, used when connecting to
  * a database server over a TCP/IP connection
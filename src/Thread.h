@@ -58,6 +58,7 @@
 #define Mutex_init(mutex) wrapper(pthread_mutex_init(&mutex, NULL))
 #define Mutex_destroy(mutex) wrapper(pthread_mutex_destroy(&mutex))
 #define Mutex_lock(mutex) wrapper(pthread_mutex_lock(&mutex))
+#define Mutex_trylock(mutex) pthread_mutex_trylock(&mutex)
 #define Mutex_unlock(mutex) wrapper(pthread_mutex_unlock(&mutex))
 #define LOCK(mutex) do { Mutex_T *_yymutex=&(mutex); \
         wrapper(pthread_mutex_lock(_yymutex));
@@ -65,5 +66,6 @@
 #define ThreadData_create(key) wrapper(pthread_key_create(&(key), NULL))
 #define ThreadData_set(key, value) pthread_setspecific((key), (value))
 #define ThreadData_get(key) pthread_getspecific((key))
+#define ThreadData_delete(key) wrapper(pthread_key_delete((key)))
 
 #endif
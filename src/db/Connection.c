@@ -26,7 +26,10 @@
 #include "Config.h"
 
 #include <stdio.h>
+#include <errno.h>
+#include <poll.h>
 #include <stdarg.h>
+#include <sys/socket.h>
 
 #include "URL.h"
 #include "Vector.h"
@@ -48,6 +51,14 @@
 /* ----------------------------------------------------------- Definitions */
 
 
+#define COPY_IN  1
+#define COPY_OUT 2
+
+#define SOCKET_DEAD     0
+#define SOCKET_ALIVE    1
+#define SOCKET_READABLE 2
+
+
 #ifdef HAVE_LIBMYSQLCLIENT
 extern const struct Cop_T mysqlcops;
 #endif
@@ -78,6 +89,21 @@ static const struct Cop_T *cops[] = {
 };
 
 #define T Connection_T
+/* 
+ * A PreparedStatement kept in the statement cache. Entries are on a hash 
+ * chain for lookup by SQL and on a list in least recently used order. An 
+ * entry in use has been handed out since the Connection was last cleared
+ * and is not handed out again or evicted until then.
+ */
+typedef struct Statement_S {
+        char *sql;
+        unsigned hash;
+        int inUse;
+        PreparedStatement_T ps;
+        struct Statement_S *chain;
+        struct Statement_S *prev;
+        struct Statement_S *next;
+} *Statement_T;
 struct Connection_S {
         Cop_T op;
         URL_T url;
@@ -86,11 +112,24 @@ struct Connection_S {
 	int isAvailable;
     int defaultPrefetchRows;
         Vector_T prepared;
+        Statement_T *statements; // Statement cache hash table
+        Statement_T mru;
+        Statement_T lru;
+        int cacheCount;
+        int cacheBuckets;
+        long long cacheHits;
+        long long cacheMisses;
 	int isInTransaction;
-        time_t lastAccessedTime;
+        int isInPipeline;
+        int copy; // COPY_IN or COPY_OUT while a COPY is in progress
+        long long lastAccessed; // milliseconds
         ResultSet_T resultSet;
+        PreparedStatement_T queryStatement; // Statement behind a Connection_executeQueryParams() result
         ConnectionDelegate_T D;
         ConnectionPool_T parent;
+        T next;
+        T prev;
+        void *slot;
 };
 
 
@@ -124,6 +163,214 @@ static void _freePrepared(T C) {
 }
 
 
+/* Close the last query result, it is valid until the next statement on this Connection */
+static void _clearResult(T C) {
+        if (C->resultSet)
+                ResultSet_free(&C->resultSet);
+        if (C->queryStatement) {
+                PreparedStatement_T p = C->queryStatement;
+                C->queryStatement = NULL;
+                Connection_closeStatement(C, p);
+        }
+}
+
+
+/* Set the parameters of a statement prepared for Connection_executeParams() */
+static void _setParams(PreparedStatement_T p, int count, const Param_T *params) {
+        if (count != PreparedStatement_getParameterCount(p))
+                THROW(SQLException, "The statement has %d parameters but %d were given", PreparedStatement_getParameterCount(p), count);
+        for (int i = 0; i < count; i++) {
+                switch (params[i].type) {
+                        case PARAM_NULL:
+                                PreparedStatement_setString(p, i + 1, NULL);
+                                break;
+                        case PARAM_STRING:
+                                PreparedStatement_setString(p, i + 1, params[i].value.data);
+                                break;
+                        case PARAM_INT:
+                                PreparedStatement_setInt(p, i + 1, (int)params[i].value.integer);
+                                break;
+                        case PARAM_LLONG:
+                                PreparedStatement_setLLong(p, i + 1, params[i].value.integer);
+                                break;
+                        case PARAM_DOUBLE:
+                                PreparedStatement_setDouble(p, i + 1, params[i].value.real);
+                                break;
+                        case PARAM_TIMESTAMP:
+                                PreparedStatement_setTimestamp(p, i + 1, (time_t)params[i].value.integer);
+                                break;
+                        case PARAM_BLOB:
+                                PreparedStatement_setBlob(p, i + 1, params[i].value.data, params[i].size);
+                                break;
+                }
+        }
+}
+
+
+/* FNV-1a */
+static inline unsigned _hash(const char *s) {
+        unsigned h = 2166136261u;
+        for (; *s; s++)
+                h = (h ^ (unsigned char)*s) * 16777619u;
+        return h;
+}
+
+
+static void _unlinkStatement(T C, Statement_T s) {
+        if (s->prev)
+                s->prev->next = s->next;
+        else
+                C->mru = s->next;
+        if (s->next)
+                s->next->prev = s->prev;
+        else
+                C->lru = s->prev;
+        s->prev = s->next = NULL;
+}
+
+
+static void _linkStatement(T C, Statement_T s) {
+        s->next = C->mru;
+        if (C->mru)
+                C->mru->prev = s;
+        else
+                C->lru = s;
+        C->mru = s;
+}
+
+
+static Statement_T _findStatement(T C, const char *sql, unsigned hash) {
+        if (C->cacheBuckets)
+                for (Statement_T s = C->statements[hash & (C->cacheBuckets - 1)]; s; s = s->chain)
+                        if (s->hash == hash && Str_isByteEqual(s->sql, sql))
+                                return s;
+        return NULL;
+}
+
+
+static void _removeStatement(T C, Statement_T s) {
+        Statement_T *link = &C->statements[s->hash & (C->cacheBuckets - 1)];
+        while (*link != s)
+                link = &(*link)->chain;
+        *link = s->chain;
+        _unlinkStatement(C, s);
+        PreparedStatement_free(&s->ps);
+        FREE(s->sql);
+        FREE(s);
+        C->cacheCount--;
+}
+
+
+/* Evict the least recently used statement not in use. Returns false if all are in use */
+static int _evictStatement(T C) {
+        for (Statement_T s = C->lru; s; s = s->prev) {
+                if (! s->inUse) {
+                        _removeStatement(C, s);
+                        return true;
+                }
+        }
+        return false;
+}
+
+
+/* Grow the hash table to at least size buckets */
+static void _resizeStatements(T C, int size) {
+        int buckets = 16;
+        while (buckets < size)
+                buckets *= 2;
+        if (buckets <= C->cacheBuckets)
+                return;
+        Statement_T *statements = CALLOC(buckets, sizeof(Statement_T));
+        for (Statement_T s = C->mru; s; s = s->next) {
+                s->chain = statements[s->hash & (buckets - 1)];
+                statements[s->hash & (buckets - 1)] = s;
+        }
+        FREE(C->statements);
+        C->statements = statements;
+        C->cacheBuckets = buckets;
+}
+
+
+static void _freeStatements(T C) {
+        while (C->mru)
+                _removeStatement(C, C->mru);
+        FREE(C->statements);
+        C->cacheBuckets = 0;
+}
+
+
+static PreparedStatement_T _prepare(T C, const char *sql, ...) {
+        va_list ap;
+        va_start(ap, sql);
+        PreparedStatement_T p = C->op->prepareStatement(C->D, sql, ap);
+        va_end(ap);
+        return p;
+}
+
+
+/* Hand out a cached statement for sql or prepare and cache a new one. Takes ownership of sql */
+static PreparedStatement_T _prepareCached(T C, char *sql, int size) {
+        unsigned hash = _hash(sql);
+        Statement_T s = _findStatement(C, sql, hash);
+        if (s && ! s->inUse) {
+                C->cacheHits++;
+                s->inUse = true;
+                _unlinkStatement(C, s);
+                _linkStatement(C, s);
+                FREE(sql);
+                return s->ps;
+        }
+        C->cacheMisses++;
+        PreparedStatement_T p = _prepare(C, "%s", sql);
+        if (p) {
+                while (C->cacheCount >= size && _evictStatement(C)) ;
+                if (! s && C->cacheCount < size) {
+                        _resizeStatements(C, size);
+                        NEW(s);
+                        s->sql = sql;
+                        s->hash = hash;
+                        s->inUse = true;
+                        s->ps = p;
+                        PreparedStatement_setCached(p);
+                        s->chain = C->statements[hash & (C->cacheBuckets - 1)];
+                        C->statements[hash & (C->cacheBuckets - 1)] = s;
+                        _linkStatement(C, s);
+                        C->cacheCount++;
+                        return p;
+                }
+                // The statement is already in use or the cache is full of statements in use
+                Vector_push(C->prepared, p);
+        }
+        FREE(sql);
+        return p;
+}
+
+
+/* 
+ * Check without blocking if the server closed or reset an idle connection.
+ * Data waiting to be read on an idle connection is suspect. Servers send an
+ * error before they close a terminated or timed out session, so the caller
+ * must ping the server to find out. The data is left alone.
+ */
+static int _checkSocket(int socket) {
+        char c;
+        struct pollfd fds = {.fd = socket, .events = POLLIN};
+        int r = poll(&fds, 1, 0);
+        if (r == 0)
+                return SOCKET_ALIVE;
+        if (r < 0)
+                return (errno == EINTR) ? SOCKET_ALIVE : SOCKET_DEAD;
+        if (fds.revents & (POLLERR | POLLHUP | POLLNVAL))
+                return SOCKET_DEAD;
+        do
+                r = (int)recv(socket, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+        while (r < 0 && errno == EINTR);
+        if (r > 0)
+                return SOCKET_READABLE;
+        return (r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) ? SOCKET_ALIVE : SOCKET_DEAD;
+}
+
+
 #ifdef PACKAGE_PROTECTED
 #pragma GCC visibility push(hidden)
 #endif
@@ -142,7 +389,7 @@ T Connection_new(void *pool, char **error) {
         C->prepared = Vector_new(4);
         C->timeout = SQL_DEFAULT_TIMEOUT;
         C->url = ConnectionPool_getURL(pool);
-        C->lastAccessedTime = Time_now();
+        C->lastAccessed = Time_milli();
         if (! _setDelegate(C, error))
                 Connection_free(&C);
 	return C;
@@ -152,6 +399,7 @@ T Connection_new(void *pool, char **error) {
 void Connection_free(T *C) {
         assert(C && *C);
         Connection_clear((*C));
+        _freeStatements((*C));
         Vector_free(&(*C)->prepared);
         if ((*C)->D)
                 (*C)->op->free(&(*C)->D);
@@ -162,7 +410,7 @@ void Connection_free(T *C) {
 void Connection_setAvailable(T C, int isAvailable) {
         assert(C);
         C->isAvailable = isAvailable;
-        C->lastAccessedTime = Time_now();
+        C->lastAccessed = Time_milli();
 }
 
 
@@ -174,7 +422,39 @@ int Connection_isAvailable(T C) {
 
 time_t Connection_getLastAccessedTime(T C) {
         assert(C);
-        return C->lastAccessedTime;
+        return (time_t)(C->lastAccessed / 1000);
+}
+
+
+long long Connection_getLastAccessedMilli(T C) {
+        assert(C);
+        return C->lastAccessed;
+}
+
+
+int Connection_validate(T C) {
+        assert(C);
+        int socket = C->op->getSocket ? C->op->getSocket(C->D) : -1;
+        if (socket < 0)
+                return Connection_ping(C);
+        switch (_checkSocket(socket)) {
+                case SOCKET_ALIVE:
+                        return true;
+                case SOCKET_READABLE:
+                        return Connection_ping(C);
+                default:
+                        return false;
+        }
+}
+
+
+int Connection_hasStatement(T C, const char *sql) {
+        assert(C);
+        assert(sql);
+        if (! C->cacheCount)
+                return false;
+        Statement_T s = _findStatement(C, sql, _hash(sql));
+        return (s && ! s->inUse);
 }
 
 
@@ -183,6 +463,42 @@ int Connection_isInTransaction(T C) {
         return (C->isInTransaction > 0);
 }
 
+
+void Connection_setNext(T C, T next) {
+        assert(C);
+        C->next = next;
+}
+
+
+T Connection_getNext(T C) {
+        assert(C);
+        return C->next;
+}
+
+
+void Connection_setPrev(T C, T prev) {
+        assert(C);
+        C->prev = prev;
+}
+
+
+T Connection_getPrev(T C) {
+        assert(C);
+        return C->prev;
+}
+
+
+void Connection_setSlot(T C, void *slot) {
+        assert(C);
+        C->slot = slot;
+}
+
+
+void *Connection_getSlot(T C) {
+        assert(C);
+        return C->slot;
+}
+
 #ifdef PACKAGE_PROTECTED
 #pragma GCC visibility pop
 #endif
@@ -222,7 +538,8 @@ void Connection_setDefaultRowPrefetch(T C, int prefetch_rows)
 {
         assert(C);
         C->defaultPrefetchRows = prefetch_rows;
-        C->op->setDefaultRowPrefetch(C->D, prefetch_rows);
+        if (C->op->setDefaultRowPrefetch)
+                C->op->setDefaultRowPrefetch(C->D, prefetch_rows);
 }
 
 
@@ -250,13 +567,38 @@ int Connection_ping(T C) {
 
 void Connection_clear(T C) {
         assert(C);
-        if (C->resultSet)
-                ResultSet_free(&C->resultSet);
+        if (C->copy) {
+                TRY
+                {
+                        int size;
+                        if (C->copy == COPY_IN)
+                                Connection_abortCopyIn(C, "COPY was not ended before the Connection was returned");
+                        else
+                                while (Connection_getCopyData(C, &size)) ;
+                }
+                ELSE
+                        DEBUG("Failed to end COPY -- %s\n", Exception_frame.message);
+                END_TRY;
+        }
+        if (C->isInPipeline) {
+                TRY
+                        Connection_endPipeline(C);
+                ELSE
+                        DEBUG("Failed to end pipeline -- %s\n", Exception_frame.message);
+                END_TRY;
+        }
+        _clearResult(C);
         if (C->maxRows)
                 Connection_setMaxRows(C, 0);
+        if (C->defaultPrefetchRows)
+                Connection_setDefaultRowPrefetch(C, 0);
         if (C->timeout != SQL_DEFAULT_TIMEOUT)
                 Connection_setQueryTimeout(C, SQL_DEFAULT_TIMEOUT);
         _freePrepared(C);
+        for (Statement_T s = C->mru; s; s = s->next) {
+                PreparedStatement_clear(s->ps);
+                s->inUse = false;
+        }
 }
 
 
@@ -287,8 +629,9 @@ void Connection_commit(T C) {
 void Connection_rollback(T C) {
         assert(C);
         if (C->isInTransaction) {
-                // Clear any pending resultset statements first
-                Connection_clear(C);
+                // Clear any pending resultset statements first. In pipeline mode there are none and the rollback is queued
+                if (! C->isInPipeline)
+                        Connection_clear(C);
                 C->isInTransaction = 0;
         }
         // Even if we are not in a transaction, call the delegate anyway and propagate any errors
@@ -297,6 +640,44 @@ void Connection_rollback(T C) {
 }
 
 
+void Connection_beginPipeline(T C) {
+        assert(C);
+        if (! C->op->beginPipeline)
+                THROW(SQLException, "Pipeline mode is not supported by %s", C->op->name);
+        if (C->isInPipeline)
+                return;
+        _clearResult(C);
+        if (! C->op->beginPipeline(C->D))
+                THROW(SQLException, "%s", Connection_getLastError(C));
+        C->isInPipeline = true;
+}
+
+
+void Connection_syncPipeline(T C) {
+        assert(C);
+        if (! C->isInPipeline)
+                THROW(SQLException, "Connection is not in pipeline mode");
+        if (! C->op->syncPipeline(C->D))
+                THROW(SQLException, "%s", Connection_getLastError(C));
+}
+
+
+void Connection_endPipeline(T C) {
+        assert(C);
+        if (C->isInPipeline) {
+                C->isInPipeline = false;
+                if (! C->op->endPipeline(C->D))
+                        THROW(SQLException, "%s", Connection_getLastError(C));
+        }
+}
+
+
+int Connection_isInPipeline(T C) {
+        assert(C);
+        return C->isInPipeline;
+}
+
+
 long long Connection_lastRowId(T C) {
         assert(C);
         return C->op->lastRowId(C->D);
@@ -312,8 +693,7 @@ long long Connection_rowsChanged(T C) {
 void Connection_execute(T C, const char *sql, ...) {
         assert(C);
         assert(sql);
-        if (C->resultSet)
-                ResultSet_free(&C->resultSet);
+        _clearResult(C);
         va_list ap;
 	va_start(ap, sql);
         int success = C->op->execute(C->D, sql, ap);
@@ -325,8 +705,9 @@ void Connection_execute(T C, const char *sql, ...) {
 ResultSet_T Connection_executeQuery(T C, const char *sql, ...) {
         assert(C);
         assert(sql);
-        if (C->resultSet)
-                ResultSet_free(&C->resultSet);
+        if (C->isInPipeline)
+                THROW(SQLException, "Connection_executeQuery() cannot be used in pipeline mode");
+        _clearResult(C);
         va_list ap;
 	va_start(ap, sql);
         C->resultSet = C->op->executeQuery(C->D, sql, ap);
@@ -337,21 +718,204 @@ ResultSet_T Connection_executeQuery(T C, const char *sql, ...) {
 }
 
 
+long long Connection_executeParams(T C, const char *sql, int count, const Param_T *params) {
+        assert(C);
+        assert(sql);
+        assert(count == 0 || params);
+        _clearResult(C);
+        if (C->op->executeParams && ! Connection_hasStatement(C, sql)) {
+                if (! C->op->executeParams(C->D, sql, count, params))
+                        THROW(SQLException, "%s", Connection_getLastError(C));
+                return C->op->rowsChanged(C->D);
+        }
+        long long rows = 0;
+        PreparedStatement_T p = Connection_prepareStatement(C, "%s", sql);
+        TRY
+        {
+                _setParams(p, count, params);
+                PreparedStatement_execute(p);
+                rows = PreparedStatement_rowsChanged(p);
+        }
+        ELSE
+        {
+                Connection_closeStatement(C, p);
+                THROW(SQLException, "%s", Exception_frame.message);
+        }
+        END_TRY;
+        Connection_closeStatement(C, p);
+        return rows;
+}
+
+
+ResultSet_T Connection_executeQueryParams(T C, const char *sql, int count, const Param_T *params) {
+        assert(C);
+        assert(sql);
+        assert(count == 0 || params);
+        if (C->isInPipeline)
+                THROW(SQLException, "Connection_executeQueryParams() cannot be used in pipeline mode");
+        _clearResult(C);
+        if (C->op->executeQueryParams && ! Connection_hasStatement(C, sql)) {
+                C->resultSet = C->op->executeQueryParams(C->D, sql, count, params);
+                if (! C->resultSet)
+                        THROW(SQLException, "%s", Connection_getLastError(C));
+                return C->resultSet;
+        }
+        ResultSet_T r = NULL;
+        PreparedStatement_T p = Connection_prepareStatement(C, "%s", sql);
+        TRY
+        {
+                _setParams(p, count, params);
+                r = PreparedStatement_executeQuery(p);
+        }
+        ELSE
+        {
+                Connection_closeStatement(C, p);
+                THROW(SQLException, "%s", Exception_frame.message);
+        }
+        END_TRY;
+        // The ResultSet belongs to the statement which is closed with the result
+        C->queryStatement = p;
+        return r;
+}
+
+
+void Connection_copyIn(T C, const char *sql, ...) {
+        assert(C);
+        assert(sql);
+        if (! C->op->copyIn)
+                THROW(SQLException, "COPY is not supported by %s", C->op->name);
+        if (C->copy)
+                THROW(SQLException, "A COPY is already in progress");
+        _clearResult(C);
+        va_list ap;
+        va_start(ap, sql);
+        int success = C->op->copyIn(C->D, sql, ap);
+        va_end(ap);
+        if (! success)
+                THROW(SQLException, "%s", Connection_getLastError(C));
+        C->copy = COPY_IN;
+}
+
+
+void Connection_putCopyData(T C, const void *data, int size) {
+        assert(C);
+        assert(data);
+        if (C->copy != COPY_IN)
+                THROW(SQLException, "Connection_copyIn() was not called");
+        if (! C->op->putCopyData(C->D, data, size))
+                THROW(SQLException, "%s", Connection_getLastError(C));
+}
+
+
+long long Connection_endCopyIn(T C) {
+        assert(C);
+        if (C->copy != COPY_IN)
+                THROW(SQLException, "Connection_copyIn() was not called");
+        C->copy = 0;
+        long long rows = C->op->endCopyIn(C->D, NULL);
+        if (rows < 0)
+                THROW(SQLException, "%s", Connection_getLastError(C));
+        return rows;
+}
+
+
+void Connection_abortCopyIn(T C, const char *error) {
+        assert(C);
+        assert(error);
+        if (C->copy == COPY_IN) {
+                C->copy = 0;
+                C->op->endCopyIn(C->D, error);
+        }
+}
+
+
+void Connection_copyOut(T C, const char *sql, ...) {
+        assert(C);
+        assert(sql);
+        if (! C->op->copyOut)
+                THROW(SQLException, "COPY is not supported by %s", C->op->name);
+        if (C->copy)
+                THROW(SQLException, "A COPY is already in progress");
+        _clearResult(C);
+        va_list ap;
+        va_start(ap, sql);
+        int success = C->op->copyOut(C->D, sql, ap);
+        va_end(ap);
+        if (! success)
+                THROW(SQLException, "%s", Connection_getLastError(C));
+        C->copy = COPY_OUT;
+}
+
+
+const void *Connection_getCopyData(T C, int *size) {
+        assert(C);
+        assert(size);
+        const void *data = NULL;
+        if (C->copy != COPY_OUT)
+                THROW(SQLException, "Connection_copyOut() was not called");
+        *size = C->op->getCopyData(C->D, &data);
+        if (*size > 0)
+                return data;
+        C->copy = 0;
+        if (*size < 0)
+                THROW(SQLException, "%s", Connection_getLastError(C));
+        return NULL;
+}
+
+
 PreparedStatement_T Connection_prepareStatement(T C, const char *sql, ...) {
         assert(C);
         assert(sql);
+        PreparedStatement_T p;
         va_list ap;
         va_start(ap, sql);
-        PreparedStatement_T p = C->op->prepareStatement(C->D, sql, ap);
+        int size = ConnectionPool_getStatementCacheSize(C->parent);
+        if (size > 0 || C->cacheCount > 0) {
+                p = _prepareCached(C, Str_vcat(sql, ap), size);
+        } else {
+                p = C->op->prepareStatement(C->D, sql, ap);
+                if (p)
+                        Vector_push(C->prepared, p);
+        }
         va_end(ap);
-        if (p)
-                Vector_push(C->prepared, p);
-        else
+        if (! p)
                 THROW(SQLException, "%s", Connection_getLastError(C));
         return p;
 }
 
 
+void Connection_closeStatement(T C, PreparedStatement_T P) {
+        assert(C);
+        assert(P);
+        for (Statement_T s = C->mru; s; s = s->next) {
+                if (s->ps == P) {
+                        PreparedStatement_clear(P);
+                        s->inUse = false;
+                        return;
+                }
+        }
+        for (int i = Vector_size(C->prepared) - 1; i >= 0; i--) {
+                if (Vector_get(C->prepared, i) == P) {
+                        Vector_remove(C->prepared, i);
+                        PreparedStatement_free(&P);
+                        return;
+                }
+        }
+}
+
+
+long long Connection_getStatementCacheHits(T C) {
+        assert(C);
+        return C->cacheHits;
+}
+
+
+long long Connection_getStatementCacheMisses(T C) {
+        assert(C);
+        return C->cacheMisses;
+}
+
+
 const char *Connection_getLastError(T C) {
 	assert(C);
 	const char *s = C->op->getLastError(C->D);
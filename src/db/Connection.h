@@ -46,6 +46,14 @@
  * to the Connection Pool. If an error occur during execution, an SQLException
  * is thrown.
  *
+ * If the Connection Pool has a statement cache, see 
+ * ConnectionPool_setStatementCacheSize(), PreparedStatements are kept with 
+ * the Connection when it is returned to the pool and
+ * Connection_prepareStatement() hands out the cached statement the next
+ * time the same SQL is prepared on this Connection. A cached statement is
+ * handed out only once per borrow unless it is given back with 
+ * Connection_closeStatement().
+ *
  * Any SQL statement that changes the database (basically, any SQL
  * command other than SELECT) will automatically start a transaction
  * if one is not already in effect. Automatically started transactions
@@ -57,6 +65,46 @@
  * A transaction will also rollback if the database is closed or if an 
  * error occurs. Nested transactions are not allowed.
  *
+ * <h3>Pipeline mode</h3>
+ * On PostgreSQL a Connection can be put in pipeline mode with 
+ * Connection_beginPipeline(). Statements executed with Connection_execute() 
+ * and PreparedStatement_execute(), and also Connection_beginTransaction(),
+ * Connection_commit() and Connection_rollback(), are then only sent to the
+ * server without waiting for their results. Connection_syncPipeline() 
+ * sends everything queued in one flight and reads the results in order,
+ * so a transaction of many statements costs one round trip instead of one
+ * per statement.
+ * <pre>
+ * PreparedStatement_T p = Connection_prepareStatement(con, "INSERT INTO employee(name) VALUES(?)");
+ * Connection_beginPipeline(con);
+ * Connection_beginTransaction(con);
+ * for (int i = 0; employees[i].name; i++) {
+ *        PreparedStatement_setString(p, 1, employees[i].name);
+ *        PreparedStatement_execute(p);
+ * }
+ * Connection_commit(con);
+ * Connection_endPipeline(con);
+ * </pre>
+ * Queries cannot be executed in pipeline mode and statements must be 
+ * prepared before the pipeline is started. 
+ *
+ * <h3>COPY</h3>
+ * On PostgreSQL, bulk data can be streamed in and out of the database with
+ * COPY, which is much faster than INSERT and SELECT for large amounts of 
+ * rows. Connection_copyIn() starts a <code>COPY .. FROM STDIN</code> and
+ * data is pushed with Connection_putCopyData(). Connection_copyOut() starts
+ * a <code>COPY .. TO STDOUT</code> and data is pulled with 
+ * Connection_getCopyData(). Data is in the format selected by the COPY
+ * statement, text, csv or binary, and is passed as-is without copying.
+ * <pre>
+ * Connection_copyIn(con, "COPY employee(name, age) FROM STDIN");
+ * for (int i = 0; employees[i].name; i++) {
+ *        int n = snprintf(row, sizeof(row), "%s\t%d\n", employees[i].name, employees[i].age);
+ *        Connection_putCopyData(con, row, n);
+ * }
+ * long long rows = Connection_endCopyIn(con);
+ * </pre>
+ *
  * <i>A Connection is reentrant, but not thread-safe and should only be used by one thread (at the time).</i>
  *
  * @see ResultSet.h PreparedStatement.h SQLException.h
@@ -112,6 +160,91 @@ int Connection_isAvailable(T C);
 time_t Connection_getLastAccessedTime(T C);
 
 
+/**
+ * Return the last time this Connection was accessed from the Connection Pool
+ * as the number of milliseconds since midnight, January 1, 1970 GMT.
+ * @param C A Connection object
+ * @return The last time (milliseconds) this Connection was accessed
+ */
+long long Connection_getLastAccessedMilli(T C);
+
+
+/**
+ * Check that this Connection is still usable, as cheaply as the database
+ * backend allows. If the backend exposes its socket, a non-blocking poll 
+ * is used to detect if the server closed or reset the connection, without 
+ * a round-trip to the server. If the server sent data to the idle 
+ * Connection, typically an error before it closes a terminated session, or
+ * if the backend has no socket, the Connection is pinged.
+ * @param C A Connection object
+ * @return true if the Connection looks usable otherwise false
+ */
+int Connection_validate(T C);
+
+
+/**
+ * Returns true if the statement cache of this Connection has a statement
+ * for sql that is not handed out. Used by the pool to prefer Connections 
+ * that already prepared a statement.
+ * @param C A Connection object
+ * @param sql The SQL statement as given to Connection_prepareStatement()
+ * @return true if a cached statement for sql is available otherwise false
+ */
+int Connection_hasStatement(T C, const char *sql);
+
+
+/**
+ * Set the next Connection in the Connection Pool's list of idle 
+ * Connections. The link is owned and maintained by the Connection Pool.
+ * @param C A Connection object
+ * @param next The next Connection in the list or NULL
+ */
+void Connection_setNext(T C, T next);
+
+
+/**
+ * Get the next Connection in the Connection Pool's list of idle Connections
+ * @param C A Connection object
+ * @return The next Connection in the list or NULL
+ */
+T Connection_getNext(T C);
+
+
+/**
+ * Set the previous Connection in the Connection Pool's list of idle 
+ * Connections. The link is owned and maintained by the Connection Pool.
+ * @param C A Connection object
+ * @param prev The previous Connection in the list or NULL
+ */
+void Connection_setPrev(T C, T prev);
+
+
+/**
+ * Get the previous Connection in the Connection Pool's list of idle 
+ * Connections
+ * @param C A Connection object
+ * @return The previous Connection in the list or NULL
+ */
+T Connection_getPrev(T C);
+
+
+/**
+ * Set the Connection Pool slot of this Connection. The slot is opaque
+ * to the Connection and is owned and maintained by the Connection Pool.
+ * @param C A Connection object
+ * @param slot The pool slot or NULL
+ */
+void Connection_setSlot(T C, void *slot);
+
+
+/**
+ * Get the Connection Pool slot of this Connection
+ * @param C A Connection object
+ * @return The pool slot or NULL
+ */
+void *Connection_getSlot(T C);
+
+
 //>> End Protected methods
 
 
@@ -168,8 +301,28 @@ void Connection_setMaxRows(T C, int max);
  */
 int Connection_getMaxRows(T C);
 
-//default prefetch rows, name like JDBC
+/**
+ * Sets the number of rows to fetch from the database at a time for
+ * ResultSets and PreparedStatements created by this Connection. 0, the
+ * default, lets the driver decide. On PostgreSQL a value greater than 0 
+ * makes query results stream from the server as ResultSet_next() is 
+ * called, instead of reading the whole result into memory first. A 
+ * streaming ResultSet must be read to the end or closed before the 
+ * Connection can execute another statement. On Oracle it is the number 
+ * of rows fetched into the ResultSet per round trip, 32 if not set. The
+ * value is reset when the Connection is returned to the pool.
+ * @param C A Connection object
+ * @param prefetch_rows The number of rows to fetch at a time
+ */
 void Connection_setDefaultRowPrefetch(T C, int prefetch_rows);
+
+
+/**
+ * Returns the number of rows to fetch at a time set with
+ * Connection_setDefaultRowPrefetch()
+ * @param C A Connection object
+ * @return The number of rows to fetch at a time, 0 if not set
+ */
 int  Connection_getDefaultRowPrefetch(T C);
 
 /**
@@ -193,7 +346,8 @@ int Connection_ping(T C);
 
 
 /**
- * Close any ResultSet and PreparedStatements in the Connection. 
+ * Close any ResultSet and PreparedStatements in the Connection. Statements
+ * in the statement cache are kept, but their ResultSets are closed.
  * Normally it is not necessary to call this method, but for some
  * implementation (SQLite) it <i>may, in some situations,</i> be 
  * necessary to call this method if a execution sequence error occurs.
@@ -251,6 +405,60 @@ void Connection_rollback(T C);
 long long Connection_lastRowId(T C);
 
 
+/** @name Pipeline */
+//@{
+
+/**
+ * Put this Connection in pipeline mode. Until Connection_endPipeline(), 
+ * statements and transaction commands are queued and sent without 
+ * waiting for their results. Only Connection_execute(), 
+ * PreparedStatement_execute(), PreparedStatement_executeBatch() and the
+ * transaction methods can be used in pipeline mode.
+ * @param C A Connection object
+ * @exception SQLException If the database does not support pipeline mode
+ * or a database error occurs
+ * @see SQLException.h
+ */
+void Connection_beginPipeline(T C);
+
+
+/**
+ * Send all queued statements and wait for their results, which are read
+ * in the order the statements were queued. After this call 
+ * Connection_rowsChanged() returns the rows changed by the last statement.
+ * If a statement fails, the statements queued after it are skipped and a 
+ * transaction left aborted by the failure is rolled back. The Connection
+ * stays in pipeline mode.
+ * @param C A Connection object
+ * @exception SQLException If the Connection is not in pipeline mode or if
+ * a queued statement failed. The exception has the error of the first 
+ * failed statement
+ * @see SQLException.h
+ */
+void Connection_syncPipeline(T C);
+
+
+/**
+ * Sync the pipeline as Connection_syncPipeline() and leave pipeline mode.
+ * A pipeline left open is ended when the Connection is returned to the pool.
+ * @param C A Connection object
+ * @exception SQLException If a queued statement failed. The Connection
+ * has left pipeline mode also in this case
+ * @see SQLException.h
+ */
+void Connection_endPipeline(T C);
+
+
+/**
+ * Returns true if this Connection is in pipeline mode
+ * @param C A Connection object
+ * @return true if in pipeline mode, otherwise false
+ */
+int Connection_isInPipeline(T C);
+
+//@}
+
+
 /**
  * Returns the number of rows that was inserted, deleted or modified
  * by the last Connection_execute() statement. If used with a
@@ -299,6 +507,56 @@ void Connection_execute(T C, const char *sql, ...) __attribute__((format (printf
 ResultSet_T Connection_executeQuery(T C, const char *sql, ...) __attribute__((format (printf, 2, 3)));
 
 
+/**
+ * Executes a single SQL statement with IN parameter placeholders, '?',
+ * and the given parameter values, without creating a PreparedStatement
+ * the caller has to manage. On PostgreSQL the statement is sent with its
+ * parameters in one round trip using the unnamed statement. On MySQL the
+ * values are escaped, with the Connection's character set, into the 
+ * statement text which is sent in one round trip instead of the three
+ * needed to prepare, execute and close a server side statement. Other 
+ * databases, and statements already in the statement cache, use a cached 
+ * PreparedStatement.
+ * <pre>
+ * Param_T params[] = {
+ *         {.type = PARAM_INT, .value.integer = 42},
+ *         {.type = PARAM_STRING, .value.data = "Tildeslash"}
+ * };
+ * Connection_executeParams(con, "update employee set age = ? where name = ?", 2, params);
+ * </pre>
+ * @param C A Connection object
+ * @param sql A single SQL statement with IN parameter placeholders
+ * @param count The number of parameters
+ * @param params The parameter values in placeholder order
+ * @return The number of rows changed by the statement
+ * @exception SQLException If a database error occurs or if the number of
+ * parameters does not match the statement
+ * @see SQLException.h
+ */
+long long Connection_executeParams(T C, const char *sql, int count, const Param_T *params);
+
+
+/**
+ * Executes a single SQL query with IN parameter placeholders, '?', and 
+ * the given parameter values. See Connection_executeParams(). On MySQL
+ * values are not inlined in a query; the query runs as a PreparedStatement
+ * with bound parameters, from the statement cache if it is enabled, since
+ * a MySQL ResultSet reads its rows from a server side statement. The 
+ * ResultSet lives as a ResultSet from Connection_executeQuery().
+ * @param C A Connection object
+ * @param sql A single SQL query with IN parameter placeholders
+ * @param count The number of parameters
+ * @param params The parameter values in placeholder order
+ * @return A ResultSet object that contains the data produced by the
+ * given query
+ * @exception SQLException If a database error occurs or if the number of
+ * parameters does not match the statement
+ * @see ResultSet.h
+ * @see SQLException.h
+ */
+ResultSet_T Connection_executeQueryParams(T C, const char *sql, int count, const Param_T *params);
+
+
 /**
  * Creates a PreparedStatement object for sending parameterized SQL 
  * statements to the database. The <code>sql</code> parameter may 
@@ -308,7 +566,10 @@ ResultSet_T Connection_executeQuery(T C, const char *sql, ...) __attribute__((fo
  * setXXX methods. Only <i>one</i> SQL statement may be used in the sql 
  * parameter, this in difference to Connection_execute() which may 
  * take several statements. A PreparedStatement "lives" until the 
- * Connection is returned to the Connection Pool. 
+ * Connection is returned to the Connection Pool or the statement is closed
+ * with Connection_closeStatement(). If the pool has a statement cache, a
+ * PreparedStatement for the same SQL prepared in an earlier borrow and not
+ * yet handed out in this borrow is reused instead of preparing a new one.
  * @param C A Connection object
  * @param sql A single SQL statement that may contain one or more '?' 
  * IN parameter placeholders
@@ -321,6 +582,123 @@ ResultSet_T Connection_executeQuery(T C, const char *sql, ...) __attribute__((fo
 PreparedStatement_T Connection_prepareStatement(T C, const char *sql, ...) __attribute__((format (printf, 2, 3)));
 
 
+/** @name COPY */
+//@{
+
+/**
+ * Start a COPY of data into the database. The SQL statement must be a 
+ * <code>COPY .. FROM STDIN</code>. Push the data with 
+ * Connection_putCopyData() and finish with Connection_endCopyIn(). The 
+ * Connection cannot be used for other statements until the COPY has ended.
+ * @param C A Connection object
+ * @param sql A COPY .. FROM STDIN statement. The SQL string may contain 
+ * variable argument format specifiers as in Connection_execute()
+ * @exception SQLException If the database does not support COPY or a
+ * database error occurs
+ * @see SQLException.h
+ */
+void Connection_copyIn(T C, const char *sql, ...) __attribute__((format (printf, 2, 3)));
+
+
+/**
+ * Send data to a COPY started with Connection_copyIn(). The data is sent
+ * as-is and does not need to be aligned with rows. For a text or csv COPY
+ * it is rows terminated by newline. For a binary COPY it is the PostgreSQL
+ * binary copy stream including its header.
+ * @param C A Connection object
+ * @param data The data to send
+ * @param size The number of bytes in data
+ * @exception SQLException If no COPY is in progress or a database error 
+ * occurs
+ * @see SQLException.h
+ */
+void Connection_putCopyData(T C, const void *data, int size);
+
+
+/**
+ * Finish a COPY started with Connection_copyIn() and wait for the server
+ * to complete it.
+ * @param C A Connection object
+ * @return The number of rows copied into the database
+ * @exception SQLException If no COPY is in progress or if the COPY failed,
+ * e.g. because of malformed data
+ * @see SQLException.h
+ */
+long long Connection_endCopyIn(T C);
+
+
+/**
+ * Abort a COPY started with Connection_copyIn(). The server rolls back 
+ * the COPY with the given error. Does nothing if no COPY is in progress.
+ * A COPY left open is aborted when the Connection is returned to the pool.
+ * @param C A Connection object
+ * @param error The reason for aborting
+ */
+void Connection_abortCopyIn(T C, const char *error);
+
+
+/**
+ * Start a COPY of data out of the database. The SQL statement must be a
+ * <code>COPY .. TO STDOUT</code>. Pull the data with 
+ * Connection_getCopyData() until it returns NULL. 
+ * @param C A Connection object
+ * @param sql A COPY .. TO STDOUT statement. The SQL string may contain 
+ * variable argument format specifiers as in Connection_execute()
+ * @exception SQLException If the database does not support COPY or a
+ * database error occurs
+ * @see SQLException.h
+ */
+void Connection_copyOut(T C, const char *sql, ...) __attribute__((format (printf, 2, 3)));
+
+
+/**
+ * Returns the next buffer of a COPY started with Connection_copyOut(). 
+ * PostgreSQL sends one buffer per row. The buffer is owned by the 
+ * Connection and is valid until the next call to this method.
+ * @param C A Connection object
+ * @param size The number of bytes in the buffer is stored in size
+ * @return The next buffer or NULL when all data was read. After the
+ * last buffer, Connection_rowsChanged() returns the number of rows copied
+ * @exception SQLException If no COPY is in progress or a database error 
+ * occurs
+ * @see SQLException.h
+ */
+const void *Connection_getCopyData(T C, int *size);
+
+//@}
+
+
+/**
+ * Close a PreparedStatement before the Connection is returned to the pool.
+ * A cached statement is given back to the statement cache so the next 
+ * Connection_prepareStatement() for the same SQL in this borrow can reuse 
+ * it, other statements are freed. The statement and its ResultSet must not
+ * be used after this call.
+ * @param C A Connection object
+ * @param P A PreparedStatement from Connection_prepareStatement() on C
+ */
+void Connection_closeStatement(T C, PreparedStatement_T P);
+
+
+/**
+ * Returns the number of times Connection_prepareStatement() reused a 
+ * statement from the statement cache of this Connection
+ * @param C A Connection object
+ * @return The number of statement cache hits
+ */
+long long Connection_getStatementCacheHits(T C);
+
+
+/**
+ * Returns the number of times Connection_prepareStatement() had to 
+ * prepare a statement because it was not in the statement cache of this
+ * Connection or already in use
+ * @param C A Connection object
+ * @return The number of statement cache misses
+ */
+long long Connection_getStatementCacheMisses(T C);
+
+
 /**
  * This method can be used to obtain a string describing the last
  * error that occurred. Inside a CATCH-block you can also find
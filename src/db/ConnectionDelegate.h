@@ -44,8 +44,9 @@ typedef struct Cop_T {
 	void (*free)(T *C);
 	void (*setQueryTimeout)(T C, int ms);
         void (*setMaxRows)(T C, int max);
-        void (*setDefaultRowPrefetch)(T C, int prefetch_rows);
+        void (*setDefaultRowPrefetch)(T C, int prefetch_rows); // Optional
         int (*ping)(T C);
+        int (*getSocket)(T C);
         int (*beginTransaction)(T C);
         int (*commit)(T C);
 	int (*rollback)(T C);
@@ -55,6 +56,19 @@ typedef struct Cop_T {
 	ResultSet_T (*executeQuery)(T C, const char *sql, va_list ap);
         PreparedStatement_T (*prepareStatement)(T C, const char *sql, va_list ap);
         const char *(*getLastError)(T C);
+        // Optional. Execute sql with parameters without preparing a named statement
+        int (*executeParams)(T C, const char *sql, int count, const Param_T *params);
+        ResultSet_T (*executeQueryParams)(T C, const char *sql, int count, const Param_T *params);
+        // Optional. COPY streaming, see Connection_copyIn() and Connection_copyOut()
+        int (*copyIn)(T C, const char *sql, va_list ap);
+        int (*putCopyData)(T C, const void *data, int size);
+        long long (*endCopyIn)(T C, const char *error);
+        int (*copyOut)(T C, const char *sql, va_list ap);
+        int (*getCopyData)(T C, const void **data);
+        // Optional. Pipeline mode, see Connection_beginPipeline()
+        int (*beginPipeline)(T C);
+        int (*syncPipeline)(T C);
+        int (*endPipeline)(T C);
 } *Cop_T;
 
 #undef T
@@ -27,11 +27,14 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <limits.h>
+#include <time.h>
 
 #include "URL.h"
 #include "Thread.h"
 #include "system/Time.h"
 #include "Vector.h"
+#include "StringBuffer.h"
 #include "ResultSet.h"
 #include "PreparedStatement.h"
 #include "Connection.h"
@@ -45,10 +48,53 @@
  */
 
 
+
+
 /* ----------------------------------------------------------- Definitions */
 
 
 #define T ConnectionPool_T
+#define SLOT_FREE 0
+#define SLOT_IDLE 1
+#define SLOT_BUSY 2
+#define FILL_THREADS 8 // Max number of threads opening initial Connections in parallel
+#define STATEMENT_SCAN 8 // Idle Connections per stripe looked at for one with a statement already prepared
+#define AUTOSCALE_CALM 3 // Quiet sweeps in a row before the autoscaler shrinks the pool
+#define AUTOSCALE_HIGH 0.8 // Grow when more than this part of the target is busy
+#define AUTOSCALE_LOW 0.4 // Shrink when less than this part of the target is busy
+/* 
+ * A stripe is a sub-pool with its own lock and list of idle Connections.
+ * A thread returns Connections to, and borrows from, its home stripe and
+ * only steals from the other stripes when its home stripe is empty.
+ */
+typedef struct Stripe_S {
+        Mutex_T mutex;
+        Connection_T head;
+        Connection_T tail;
+        int count;
+} *Stripe_T;
+/*
+ * Every Connection in the pool owns a slot. The slot state is only changed
+ * from SLOT_IDLE with a compare-and-swap so an idle Connection can be taken
+ * either from an idle list or directly from its slot without any lock.
+ * Slots are recycled but never freed while the pool exists, which makes it
+ * safe for a thread to keep a pointer to a slot between calls.
+ */
+typedef struct Slot_S {
+        volatile int state;
+        Connection_T con;
+        Stripe_T volatile stripe; // The idle list con is linked on or NULL
+        long long borrowed; // Microseconds, when con was handed out or 0 if statistics were off
+        struct Slot_S *next;
+        struct Slot_S *nextFree;
+} *Slot_T;
+/* A thread blocked in ConnectionPool_getConnectionWithTimeout(). Lives on the waiting thread's stack */
+typedef struct Waiter_S {
+        Sem_T granted;
+        int reserved;
+        Connection_T con;
+        struct Waiter_S *next;
+} *Waiter_T;
 struct ConnectionPool_S {
         URL_T url;
         int filled;
@@ -58,12 +104,55 @@ struct ConnectionPool_S {
 	Mutex_T mutex;
 	Vector_T pool;
         Thread_T reaper;
+        Thread_T *fillers;
+        int fillerCount;
+        volatile int fillNext;
+        int fillOk;
+        int fillFailed;
+        int readyConnections;
+        PoolPolicy_T policy;
+        Stripe_T stripes;
+        int stripeCount;
+        Slot_T slots;
+        Slot_T freeSlots;
+        int affinity;
+        ThreadData_T hint;
+        Sem_T settled;
+        volatile int idle;
+        volatile int size; // Connections in the pool plus slots reserved for connects in progress
+        volatile int pending;
+        Waiter_T waitHead;
+        Waiter_T waitTail;
+        volatile int waiters;
+        int sleepers;
+        int maxWaiters;
         int sweepInterval;
+        int validationInterval;
+        int minIdle;
+        int statementCacheSize;
+        Vector_T initStatements;
+        Vector_T preparedStatements;
 	int maxConnections;
         volatile int stopped;
         int connectionTimeout;
 	int initialConnections;
+        int collectStatistics;
+        PoolStatistics_T stats; // Counters and histograms, gauges are read at snapshot time
+        int autoscale;
+        int minTarget;
+        int maxTarget;
+        int autoscaleWait;
+        int calm;
+        long long lastSweep;
+        long long lastFailed;
+        long long lastHeld;
+        PoolHistogram_T lastWait;
 };
+/* Statistics are collected when turned on or when the autoscaler needs them */
+#define RECORD(P) ((P)->collectStatistics || (P)->autoscale)
+#define STAT(P, counter) do { if (RECORD(P)) __sync_fetch_and_add(&(P)->stats.counter, 1); } while (0)
+/* LOCK() the pool mutex and record the time spent waiting for it if it was contended */
+#define LOCK_POOL(P) do { Mutex_T *_yymutex = &((P)->mutex); _lockPool((P));
 
 int ZBDEBUG = false;
 #ifdef PACKAGE_PROTECTED
@@ -78,68 +167,746 @@ void(*AbortHandler)(const char *error) = NULL;
 /* ------------------------------------------------------- Private methods */
 
 
+/* Monotonic clock in microseconds for the statistics */
+static inline long long _micro(void) {
+        struct timespec t;
+        clock_gettime(CLOCK_MONOTONIC, &t);
+        return (long long)t.tv_sec * 1000000LL + t.tv_nsec / 1000;
+}
+
+
+/* Values below 8 get a bucket each, above that each power of two is split in 8 sub-buckets */
+static inline int _bucket(long long value) {
+        if (value < 8)
+                return value < 0 ? 0 : (int)value;
+        int e = 63 - __builtin_clzll((unsigned long long)value);
+        int i = (e - 2) * 8 + (int)((value >> (e - 3)) & 7);
+        return i < POOL_HISTOGRAM_BUCKETS ? i : POOL_HISTOGRAM_BUCKETS - 1;
+}
+
+
+/* The largest value recorded in bucket i */
+static inline long long _bucketLimit(int i) {
+        if (i < 8)
+                return i;
+        int e = i / 8 + 2;
+        return ((long long)(8 + i % 8 + 1) << (e - 3)) - 1;
+}
+
+
+static void _record(PoolHistogram_T *H, long long value) {
+        if (value < 0)
+                value = 0;
+        __sync_fetch_and_add(&H->buckets[_bucket(value)], 1);
+        __sync_fetch_and_add(&H->sum, value);
+        __sync_fetch_and_add(&H->count, 1);
+        for (long long max = H->max; value > max; max = H->max)
+                if (__sync_bool_compare_and_swap(&H->max, max, value))
+                        break;
+}
+
+
+static inline long long _load(long long *value) {
+        return __sync_fetch_and_add(value, 0);
+}
+
+
+static void _loadHistogram(PoolHistogram_T *H, PoolHistogram_T *from) {
+        H->count = _load(&from->count);
+        H->sum = _load(&from->sum);
+        H->max = _load(&from->max);
+        for (int i = 0; i < POOL_HISTOGRAM_BUCKETS; i++)
+                H->buckets[i] = _load(&from->buckets[i]);
+}
+
+
+static inline void _lockPool(T P) {
+        if (! RECORD(P)) {
+                Mutex_lock(P->mutex);
+        } else if (Mutex_trylock(P->mutex) != 0) {
+                long long start = _micro();
+                Mutex_lock(P->mutex);
+                _record(&P->stats.lockWait, _micro() - start);
+        }
+}
+
+
+/* Account for a Connection handed out by the pool, start is when it was requested */
+static inline Connection_T _borrowed(T P, Connection_T con, long long start) {
+        if (RECORD(P) && start) {
+                long long now = _micro();
+                ((Slot_T)Connection_getSlot(con))->borrowed = now;
+                STAT(P, borrowed);
+                _record(&P->stats.borrowWait, now - start);
+        }
+        return con;
+}
+
+
+/* Run a Connection test, ping or validate, and record the time it took */
+static int _check(T P, Connection_T con, int (*test)(Connection_T)) {
+        if (! RECORD(P))
+                return test(con);
+        long long start = _micro();
+        int ok = test(con);
+        _record(&P->stats.pingTime, _micro() - start);
+        if (! ok)
+                STAT(P, validationFailed);
+        return ok;
+}
+
+
+/* Run the session SQL and prepare the statements set with ConnectionPool_addInitStatement() and ConnectionPool_addPreparedStatement() */
+static int _initConnection(T P, Connection_T con, char **error) {
+        int success = true;
+        TRY
+        {
+                for (int i = 0; i < Vector_size(P->initStatements); i++)
+                        Connection_execute(con, "%s", (char *)Vector_get(P->initStatements, i));
+                for (int i = 0; P->statementCacheSize > 0 && i < Vector_size(P->preparedStatements); i++)
+                        Connection_prepareStatement(con, "%s", (char *)Vector_get(P->preparedStatements, i));
+                // Hand the prepared statements back to the statement cache
+                Connection_clear(con);
+        }
+        ELSE
+        {
+                *error = Str_cat("Failed to initialize connection -- %s", Exception_frame.message);
+                success = false;
+        }
+        END_TRY;
+        return success;
+}
+
+
+static Connection_T _connect(T P, char **error) {
+        long long start = RECORD(P) ? _micro() : 0;
+        Connection_T con = Connection_new(P, error);
+        if (con && (Vector_size(P->initStatements) || Vector_size(P->preparedStatements)) && ! _initConnection(P, con, error))
+                Connection_free(&con);
+        if (start)
+                _record(&P->stats.connectTime, _micro() - start);
+        if (con)
+                STAT(P, created);
+        else
+                STAT(P, createFailed);
+        return con;
+}
+
+
+/* Assign a slot to a new Connection. Must be called with the pool mutex locked */
+static void _allocSlot(T P, Connection_T con) {
+        Slot_T slot = P->freeSlots;
+        if (slot) {
+                P->freeSlots = slot->nextFree;
+        } else {
+                NEW(slot);
+                slot->next = P->slots;
+                P->slots = slot;
+        }
+        slot->con = con;
+        slot->stripe = NULL;
+        slot->state = SLOT_BUSY;
+        Connection_setSlot(con, slot);
+}
+
+
+/* Recycle the slot of a Connection leaving the pool. Must be called with the pool mutex locked */
+static void _freeSlot(T P, Connection_T con) {
+        Slot_T slot = Connection_getSlot(con);
+        slot->state = SLOT_FREE;
+        slot->con = NULL;
+        slot->nextFree = P->freeSlots;
+        P->freeSlots = slot;
+        Connection_setSlot(con, NULL);
+}
+
+
+/* Take an idle Connection. Returns false if another thread got to it first */
+static inline int _claim(T P, Slot_T slot) {
+        if (__sync_bool_compare_and_swap(&slot->state, SLOT_IDLE, SLOT_BUSY)) {
+                __sync_fetch_and_sub(&P->idle, 1);
+                return true;
+        }
+        return false;
+}
+
+
+/* Make con available to other threads again */
+static inline void _release(T P, Connection_T con) {
+        Slot_T slot = Connection_getSlot(con);
+        __sync_fetch_and_add(&P->idle, 1);
+        __sync_bool_compare_and_swap(&slot->state, SLOT_BUSY, SLOT_IDLE);
+}
+
+
+/* Reserve room for one more Connection without exceeding maxConnections */
+static inline int _reserve(T P) {
+        int n;
+        while ((n = P->size) < P->maxConnections)
+                if (__sync_bool_compare_and_swap(&P->size, n, n + 1))
+                        return true;
+        return false;
+}
+
+
+/*
+ * Idle Connections are kept on intrusive doubly linked lists, one per 
+ * stripe, linked via the Connection next/prev pointers. Connections are 
+ * always handed out from the head of a list. The pool policy decides if 
+ * a returned Connection is put back at the head (LIFO) or at the tail 
+ * (FIFO) of the list. A Connection taken from its slot by the thread-affine
+ * fast path stays on the list until the next pop or return drops the stale
+ * link. List methods must be called with the stripe mutex locked.
+ */
+static inline void _unlinkIdle(Stripe_T S, Connection_T con) {
+        Connection_T prev = Connection_getPrev(con);
+        Connection_T next = Connection_getNext(con);
+        if (prev)
+                Connection_setNext(prev, next);
+        else
+                S->head = next;
+        if (next)
+                Connection_setPrev(next, prev);
+        else
+                S->tail = prev;
+        Connection_setNext(con, NULL);
+        Connection_setPrev(con, NULL);
+        ((Slot_T)Connection_getSlot(con))->stripe = NULL;
+        S->count--;
+}
+
+
+static inline void _linkIdle(Stripe_T S, Connection_T con, int atHead) {
+        if (atHead) {
+                Connection_setPrev(con, NULL);
+                Connection_setNext(con, S->head);
+                if (S->head)
+                        Connection_setPrev(S->head, con);
+                else
+                        S->tail = con;
+                S->head = con;
+        } else {
+                Connection_setNext(con, NULL);
+                Connection_setPrev(con, S->tail);
+                if (S->tail)
+                        Connection_setNext(S->tail, con);
+                else
+                        S->head = con;
+                S->tail = con;
+        }
+        ((Slot_T)Connection_getSlot(con))->stripe = S;
+        S->count++;
+}
+
+
+static inline Connection_T _popIdle(T P, Stripe_T S) {
+        Connection_T con;
+        while ((con = S->head)) {
+                _unlinkIdle(S, con);
+                if (_claim(P, Connection_getSlot(con)))
+                        return con;
+                // Stale link, con was taken by the thread-affine fast path
+        }
+        return NULL;
+}
+
+
+static inline Stripe_T _homeStripe(T P) {
+        if (P->stripeCount == 1)
+                return P->stripes;
+        unsigned long h = (unsigned long)Thread_self();
+        h ^= h >> 16;
+        h *= 0x45d9f3bUL;
+        h ^= h >> 16;
+        return &P->stripes[h % P->stripeCount];
+}
+
+
+/* Take an idle Connection from the home stripe or else steal one from the next stripe that has one */
+static Connection_T _takeIdle(T P) {
+        int home = (int)(_homeStripe(P) - P->stripes);
+        for (int i = 0; i < P->stripeCount; i++) {
+                Connection_T con = NULL;
+                Stripe_T S = &P->stripes[(home + i) % P->stripeCount];
+                if (! S->head && i > 0)
+                        continue; // Unlocked peek, do not lock stripes that look empty
+                LOCK(S->mutex)
+                {
+                        con = _popIdle(P, S);
+                }
+                END_LOCK;
+                if (con)
+                        return con;
+        }
+        return NULL;
+}
+
+
+/*
+ * Take an idle Connection that has a statement for sql in its statement
+ * cache. The Connections nearest the head of each stripe are claimed one at
+ * a time so their cache cannot change while it is looked at, and released
+ * again if they do not have the statement.
+ */
+static Connection_T _takeIdleFor(T P, const char *sql) {
+        int home = (int)(_homeStripe(P) - P->stripes);
+        for (int i = 0; i < P->stripeCount; i++) {
+                Connection_T found = NULL;
+                Stripe_T S = &P->stripes[(home + i) % P->stripeCount];
+                if (! S->head)
+                        continue;
+                LOCK(S->mutex)
+                {
+                        Connection_T con = S->head;
+                        for (int n = 0; con && n < STATEMENT_SCAN; con = Connection_getNext(con), n++) {
+                                if (_claim(P, Connection_getSlot(con))) {
+                                        if (Connection_hasStatement(con, sql)) {
+                                                _unlinkIdle(S, con);
+                                                found = con;
+                                                break;
+                                        }
+                                        _release(P, con);
+                                }
+                        }
+                }
+                END_LOCK;
+                if (found)
+                        return found;
+        }
+        return NULL;
+}
+
+
+/* Link con into S and make it available under the same lock, so _popIdle never finds it linked and still busy */
+static void _putIdle(T P, Stripe_T S, Connection_T con, int atHead) {
+        LOCK(S->mutex)
+        {
+                _linkIdle(S, con, atHead);
+                _release(P, con);
+        }
+        END_LOCK;
+}
+
+
+/* Drop a stale idle link to con. Must only be called by the thread holding con */
+static void _unlinkStale(Connection_T con) {
+        Slot_T slot = Connection_getSlot(con);
+        Stripe_T S = slot->stripe;
+        if (S) {
+                LOCK(S->mutex)
+                {
+                        if (slot->stripe == S)
+                                _unlinkIdle(S, con);
+                }
+                END_LOCK;
+        }
+}
+
+
+/*
+ * Threads waiting for a Connection are queued in FIFO order. A returned
+ * Connection or a freed slot is handed directly to the waiter at the head
+ * of the queue so a thread arriving later cannot take it first. All 
+ * waiter methods must be called with the pool mutex locked.
+ */
+static inline void _enqueueWaiter(T P, Waiter_T w) {
+        w->next = NULL;
+        if (P->waitTail)
+                P->waitTail->next = w;
+        else
+                P->waitHead = w;
+        P->waitTail = w;
+        P->waiters++;
+}
+
+
+static inline Waiter_T _dequeueWaiter(T P) {
+        Waiter_T w = P->waitHead;
+        if (w) {
+                P->waitHead = w->next;
+                if (! P->waitHead)
+                        P->waitTail = NULL;
+                w->next = NULL;
+                P->waiters--;
+        }
+        return w;
+}
+
+
+/* Remove a waiter from anywhere in the queue, if it is still queued */
+static void _cancelWaiter(T P, Waiter_T w) {
+        Waiter_T prev = NULL;
+        for (Waiter_T x = P->waitHead; x; prev = x, x = x->next) {
+                if (x == w) {
+                        if (prev)
+                                prev->next = w->next;
+                        else
+                                P->waitHead = w->next;
+                        if (P->waitTail == w)
+                                P->waitTail = prev;
+                        w->next = NULL;
+                        P->waiters--;
+                        break;
+                }
+        }
+}
+
+
+/* Give con to the first waiter, if any. Returns true if con was handed over */
+static inline int _handoverConnection(T P, Connection_T con) {
+        Waiter_T w = _dequeueWaiter(P);
+        if (w) {
+                Connection_setAvailable(con, false);
+                w->con = con;
+                Sem_signal(w->granted);
+                return true;
+        }
+        return false;
+}
+
+
+/* Reserve a free slot on behalf of the first waiter, if any. Returns true if a slot was handed over */
+static inline int _handoverSlot(T P) {
+        if (P->waitHead && _reserve(P)) {
+                Waiter_T w = _dequeueWaiter(P);
+                __sync_fetch_and_add(&P->pending, 1);
+                w->reserved = true;
+                Sem_signal(w->granted);
+                return true;
+        }
+        return false;
+}
+
+
+/* Wake the first waiter so it looks for an idle Connection itself */
+static inline void _nudgeWaiter(T P) {
+        if (P->waitHead)
+                Sem_signal(P->waitHead->granted);
+}
+
+
+static void _wakeWaiters(T P) {
+        for (Waiter_T w = P->waitHead; w; w = w->next)
+                Sem_signal(w->granted);
+}
+
+
+static inline int _isExpired(struct timespec deadline) {
+        return Time_milli() >= ((long long)deadline.tv_sec * 1000 + deadline.tv_nsec / 1000000);
+}
+
+
+/* Give back a slot reserved for a connect that did not add a Connection to the pool */
+static inline void _unreserve(T P) {
+        __sync_fetch_and_sub(&P->size, 1);
+        __sync_fetch_and_sub(&P->pending, 1);
+}
+
+
+/* Reserve a slot for a new Connection from outside the pool mutex */
+static int _reserveSlot(T P) {
+        if (! _reserve(P))
+                return false;
+        __sync_fetch_and_add(&P->pending, 1);
+        if (P->stopped) {
+                LOCK_POOL(P)
+                {
+                        _unreserve(P);
+                        Sem_broadcast(P->settled);
+                }
+                END_LOCK;
+                return false;
+        }
+        return true;
+}
+
+
+/* 
+ * Wait in line until a Connection or a slot is handed over, the deadline 
+ * passes or the pool is stopped. The waiter at the head of the line also 
+ * looks for an idle Connection itself, in case one was returned to a 
+ * stripe before this thread got in line. Returns true if a slot was 
+ * reserved for the caller and sets con if a Connection was found. Must 
+ * be called with the pool mutex locked.
+ */
+static int _waitInLine(T P, struct timespec deadline, Connection_T *con) {
+        struct Waiter_S w = {.reserved = false, .con = NULL, .next = NULL};
+        Sem_init(w.granted);
+        _enqueueWaiter(P, &w);
+        P->sleepers++;
+        __sync_synchronize();
+        while (! (w.con || w.reserved || P->stopped)) {
+                if (P->waitHead == &w) {
+                        if ((w.con = _takeIdle(P)))
+                                break;
+                        if (_reserve(P)) {
+                                __sync_fetch_and_add(&P->pending, 1);
+                                w.reserved = true;
+                                break;
+                        }
+                }
+                if (_isExpired(deadline))
+                        break;
+                Sem_timeWait(w.granted, P->mutex, deadline);
+        }
+        P->sleepers--;
+        _cancelWaiter(P, &w);
+        _nudgeWaiter(P);
+        Sem_destroy(w.granted);
+        if (P->stopped) {
+                // The pool is being drained, give back whatever was handed over
+                if (w.reserved)
+                        _unreserve(P);
+                Sem_broadcast(P->settled);
+                return false;
+        }
+        *con = w.con;
+        return w.reserved;
+}
+
+
+/* Remove a taken con from the pool without closing it. Must be called with the pool mutex locked */
+static void _detachConnection(T P, Connection_T con) {
+        STAT(P, closed);
+        _unlinkStale(con);
+        _freeSlot(P, con);
+        for (int i = Vector_size(P->pool) - 1; i >= 0; i--) {
+                if (Vector_get(P->pool, i) == con) {
+                        Vector_remove(P->pool, i);
+                        break;
+                }
+        }
+        __sync_fetch_and_sub(&P->size, 1);
+}
+
+
 static void _drainPool(T P) {
+        for (int i = 0; i < P->stripeCount; i++) {
+                LOCK(P->stripes[i].mutex)
+                {
+                        P->stripes[i].head = P->stripes[i].tail = NULL;
+                        P->stripes[i].count = 0;
+                }
+                END_LOCK;
+        }
         while (! Vector_isEmpty(P->pool)) {
 		Connection_T con = Vector_pop(P->pool);
+                _freeSlot(P, con);
 		Connection_free(&con);
 	}
+        P->idle = 0;
+        P->size = 0;
 }
 
 
-static int _fillPool(T P) {
-	for (int i = 0; i < P->initialConnections; i++) {
-                Connection_T con = Connection_new(P, &P->error);
-		if (! con) {
-                        if (i > 0) {
-                                DEBUG("Failed to fill the pool with initial connections -- %s\n", P->error);
-                                FREE(P->error);
-                                return true;
-                        }
-                        return false;
+/* Skip validation of a Connection returned a moment ago, otherwise use the cheapest check the backend supports */
+static inline int _validate(T P, Connection_T con) {
+        if (P->validationInterval > 0 && (Time_milli() - Connection_getLastAccessedMilli(con)) < P->validationInterval)
+                return true;
+        return _check(P, con, Connection_validate);
+}
+
+
+/* Connections in use, from the atomic counters so the pool need not be locked */
+static inline int _getActive(T P) {
+        int active = P->size - P->pending - P->idle;
+        return active > 0 ? active : 0;
+}
+
+
+/*
+ * Add a Connection opened outside the pool lock to the slot reserved for it
+ * by the caller. If con is NULL or the pool was stopped meanwhile the slot is
+ * given back and NULL is returned. Otherwise con is returned in use.
+ */
+static Connection_T _addConnection(T P, Connection_T con) {
+        LOCK_POOL(P)
+        {
+                if (con && ! P->stopped) {
+                        Connection_setAvailable(con, false);
+                        Vector_push(P->pool, con);
+                        _allocSlot(P, con);
+                        __sync_fetch_and_sub(&P->pending, 1);
+                } else {
+                        if (con)
+                                Connection_free(&con);
+                        _unreserve(P);
+                        _handoverSlot(P);
                 }
-		Vector_push(P->pool, con);
-	}
-	return true;
+                if (P->stopped)
+                        Sem_broadcast(P->settled);
+        }
+        END_LOCK;
+        return con;
+}
+
+
+/* Connect outside the pool mutex into a slot reserved by the caller */
+static Connection_T _newConnection(T P) {
+        char *error = NULL;
+        Connection_T con = _addConnection(P, _connect(P, &error));
+        if (error) {
+                DEBUG("Failed to create connection -- %s\n", error);
+                FREE(error);
+        }
+        return con;
 }
 
 
-static int _getActive(T P){
-        int i, n = 0, size = Vector_size(P->pool);
-        for (i = 0; i < size; i++)
-                if (! Connection_isAvailable(Vector_get(P->pool, i))) 
-                        n++; 
-        return n; 
+/* Remove a dead or unwanted idle Connection taken by the reaper */
+static void _dropConnection(T P, Connection_T con) {
+        LOCK_POOL(P)
+        {
+                _detachConnection(P, con);
+                _handoverSlot(P);
+        }
+        END_LOCK;
+        Connection_free(&con);
 }
 
 
+/*
+ * Validate the idle Connections and close those that are dead, or that 
+ * timed out while there are more idle Connections than the pool should 
+ * keep. Each Connection is taken from the cold end of its idle list, 
+ * checked without any lock held and put back like a returned Connection,
+ * so other threads can use the rest of the stripe meanwhile.
+ */
 static int _reapConnections(T P) {
         int n = 0;
-        int x = Vector_size(P->pool) - _getActive(P) - P->initialConnections;
-        time_t timedout = Time_now() - P->connectionTimeout;
-        for (int i = 0; ((n < x) && (i < Vector_size(P->pool))); i++) {
-                Connection_T con = Vector_get(P->pool, i);
-                if (Connection_isAvailable(con)) {
-                        if ((Connection_getLastAccessedTime(con) < timedout) || (! Connection_ping(con))) {
-                                Vector_remove(P->pool, i);
-                                Connection_free(&con);
+        int keep = P->initialConnections > P->minIdle ? P->initialConnections : P->minIdle;
+        long long timedout = Time_milli() - (long long)P->connectionTimeout * 1000;
+        int lifo = (P->policy != POOL_FIFO);
+        for (int i = 0; i < P->stripeCount && ! P->stopped; i++) {
+                int count = 0;
+                Stripe_T S = &P->stripes[i];
+                LOCK(S->mutex)
+                {
+                        count = S->count;
+                }
+                END_LOCK;
+                while (count-- > 0 && ! P->stopped) {
+                        Connection_T con = NULL;
+                        LOCK(S->mutex)
+                        {
+                                while ((con = lifo ? S->tail : S->head)) {
+                                        _unlinkIdle(S, con);
+                                        if (_claim(P, Connection_getSlot(con)))
+                                                break;
+                                }
+                        }
+                        END_LOCK;
+                        if (! con)
+                                break;
+                        if (P->size > P->maxConnections || (Connection_getLastAccessedMilli(con) < timedout && P->idle >= keep) || ! _check(P, con, Connection_ping)) {
+                                _dropConnection(P, con);
                                 n++;
-                                i--;
+                        } else {
+                                _putIdle(P, S, con, lifo);
                         }
-                } 
+                }
         }
         return n;
 }
 
 
+static void _returnIdle(T P, Connection_T con);
+
+
+/* Open Connections until there are at least minIdle idle Connections */
+static void _ensureMinIdle(T P) {
+        while (P->idle < P->minIdle && ! P->stopped && _reserveSlot(P)) {
+                Connection_T con = _newConnection(P);
+                if (! con)
+                        break;
+                _returnIdle(P, con);
+        }
+}
+
+
+/* Set the pool target, maxConnections, and hand new slots to waiting threads */
+static void _setTarget(T P, int target) {
+        LOCK_POOL(P)
+        {
+                P->maxConnections = target;
+                while (_handoverSlot(P)) ;
+        }
+        END_LOCK;
+}
+
+
+/*
+ * Adjust the pool target from the demand seen since the last sweep. Busy is
+ * the average number of Connections in use, the sum of hold times divided by
+ * the time passed, or the number in use now if higher. Grow at once if the 
+ * pool is at its target and threads had to wait, were turned away or most of
+ * the target is busy. Shrink only after AUTOSCALE_CALM quiet sweeps in a row
+ * and never below twice the busy Connections, so the target does not bounce
+ */
+static void _autoscale(T P) {
+        PoolHistogram_T wait;
+        long long now = _micro();
+        long long held = _load(&P->stats.holdTime.sum);
+        long long failed = _load(&P->stats.timedOut) + _load(&P->stats.exhausted) + _load(&P->stats.rejected);
+        _loadHistogram(&wait, &P->stats.borrowWait);
+        if (P->lastSweep && now > P->lastSweep) {
+                int target = P->maxConnections;
+                double busy = (double)(held - P->lastHeld) / (double)(now - P->lastSweep);
+                if (busy < _getActive(P))
+                        busy = _getActive(P);
+                // The borrow wait percentile over this sweep only
+                PoolHistogram_T delta = {.count = wait.count - P->lastWait.count, .max = LLONG_MAX};
+                for (int i = 0; i < POOL_HISTOGRAM_BUCKETS; i++)
+                        delta.buckets[i] = wait.buckets[i] - P->lastWait.buckets[i];
+                int slow = ConnectionPool_percentile(&delta, 99) > (long long)P->autoscaleWait * 1000;
+                int pressure = P->waiters > 0 || failed > P->lastFailed || slow;
+                if (P->size >= target && (pressure || busy > target * AUTOSCALE_HIGH)) {
+                        target += target / 4 > 1 ? target / 4 : 1;
+                        P->calm = 0;
+                } else if (! pressure && busy < target * AUTOSCALE_LOW) {
+                        if (++P->calm >= AUTOSCALE_CALM) {
+                                int floor = (int)(busy * 2) + 1;
+                                target -= target / 4 > 1 ? target / 4 : 1;
+                                if (target < floor)
+                                        target = floor;
+                                P->calm = 0;
+                        }
+                } else {
+                        P->calm = 0;
+                }
+                if (target > P->maxTarget)
+                        target = P->maxTarget;
+                if (target < P->minTarget)
+                        target = P->minTarget;
+                if (target != P->maxConnections) {
+                        DEBUG("Autoscale pool target from %d to %d connections -- %.1f busy\n", P->maxConnections, target, busy);
+                        _setTarget(P, target);
+                }
+        }
+        P->lastSweep = now;
+        P->lastHeld = held;
+        P->lastFailed = failed;
+        P->lastWait = wait;
+}
+
+
 static void *_doSweep(void *args) {
         T P = args;
         struct timespec wait = {0, 0};
+        _ensureMinIdle(P);
+        if (P->autoscale)
+                _autoscale(P); // Baseline for the first sweep
         Mutex_lock(P->mutex);
         while (! P->stopped) {
                 wait.tv_sec = Time_now() + P->sweepInterval;
                 Sem_timeWait(P->alarm,  P->mutex, wait);
                 if (P->stopped) break;
+                Mutex_unlock(P->mutex);
+                if (P->autoscale)
+                        _autoscale(P);
                 _reapConnections(P);
+                _ensureMinIdle(P);
+                Mutex_lock(P->mutex);
         }
         Mutex_unlock(P->mutex);
         DEBUG("Reaper thread stopped\n");
@@ -147,6 +914,218 @@ static void *_doSweep(void *args) {
 }
 
 
+/* Hand con to a waiting thread or else put it on the home stripe of the calling thread */
+static void _returnIdle(T P, Connection_T con) {
+        if (P->waiters) {
+                int handedOver = false;
+                LOCK_POOL(P)
+                {
+                        handedOver = _handoverConnection(P, con);
+                }
+                END_LOCK;
+                if (handedOver)
+                        return;
+        }
+        _unlinkStale(con);
+        Connection_setAvailable(con, true);
+        if (P->affinity)
+                ThreadData_set(P->hint, Connection_getSlot(con));
+        _putIdle(P, _homeStripe(P), con, P->policy != POOL_FIFO);
+        // A thread may have got in line after we looked, let it find the Connection
+        __sync_synchronize();
+        if (P->waiters) {
+                LOCK_POOL(P)
+                {
+                        _nudgeWaiter(P);
+                }
+                END_LOCK;
+        }
+}
+
+
+/*
+ * Filler thread. Opens initial Connections until all have been attempted
+ * and reports each outcome to ConnectionPool_start() waiting on settled.
+ * The first error is kept in P->error for the exception thrown by start
+ */
+static void *_doFill(void *args) {
+        T P = args;
+        while (! P->stopped && __sync_fetch_and_add(&P->fillNext, 1) < P->initialConnections) {
+                char *error = NULL;
+                Connection_T con = NULL;
+                if (_reserveSlot(P)) {
+                        con = _addConnection(P, _connect(P, &error));
+                        if (con)
+                                _returnIdle(P, con);
+                }
+                LOCK_POOL(P)
+                {
+                        if (con) {
+                                P->fillOk++;
+                        } else {
+                                P->fillFailed++;
+                                if (error && ! P->error) {
+                                        P->error = error;
+                                        error = NULL;
+                                }
+                        }
+                        Sem_broadcast(P->settled);
+                }
+                END_LOCK;
+                if (error) {
+                        DEBUG("Failed to fill the pool with initial connections -- %s\n", error);
+                        FREE(error);
+                }
+        }
+        return NULL;
+}
+
+
+/*
+ * Open the initial Connections in parallel on a small group of filler threads.
+ * Must be called with the pool lock held and waits, with the lock released,
+ * until readyConnections Connections are open or all connects have completed.
+ * Returns true if at least one Connection could be opened. The fillers go on
+ * in the background and are joined by _joinFillers()
+ */
+static int _fillPool(T P) {
+        if (P->initialConnections <= 0)
+                return true;
+        int ready = P->initialConnections;
+        if (P->readyConnections > 0 && P->readyConnections < ready)
+                ready = P->readyConnections;
+        P->fillNext = P->fillOk = P->fillFailed = 0;
+        FREE(P->error);
+        P->fillerCount = P->initialConnections < FILL_THREADS ? P->initialConnections : FILL_THREADS;
+        P->fillers = CALLOC(P->fillerCount, sizeof(Thread_T));
+        for (int i = 0; i < P->fillerCount; i++)
+                Thread_create(P->fillers[i], _doFill, P);
+        while (P->fillOk < ready && (P->fillOk + P->fillFailed) < P->initialConnections)
+                Sem_wait(P->settled, P->mutex);
+        if (P->fillOk == 0 && ! P->error)
+                P->error = Str_dup("no connection could be opened");
+        return P->fillOk > 0;
+}
+
+
+/* Join the filler threads. Must be called without the pool lock held */
+static void _joinFillers(T P) {
+        if (P->fillers) {
+                for (int i = 0; i < P->fillerCount; i++)
+                        Thread_join(P->fillers[i]);
+                FREE(P->fillers);
+                P->fillerCount = 0;
+        }
+}
+
+
+static void _freeStatements(Vector_T statements) {
+        while (! Vector_isEmpty(statements)) {
+                char *sql = Vector_pop(statements);
+                FREE(sql);
+        }
+}
+
+
+static void _initStripes(T P, int count) {
+        P->stripes = CALLOC(count, sizeof(struct Stripe_S));
+        P->stripeCount = count;
+        for (int i = 0; i < count; i++)
+                Mutex_init(P->stripes[i].mutex);
+}
+
+
+static void _freeStripes(T P) {
+        for (int i = 0; i < P->stripeCount; i++)
+                Mutex_destroy(P->stripes[i].mutex);
+        FREE(P->stripes);
+        P->stripeCount = 0;
+}
+
+
+/* Borrow a Connection, preferring one with a statement for sql if sql is not NULL */
+static Connection_T _getConnection(T P, int timeout, const char *sql) {
+        struct timespec deadline = {0, 0};
+        long long start = RECORD(P) ? _micro() : 0;
+        if (timeout > 0) {
+                long long ms = Time_milli() + timeout;
+                deadline.tv_sec = (time_t)(ms / 1000);
+                deadline.tv_nsec = (long)(ms % 1000) * 1000000L;
+        }
+        /*
+         * Idle Connections are taken from the stripes without the pool mutex.
+         * The pool mutex is only held to wait in line. Validation and connection
+         * establishment both involve a round-trip to the database and are done
+         * without any lock so a slow or dead database server does not hold up
+         * other threads.
+         */
+        while (true) {
+                int reserved = false, waited = false, rejected = false;
+                Connection_T con = NULL;
+                if (P->stopped)
+                        return NULL;
+                if (sql && ! P->waiters && (con = _takeIdleFor(P, sql)))
+                        goto validate;
+                if (P->affinity) {
+                        // Fast path, try to take back the Connection this thread returned last
+                        Slot_T slot = ThreadData_get(P->hint);
+                        if (slot && _claim(P, slot)) {
+                                con = slot->con;
+                                goto validate;
+                        }
+                }
+                // Do not jump the queue if other threads are already waiting
+                if (! P->waiters) {
+                        con = _takeIdle(P);
+                        if (! con)
+                                reserved = _reserveSlot(P);
+                }
+                if (! (con || reserved) && timeout > 0 && ! _isExpired(deadline)) {
+                        LOCK_POOL(P)
+                        {
+                                if (P->waiters >= P->maxWaiters) {
+                                        DEBUG("Connection request rejected -- %d threads are already waiting\n", P->waiters);
+                                        rejected = true;
+                                } else if (! P->stopped) {
+                                        waited = true;
+                                        reserved = _waitInLine(P, deadline, &con);
+                                }
+                        }
+                        END_LOCK;
+                }
+validate:
+                if (con) {
+                        int valid = _validate(P, con);
+                        Connection_setAvailable(con, false);
+                        if (valid)
+                                return _borrowed(P, con, start);
+                        LOCK_POOL(P)
+                        {
+                                _detachConnection(P, con);
+                                _handoverSlot(P);
+                                // Let the reaper check the other Connections and replace this one
+                                if (P->doSweep)
+                                        Sem_signal(P->alarm);
+                        }
+                        END_LOCK;
+                        Connection_free(&con);
+                        continue;
+                }
+                if (reserved) {
+                        con = _newConnection(P);
+                        return con ? _borrowed(P, con, start) : NULL;
+                }
+                if (rejected)
+                        STAT(P, rejected);
+                else if (waited && ! P->stopped)
+                        STAT(P, timedOut);
+                else if (! P->stopped)
+                        STAT(P, exhausted);
+                return NULL;
+        }
+}
+
+
 /* ---------------------------------------------------------------- Public */
 
 
@@ -159,9 +1138,16 @@ T ConnectionPool_new(URL_T url) {
 	NEW(P);
         P->url = url;
         Sem_init(P->alarm);
+        Sem_init(P->settled);
 	Mutex_init(P->mutex);
+        _initStripes(P, 1);
+        P->policy = POOL_LIFO;
+        P->maxWaiters = INT_MAX;
+        P->autoscaleWait = SQL_DEFAULT_AUTOSCALE_WAIT;
 	P->maxConnections = SQL_DEFAULT_MAX_CONNECTIONS;
         P->pool = Vector_new(SQL_DEFAULT_MAX_CONNECTIONS);
+        P->initStatements = Vector_new(4);
+        P->preparedStatements = Vector_new(4);
 	P->initialConnections = SQL_DEFAULT_INIT_CONNECTIONS;
         P->connectionTimeout = SQL_DEFAULT_CONNECTION_TIMEOUT;
 	return P;
@@ -175,8 +1161,20 @@ void ConnectionPool_free(T *P) {
         if (! (*P)->stopped)
                 ConnectionPool_stop((*P));
         Vector_free(&pool);
+        _freeStatements((*P)->initStatements);
+        Vector_free(&(*P)->initStatements);
+        _freeStatements((*P)->preparedStatements);
+        Vector_free(&(*P)->preparedStatements);
+        for (Slot_T slot = (*P)->slots, next; slot; slot = next) {
+                next = slot->next;
+                FREE(slot);
+        }
+        if ((*P)->affinity)
+                ThreadData_delete((*P)->hint);
+        _freeStripes(*P);
 	Mutex_destroy((*P)->mutex);
         Sem_destroy((*P)->alarm);
+        Sem_destroy((*P)->settled);
         FREE((*P)->error);
 	FREE(*P);
 }
@@ -194,7 +1192,7 @@ URL_T ConnectionPool_getURL(T P) {
 void ConnectionPool_setInitialConnections(T P, int connections) {
         assert(P);
         assert(connections >= 0);
-        LOCK(P->mutex)
+        LOCK_POOL(P)
         {
                 P->initialConnections = connections;
         }
@@ -208,12 +1206,30 @@ int ConnectionPool_getInitialConnections(T P) {
 }
 
 
+void ConnectionPool_setReadyConnections(T P, int connections) {
+        assert(P);
+        assert(connections >= 0);
+        LOCK_POOL(P)
+        {
+                P->readyConnections = connections;
+        }
+        END_LOCK;
+}
+
+
+int ConnectionPool_getReadyConnections(T P) {
+        assert(P);
+        return P->readyConnections;
+}
+
+
 void ConnectionPool_setMaxConnections(T P, int maxConnections) {
         assert(P);
         assert(P->initialConnections <= maxConnections);
-        LOCK(P->mutex)
+        LOCK_POOL(P)
         {
                 P->maxConnections = maxConnections;
+                while (_handoverSlot(P)) ;
         }
         END_LOCK;
 }
@@ -244,10 +1260,205 @@ void ConnectionPool_setAbortHandler(T P, void(*abortHandler)(const char *error))
 }
 
 
+void ConnectionPool_setPolicy(T P, PoolPolicy_T policy) {
+        assert(P);
+        assert(policy == POOL_LIFO || policy == POOL_FIFO);
+        LOCK_POOL(P)
+        {
+                P->policy = policy;
+        }
+        END_LOCK;
+}
+
+
+PoolPolicy_T ConnectionPool_getPolicy(T P) {
+        assert(P);
+        return P->policy;
+}
+
+
+void ConnectionPool_setStripes(T P, int stripes) {
+        assert(P);
+        assert(stripes > 0);
+        LOCK_POOL(P)
+        {
+                assert(! P->filled);
+                _freeStripes(P);
+                _initStripes(P, stripes);
+        }
+        END_LOCK;
+}
+
+
+int ConnectionPool_getStripes(T P) {
+        assert(P);
+        return P->stripeCount;
+}
+
+
+void ConnectionPool_setAffinity(T P, int affinity) {
+        assert(P);
+        LOCK_POOL(P)
+        {
+                if (affinity && ! P->affinity)
+                        ThreadData_create(P->hint);
+                else if (! affinity && P->affinity)
+                        ThreadData_delete(P->hint);
+                P->affinity = affinity;
+        }
+        END_LOCK;
+}
+
+
+int ConnectionPool_getAffinity(T P) {
+        assert(P);
+        return P->affinity;
+}
+
+
+void ConnectionPool_setMaxWaiters(T P, int maxWaiters) {
+        assert(P);
+        assert(maxWaiters >= 0);
+        LOCK_POOL(P)
+        {
+                P->maxWaiters = maxWaiters;
+        }
+        END_LOCK;
+}
+
+
+int ConnectionPool_getMaxWaiters(T P) {
+        assert(P);
+        return P->maxWaiters;
+}
+
+
+int ConnectionPool_waiters(T P) {
+        assert(P);
+        return P->waiters;
+}
+
+
+void ConnectionPool_setValidationInterval(T P, int validationInterval) {
+        assert(P);
+        assert(validationInterval >= 0);
+        P->validationInterval = validationInterval;
+}
+
+
+int ConnectionPool_getValidationInterval(T P) {
+        assert(P);
+        return P->validationInterval;
+}
+
+
+void ConnectionPool_setMinIdle(T P, int minIdle) {
+        assert(P);
+        assert(minIdle >= 0);
+        assert(minIdle <= P->maxConnections);
+        P->minIdle = minIdle;
+}
+
+
+int ConnectionPool_getMinIdle(T P) {
+        assert(P);
+        return P->minIdle;
+}
+
+
+void ConnectionPool_setCollectStatistics(T P, int collect) {
+        assert(P);
+        P->collectStatistics = collect;
+}
+
+
+int ConnectionPool_getCollectStatistics(T P) {
+        assert(P);
+        return P->collectStatistics;
+}
+
+
+void ConnectionPool_setAutoscale(T P, int minConnections, int maxConnections) {
+        assert(P);
+        assert(minConnections >= 1);
+        assert(minConnections <= maxConnections);
+        assert(P->initialConnections <= maxConnections);
+        LOCK_POOL(P)
+        {
+                P->autoscale = true;
+                P->minTarget = minConnections;
+                P->maxTarget = maxConnections;
+                P->lastSweep = 0;
+                P->calm = 0;
+        }
+        END_LOCK;
+        if (P->maxConnections < minConnections)
+                _setTarget(P, minConnections);
+        else if (P->maxConnections > maxConnections)
+                _setTarget(P, maxConnections);
+}
+
+
+int ConnectionPool_getAutoscale(T P) {
+        assert(P);
+        return P->autoscale;
+}
+
+
+void ConnectionPool_setAutoscaleWait(T P, int milliseconds) {
+        assert(P);
+        assert(milliseconds >= 0);
+        P->autoscaleWait = milliseconds;
+}
+
+
+int ConnectionPool_getAutoscaleWait(T P) {
+        assert(P);
+        return P->autoscaleWait;
+}
+
+
+void ConnectionPool_setStatementCacheSize(T P, int size) {
+        assert(P);
+        assert(size >= 0);
+        P->statementCacheSize = size;
+}
+
+
+int ConnectionPool_getStatementCacheSize(T P) {
+        assert(P);
+        return P->statementCacheSize;
+}
+
+
+void ConnectionPool_addInitStatement(T P, const char *sql) {
+        assert(P);
+        assert(sql);
+        LOCK_POOL(P)
+        {
+                assert(! P->filled);
+                Vector_push(P->initStatements, Str_dup(sql));
+        }
+        END_LOCK;
+}
+
+
+void ConnectionPool_addPreparedStatement(T P, const char *sql) {
+        assert(P);
+        assert(sql);
+        LOCK_POOL(P)
+        {
+                assert(! P->filled);
+                Vector_push(P->preparedStatements, Str_dup(sql));
+        }
+        END_LOCK;
+}
+
+
 void ConnectionPool_setReaper(T P, int sweepInterval) {
         assert(P);
         assert(sweepInterval>0);
-        LOCK(P->mutex)
+        LOCK_POOL(P)
         {
                 P->doSweep = true;
                 P->sweepInterval = sweepInterval;
@@ -263,14 +1474,8 @@ int ConnectionPool_size(T P) {
 
 
 int ConnectionPool_active(T P) {
-        int n = 0;
         assert(P);
-        LOCK(P->mutex)
-        {
-                n = _getActive(P);
-        }
-        END_LOCK;
-        return n;
+        return _getActive(P);
 }
 
 
@@ -279,11 +1484,13 @@ int ConnectionPool_active(T P) {
 
 void ConnectionPool_start(T P) {
         assert(P);
-        LOCK(P->mutex)
+        LOCK_POOL(P)
         {
                 P->stopped = false;
                 if (! P->filled) {
                         P->filled = _fillPool(P);
+                        if (P->filled)
+                                DEBUG("Pool started with %d of %d initial connections\n", P->fillOk, P->initialConnections);
                         if (P->filled && P->doSweep) {
                                 DEBUG("Starting Database reaper thread\n");
                                 Thread_create(P->reaper, _doSweep, P);
@@ -291,66 +1498,77 @@ void ConnectionPool_start(T P) {
                 }
         }
         END_LOCK;
-        if (! P->filled)
+        if (! P->filled) {
+                _joinFillers(P);
                 THROW(SQLException, "Failed to start connection pool -- %s", P->error);
+        }
 }
 
 
 void ConnectionPool_stop(T P) {
         int stopSweep = false;
         assert(P);
-        LOCK(P->mutex)
+        LOCK_POOL(P)
         {
                 P->stopped = true;
-                if (P->filled) {
-                        _drainPool(P);
-                        P->filled = false;
-                        stopSweep = (P->doSweep && P->reaper);
-                }
+                __sync_synchronize();
+                _wakeWaiters(P);
+                stopSweep = (P->filled && P->doSweep && P->reaper);
+                if (stopSweep)
+                        Sem_signal(P->alarm);
         }
         END_LOCK;
+        /* The reaper works without the pool lock, stop it before the pool is drained */
         if (stopSweep) {
                 DEBUG("Stopping Database reaper thread...\n");
-                Sem_signal(P->alarm);
                 Thread_join(P->reaper);
         }
+        /* Let filler threads still opening initial Connections in the background see stopped and exit */
+        _joinFillers(P);
+        LOCK_POOL(P)
+        {
+                /* Wait for waiters to leave and for connects in progress outside the lock to give back their slot */
+                while (P->pending > 0 || P->sleepers > 0)
+                        Sem_wait(P->settled, P->mutex);
+                if (P->filled) {
+                        _drainPool(P);
+                        P->filled = false;
+                }
+        }
+        END_LOCK;
 }
 
 
 Connection_T ConnectionPool_getConnection(T P) {
-	Connection_T con = NULL;
+        return ConnectionPool_getConnectionWithTimeout(P, 0);
+}
+
+
+
+
+Connection_T ConnectionPool_getConnectionWithTimeout(T P, int timeout) {
 	assert(P);
-	LOCK(P->mutex) 
-        {
-                int size = Vector_size(P->pool);
-                for (int i = 0; i < size; i++) {
-                        con = Vector_get(P->pool, i);
-                        if (Connection_isAvailable(con) && Connection_ping(con)) {
-                                Connection_setAvailable(con, false);
-                                goto done;
-                        } 
-                }
-                con = NULL;
-                if (size < P->maxConnections) {
-                        con = Connection_new(P, &P->error);
-                        if (con) {
-                                Connection_setAvailable(con, false);
-                                Vector_push(P->pool, con);
-                        } else {
-                                DEBUG("Failed to create connection -- %s\n", P->error);
-                                FREE(P->error);
-                        }
-                }
-        }
-done: 
-        END_LOCK;
-	return con;
+        assert(timeout >= 0);
+        return _getConnection(P, timeout, NULL);
+}
+
+
+Connection_T ConnectionPool_getConnectionFor(T P, const char *sql) {
+	assert(P);
+        assert(sql);
+        return _getConnection(P, 0, P->statementCacheSize > 0 ? sql : NULL);
 }
 
 
 void ConnectionPool_returnConnection(T P, Connection_T connection) {
 	assert(P);
         assert(connection);
+        Slot_T slot = Connection_getSlot(connection);
+        if (RECORD(P) && slot->borrowed) {
+                _record(&P->stats.holdTime, _micro() - slot->borrowed);
+                STAT(P, returned);
+        }
+        slot->borrowed = 0;
 	if (Connection_isInTransaction(connection)) {
                 TRY
                         Connection_rollback(connection);
@@ -359,26 +1577,119 @@ void ConnectionPool_returnConnection(T P, Connection_T connection) {
                 END_TRY;
 	}
 	Connection_clear(connection);
-	LOCK(P->mutex)
-        {
-		Connection_setAvailable(connection, true);
-        }
-	END_LOCK;
+        _returnIdle(P, connection);
 }
 
 
 int ConnectionPool_reapConnections(T P) {
-        int n = 0;
         assert(P);
-        LOCK(P->mutex)
-        {
-                n = _reapConnections(P);
+        return _reapConnections(P);
+}
+
+
+void ConnectionPool_getStatistics(T P, PoolStatistics_T *statistics) {
+        assert(P);
+        assert(statistics);
+        PoolStatistics_T *S = statistics, *from = &P->stats;
+        S->size = P->size - P->pending;
+        S->idle = P->idle;
+        S->active = _getActive(P);
+        S->waiters = P->waiters;
+        S->maxConnections = P->maxConnections;
+        S->borrowed = _load(&from->borrowed);
+        S->returned = _load(&from->returned);
+        S->exhausted = _load(&from->exhausted);
+        S->timedOut = _load(&from->timedOut);
+        S->rejected = _load(&from->rejected);
+        S->created = _load(&from->created);
+        S->createFailed = _load(&from->createFailed);
+        S->closed = _load(&from->closed);
+        S->validationFailed = _load(&from->validationFailed);
+        _loadHistogram(&S->borrowWait, &from->borrowWait);
+        _loadHistogram(&S->holdTime, &from->holdTime);
+        _loadHistogram(&S->connectTime, &from->connectTime);
+        _loadHistogram(&S->pingTime, &from->pingTime);
+        _loadHistogram(&S->lockWait, &from->lockWait);
+}
+
+
+char *ConnectionPool_exportStatistics(T P, const char *labels) {
+        PoolStatistics_T S;
+        assert(P);
+        ConnectionPool_getStatistics(P, &S);
+        const char *sep = STR_DEF(labels) ? "," : "";
+        if (! labels)
+                labels = "";
+        struct {const char *name, *help; long long value; const char *type;} metrics[] = {
+                {"connections", "Connections in the pool", S.size, "gauge"},
+                {"active", "Connections in use", S.active, "gauge"},
+                {"idle", "Idle connections", S.idle, "gauge"},
+                {"waiters", "Threads waiting for a connection", S.waiters, "gauge"},
+                {"max_connections", "Maximum number of connections", S.maxConnections, "gauge"},
+                {"borrowed_total", "Connections handed out", S.borrowed, "counter"},
+                {"returned_total", "Connections returned", S.returned, "counter"},
+                {"exhausted_total", "Requests that got no connection without waiting", S.exhausted, "counter"},
+                {"timed_out_total", "Requests that waited for a connection in vain", S.timedOut, "counter"},
+                {"rejected_total", "Requests rejected because too many threads were waiting", S.rejected, "counter"},
+                {"created_total", "Connections opened", S.created, "counter"},
+                {"create_failed_total", "Failed attempts to open a connection", S.createFailed, "counter"},
+                {"closed_total", "Connections closed by the pool", S.closed, "counter"},
+                {"validation_failed_total", "Connections that failed validation", S.validationFailed, "counter"}
+        };
+        struct {const char *name, *help; PoolHistogram_T *histogram;} histograms[] = {
+                {"borrow_wait_seconds", "Time to get a connection from the pool", &S.borrowWait},
+                {"hold_seconds", "Time a connection is held by a client", &S.holdTime},
+                {"connect_seconds", "Time to open a new connection", &S.connectTime},
+                {"ping_seconds", "Time to validate a connection", &S.pingTime},
+                {"lock_wait_seconds", "Time spent waiting for a contended pool lock", &S.lockWait}
+        };
+        StringBuffer_T sb = StringBuffer_create(4096);
+        for (int i = 0; i < (int)(sizeof(metrics) / sizeof(metrics[0])); i++) {
+                StringBuffer_append(sb, "# HELP zdb_pool_%s %s\n# TYPE zdb_pool_%s %s\n", metrics[i].name, metrics[i].help, metrics[i].name, metrics[i].type);
+                StringBuffer_append(sb, "zdb_pool_%s%s%s%s %lld\n", metrics[i].name, *labels ? "{" : "", labels, *labels ? "}" : "", metrics[i].value);
         }
-        END_LOCK;
-        return n;
+        for (int i = 0; i < (int)(sizeof(histograms) / sizeof(histograms[0])); i++) {
+                PoolHistogram_T *H = histograms[i].histogram;
+                StringBuffer_append(sb, "# HELP zdb_pool_%s %s\n# TYPE zdb_pool_%s histogram\n", histograms[i].name, histograms[i].help, histograms[i].name);
+                // Buckets at every power of four microseconds, from 1us to about 18 minutes
+                long long cumulative = 0;
+                for (int b = 0, bucket = 0; b < 16; b++) {
+                        long long le = 1LL << (2 * b);
+                        for (; bucket < POOL_HISTOGRAM_BUCKETS && _bucketLimit(bucket) <= le; bucket++)
+                                cumulative += H->buckets[bucket];
+                        StringBuffer_append(sb, "zdb_pool_%s_bucket{%s%sle=\"%.9g\"} %lld\n", histograms[i].name, labels, sep, le / 1e6, cumulative);
+                }
+                StringBuffer_append(sb, "zdb_pool_%s_bucket{%s%sle=\"+Inf\"} %lld\n", histograms[i].name, labels, sep, H->count);
+                StringBuffer_append(sb, "zdb_pool_%s_sum%s%s%s %.9g\n", histograms[i].name, *labels ? "{" : "", labels, *labels ? "}" : "", H->sum / 1e6);
+                StringBuffer_append(sb, "zdb_pool_%s_count%s%s%s %lld\n", histograms[i].name, *labels ? "{" : "", labels, *labels ? "}" : "", H->count);
+        }
+        char *text = Str_dup(StringBuffer_toString(sb));
+        StringBuffer_free(&sb);
+        return text;
 }
 
 
 const char *ConnectionPool_version(void) {
         return ABOUT;
 }
+
+
+long long ConnectionPool_percentile(const PoolHistogram_T *histogram, double percentile) {
+        assert(histogram);
+        const PoolHistogram_T *H = histogram;
+        if (H->count <= 0)
+                return 0;
+        double target = percentile * H->count / 100.0;
+        long long rank = (long long)target;
+        if (rank < target)
+                rank++;
+        if (rank < 1)
+                rank = 1;
+        long long seen = 0;
+        for (int i = 0; i < POOL_HISTOGRAM_BUCKETS; i++) {
+                seen += H->buckets[i];
+                if (seen >= rank)
+                        return _bucketLimit(i) < H->max ? _bucketLimit(i) : H->max;
+        }
+        return H->max;
+}
@@ -44,14 +44,23 @@
  * connection from the pool. If there are no connections available a new
  * connection is created and returned. If the pool has already handed out
  * <i>maxConnections</i> Connections, the next call to 
- * ConnectionPool_getConnection() will return NULL. Use Connection_close()
- * to return a connection to the pool so it can be reused.
+ * ConnectionPool_getConnection() will return NULL. Use 
+ * ConnectionPool_getConnectionWithTimeout() to instead wait in line for a 
+ * connection to be returned. Use Connection_close() to return a 
+ * connection to the pool so it can be reused.
  *
  * A connection pool is created default with 5 initial connections and 
  * with 20 maximum connections. These values can be changed by the property 
  * methods ConnectionPool_setInitialConnections() and 
  * ConnectionPool_setMaxConnections(). 
  *
+ * Idle connections are kept on a list and handed out in constant time.
+ * By default the most recently returned connection is handed out first 
+ * (LIFO), which keeps a small set of connections hot and lets the reaper
+ * close the rest. Use ConnectionPool_setPolicy() to hand out the least 
+ * recently returned connection first (FIFO) instead, which spreads the 
+ * load evenly over all connections in the pool.
+ *
  * <h2>Supported database systems:</h2>
  * This library may be built with support for many different database 
  * systems. To test if a particular system is supported use the method 
@@ -182,6 +191,17 @@
  * oracle:///servicename?user=scott&password=tiger
  * </code></dd></dt>
  * \endhtmlonly
+ *
+ * All Connections of a pool share one OCI environment. Add the parameter
+ * <code>session-pool=true</code> to the URL to let Connections take their
+ * session from an OCI session pool instead of logging on to the server
+ * each time. Prepared statements are cached per session in both cases.
+ *
+ * \htmlonly
+ * <dt><dd><code>
+ * oracle://localhost:1521/test?user=scott&password=tiger&session-pool=true
+ * </code></dd></dt>
+ * \endhtmlonly
  *  
  * <h2>Example:</h2>
  * To obtain a connection pool for a MySQL database, the code below can be
@@ -225,7 +245,15 @@
  * are closed. The property method, ConnectionPool_setReaper(), is used to specify
  * that a reaper thread should be started when the pool is started. This method 
  * <strong>must</strong> be called <i>before</i> ConnectionPool_start(), otherwise 
- * the pool will not start with a reaper thread.
+ * the pool will not start with a reaper thread. The reaper pings idle 
+ * Connections one at a time without holding the pool lock, so borrowers
+ * are not held up while it sweeps, and can keep a minimum number of warm 
+ * idle Connections in the pool, see ConnectionPool_setMinIdle().
+ *
+ * Instead of a fixed number of maximum connections the reaper can also 
+ * size the pool from observed demand, see ConnectionPool_setAutoscale(). 
+ * The pool then grows when threads have to wait for a connection and
+ * shrinks, slowly, when most of its connections stay idle.
  * 
  * Clients can also call the method, ConnectionPool_reapConnections(), to
  * bonsai the pool directly if the reaper thread is not activated.
@@ -240,6 +268,16 @@
  * returns the number of active connections, i.e. those connections in 
  * current use by your application. 
  *
+ * ConnectionPool_getStatistics() takes a snapshot of the pool without 
+ * locking it. Besides the above numbers the snapshot has counters for 
+ * borrowed, returned, created and closed connections and failed requests,
+ * and latency histograms for the time spent waiting for a connection, 
+ * holding it, connecting, validating and waiting for the pool lock. 
+ * Counters and histograms are only collected after 
+ * ConnectionPool_setCollectStatistics() turned them on.
+ * ConnectionPool_exportStatistics() formats the same snapshot for a 
+ * Prometheus scrape endpoint.
+ *
  * <i>This ConnectionPool is thread-safe.</i>
  *
  * @see Connection.h ResultSet.h URL.h PreparedStatement.h SQLException.h
@@ -250,6 +288,57 @@
 #define T ConnectionPool_T
 typedef struct ConnectionPool_S *T;
 
+/**
+ * The order in which idle Connections are handed out from the pool
+ * @see ConnectionPool_setPolicy()
+ */
+typedef enum {
+        POOL_LIFO = 0, /**< Most recently returned Connection first (default) */
+        POOL_FIFO      /**< Least recently returned Connection first */
+} PoolPolicy_T;
+
+/** Number of buckets in a PoolHistogram_T */
+#define POOL_HISTOGRAM_BUCKETS 240
+
+/**
+ * A latency histogram with values in microseconds. Buckets are HDR-style: 
+ * each power of two is split into 8 linear sub-buckets, so a value is 
+ * recorded with at most 12.5% error from 0 up to about 70 minutes. Use 
+ * ConnectionPool_percentile() to read percentiles from a histogram.
+ */
+typedef struct PoolHistogram_T {
+        long long count;        /**< Number of recorded values */
+        long long sum;          /**< Sum of recorded values */
+        long long max;          /**< Largest recorded value */
+        long long buckets[POOL_HISTOGRAM_BUCKETS];
+} PoolHistogram_T;
+
+/**
+ * A snapshot of pool counters and latency histograms
+ * @see ConnectionPool_getStatistics()
+ */
+typedef struct PoolStatistics_T {
+        int size;                       /**< Connections in the pool */
+        int active;                     /**< Connections in use */
+        int idle;                       /**< Idle Connections */
+        int waiters;                    /**< Threads waiting for a Connection */
+        int maxConnections;             /**< Maximum number of Connections */
+        long long borrowed;             /**< Connections handed out */
+        long long returned;             /**< Connections returned */
+        long long exhausted;            /**< Requests that got no Connection */
+        long long timedOut;             /**< Requests that waited in vain */
+        long long rejected;             /**< Requests rejected by max waiters */
+        long long created;              /**< Connections opened */
+        long long createFailed;         /**< Failed attempts to open a Connection */
+        long long closed;               /**< Connections closed by the pool */
+        long long validationFailed;     /**< Connections that failed validation */
+        PoolHistogram_T borrowWait;     /**< Time to get a Connection from the pool */
+        PoolHistogram_T holdTime;       /**< Time a Connection is held by a client */
+        PoolHistogram_T connectTime;    /**< Time to open a new Connection */
+        PoolHistogram_T pingTime;       /**< Time to validate a Connection */
+        PoolHistogram_T lockWait;       /**< Time spent waiting for a contended pool lock */
+} PoolStatistics_T;
+
 /**
  * Library Debug flag. If set to true, emit debug output 
  */
@@ -304,6 +393,28 @@ void ConnectionPool_setInitialConnections(T P, int connections);
 int ConnectionPool_getInitialConnections(T P);
 
 
+/**
+ * Set the number of initial connections ConnectionPool_start() should wait 
+ * for. The initial connections are opened in parallel and start returns as
+ * soon as <code>connections</code> of them are ready. The remaining initial 
+ * connections are opened in the background while the pool is already in
+ * use. The default value 0 means that start waits for all initial 
+ * connections to be opened.
+ * @param P A ConnectionPool object
+ * @param connections The number of initial connections to wait for, 0 
+ * for all. It is a checked runtime error for connections to be less than 0
+ */
+void ConnectionPool_setReadyConnections(T P, int connections);
+
+
+/**
+ * Get the number of initial connections ConnectionPool_start() waits for
+ * @param P A ConnectionPool object
+ * @return The number of initial connections to wait for, 0 for all
+ */
+int ConnectionPool_getReadyConnections(T P);
+
+
 /**
  * Set the maximum number of connections this connection pool will
  * create. If max connections has been served, ConnectionPool_getConnection()
@@ -369,13 +480,280 @@ int ConnectionPool_getConnectionTimeout(T P);
 void ConnectionPool_setAbortHandler(T P, void(*abortHandler)(const char *error));
 
 
+/**
+ * Set the order in which idle Connections are handed out by 
+ * ConnectionPool_getConnection(). With POOL_LIFO, the default, the 
+ * most recently returned Connection is handed out first. With POOL_FIFO
+ * the Connection that has been idle the longest is handed out first.
+ * @param P A ConnectionPool object
+ * @param policy Either POOL_LIFO or POOL_FIFO
+ */
+void ConnectionPool_setPolicy(T P, PoolPolicy_T policy);
+
+
+/**
+ * Get the order in which idle Connections are handed out from the pool
+ * @param P A ConnectionPool object
+ * @return The pool policy, either POOL_LIFO or POOL_FIFO
+ */
+PoolPolicy_T ConnectionPool_getPolicy(T P);
+
+
+/**
+ * Split the pool into a number of stripes. Each stripe has its own lock 
+ * and list of idle Connections. A thread returns Connections to, and 
+ * borrows Connections from, its home stripe and only steals from the 
+ * other stripes when its home stripe is empty. On hosts with many cores 
+ * this spreads the contention that would otherwise be on one pool lock.
+ * <i>maxConnections</i> and <i>initialConnections</i> still apply to the 
+ * pool as a whole. With more than one stripe, the pool policy applies to
+ * each stripe on its own. This method must be called <b>before</b> 
+ * ConnectionPool_start(). The default is 1 stripe.
+ * @param P A ConnectionPool object
+ * @param stripes The number of stripes. It is a checked runtime error
+ * for stripes to be less than 1.
+ */
+void ConnectionPool_setStripes(T P, int stripes);
+
+
+/**
+ * Get the number of stripes in the pool
+ * @param P A ConnectionPool object
+ * @return The number of stripes
+ */
+int ConnectionPool_getStripes(T P);
+
+
+/**
+ * Enable or disable thread affinity. With thread affinity each thread
+ * remembers the Connection it returned last and ConnectionPool_getConnection()
+ * first tries to take that Connection back with a single atomic operation,
+ * without locking the pool. A thread that borrows and returns a Connection 
+ * per request will then usually get the same Connection, and with it the
+ * same warm server session, each time. If the Connection was taken by 
+ * another thread in the meantime the pool is used as usual. This method 
+ * must be called <b>before</b> ConnectionPool_start(). Default is false.
+ * @param P A ConnectionPool object
+ * @param affinity true to enable thread affinity, otherwise false
+ */
+void ConnectionPool_setAffinity(T P, int affinity);
+
+
+/**
+ * Returns true if thread affinity is enabled
+ * @param P A ConnectionPool object
+ * @return true if thread affinity is enabled, otherwise false
+ */
+int ConnectionPool_getAffinity(T P);
+
+
+/**
+ * Set the maximum number of threads that may wait for a Connection in
+ * ConnectionPool_getConnectionWithTimeout() at the same time. A request 
+ * arriving when this many threads are already waiting is rejected at 
+ * once instead of being queued. The default is no limit. 
+ * @param P A ConnectionPool object
+ * @param maxWaiters The maximum number of waiting threads. If 0, 
+ * ConnectionPool_getConnectionWithTimeout() never waits. It is a checked 
+ * runtime error for maxWaiters to be less than 0.
+ */
+void ConnectionPool_setMaxWaiters(T P, int maxWaiters);
+
+
+/**
+ * Get the maximum number of threads that may wait for a Connection
+ * @param P A ConnectionPool object
+ * @return The maximum number of waiting threads
+ */
+int ConnectionPool_getMaxWaiters(T P);
+
+
+/**
+ * Set how long a returned Connection is trusted without validation. 
+ * ConnectionPool_getConnection() validates a Connection before it is 
+ * handed out, unless the Connection was returned to the pool less than
+ * <code>validationInterval</code> milliseconds ago. Validation uses the
+ * cheapest check the database backend supports; for MySQL and PostgreSQL
+ * a non-blocking poll of the connection socket detects a connection 
+ * closed or reset by the server without a round-trip, for other systems
+ * the Connection is pinged. The default is 0, validate on every borrow.
+ * @param P A ConnectionPool object
+ * @param validationInterval Number of milliseconds a returned Connection
+ * is trusted. It is a checked runtime error for validationInterval to be
+ * less than 0.
+ */
+void ConnectionPool_setValidationInterval(T P, int validationInterval);
+
+
+/**
+ * Get the number of milliseconds a returned Connection is trusted 
+ * without validation
+ * @param P A ConnectionPool object
+ * @return The validation interval in milliseconds
+ */
+int ConnectionPool_getValidationInterval(T P);
+
+
+/**
+ * Set the minimum number of idle Connections the reaper thread 
+ * should keep in the pool. After each sweep, the reaper thread 
+ * opens new Connections until at least <code>minIdle</code> Connections
+ * are idle, as long as <i>maxConnections</i> is not exceeded, so 
+ * borrowers do not have to wait for a Connection to be established, 
+ * for instance after a database failover. Connections found dead on 
+ * borrow also wake the reaper thread so they are replaced without
+ * delay. Requires a reaper thread, see ConnectionPool_setReaper().
+ * The default is 0.
+ * @param P A ConnectionPool object
+ * @param minIdle The minimum number of idle Connections. It is a checked 
+ * runtime error for minIdle to be less than 0 or larger than maxConnections
+ */
+void ConnectionPool_setMinIdle(T P, int minIdle);
+
+
+/**
+ * Get the minimum number of idle Connections kept by the maintenance thread
+ * @param P A ConnectionPool object
+ * @return The minimum number of idle Connections
+ */
+int ConnectionPool_getMinIdle(T P);
+
+
+/**
+ * Turn collection of the counters and latency histograms reported by 
+ * ConnectionPool_getStatistics() on or off. Collecting costs two clock 
+ * reads and a few atomic updates of shared counters per borrow and 
+ * return, so it is off by default. An autoscaling pool always collects,
+ * see ConnectionPool_setAutoscale(). Values collected earlier are kept 
+ * when collection is turned off.
+ * @param P A ConnectionPool object
+ * @param collect true to collect statistics, false to stop
+ */
+void ConnectionPool_setCollectStatistics(T P, int collect);
+
+
+/**
+ * Returns true if the pool collects statistics
+ * @param P A ConnectionPool object
+ * @return true if statistics are collected, otherwise false
+ */
+int ConnectionPool_getCollectStatistics(T P);
+
+
+/**
+ * Let the reaper thread size the pool from observed demand. At each sweep
+ * the reaper adjusts the pool target, i.e. ConnectionPool_getMaxConnections(),
+ * between <code>minConnections</code> and <code>maxConnections</code>. The 
+ * target grows by a quarter when the pool is at its target and threads had 
+ * to wait longer than ConnectionPool_getAutoscaleWait(), timed out or were
+ * turned away, or when more than 80% of the target was busy. The target 
+ * shrinks by a quarter only after three sweeps in a row where less than 
+ * 40% of the target was busy, and the reaper then closes idle Connections 
+ * above the target. Busy is the average number of Connections in use since 
+ * the previous sweep. A reaper thread must be set with 
+ * ConnectionPool_setReaper() for the pool to autoscale.
+ * @param P A ConnectionPool object
+ * @param minConnections The smallest target. It is a checked runtime error
+ * for minConnections to be less than 1 or larger than maxConnections
+ * @param maxConnections The largest target. It is a checked runtime error
+ * for maxConnections to be less than initialConnections
+ */
+void ConnectionPool_setAutoscale(T P, int minConnections, int maxConnections);
+
+
+/**
+ * Returns true if the pool is autoscaling
+ * @param P A ConnectionPool object
+ * @return true if ConnectionPool_setAutoscale() was called, otherwise false
+ */
+int ConnectionPool_getAutoscale(T P);
+
+
+/**
+ * Set the borrow wait in milliseconds that makes an autoscaling pool grow.
+ * If the 99th percentile borrow wait since the previous sweep is above 
+ * this value the pool grows. The default is 10 ms.
+ * @param P A ConnectionPool object
+ * @param milliseconds The borrow wait that triggers growth. It is a checked
+ * runtime error for milliseconds to be less than 0
+ */
+void ConnectionPool_setAutoscaleWait(T P, int milliseconds);
+
+
+/**
+ * Get the borrow wait in milliseconds that makes an autoscaling pool grow
+ * @param P A ConnectionPool object
+ * @return The borrow wait in milliseconds
+ */
+int ConnectionPool_getAutoscaleWait(T P);
+
+
+/**
+ * Set the size of the per Connection statement cache. When the size is 
+ * larger than 0, each Connection keeps up to <code>size</code> 
+ * PreparedStatements, keyed by their SQL, across borrows and 
+ * Connection_prepareStatement() reuses them instead of preparing the 
+ * statement again. The least recently used statement is closed when the 
+ * cache is full. Statements hold resources on the database server, so 
+ * the cache is disabled by default.
+ * @param P A ConnectionPool object
+ * @param size The number of statements to cache per Connection, 0 to 
+ * disable. It is a checked runtime error for size to be less than 0
+ */
+void ConnectionPool_setStatementCacheSize(T P, int size);
+
+
+/**
+ * Get the size of the per Connection statement cache
+ * @param P A ConnectionPool object
+ * @return The number of statements cached per Connection, 0 if disabled
+ */
+int ConnectionPool_getStatementCacheSize(T P);
+
+
+/**
+ * Add a SQL statement to run on each new Connection before it is put in
+ * the pool, such as a session setting. Statements run in the order they 
+ * were added, in the thread opening the Connection: the filler threads in 
+ * ConnectionPool_start(), the reaper thread when it keeps 
+ * ConnectionPool_setMinIdle() warm Connections or the borrowing thread. If
+ * a statement fails, the Connection is closed and counts as a failed
+ * connect. Example:
+ * <pre>
+ * ConnectionPool_addInitStatement(pool, "SET TIME ZONE 'UTC'");
+ * </pre>
+ * It is a checked runtime error to call this method after the pool was 
+ * started.
+ * @param P A ConnectionPool object
+ * @param sql A single SQL statement, it is copied
+ */
+void ConnectionPool_addInitStatement(T P, const char *sql);
+
+
+/**
+ * Add a SQL statement to prepare on each new Connection before it is put
+ * in the pool. The statement is kept in the Connection's statement cache
+ * so the first Connection_prepareStatement() with the same SQL does not 
+ * need a round-trip to the database. Statements are prepared after the 
+ * init statements and only if the statement cache is enabled, see 
+ * ConnectionPool_setStatementCacheSize(). It is a checked runtime error 
+ * to call this method after the pool was started.
+ * @param P A ConnectionPool object
+ * @param sql A single SQL statement as it will be given to 
+ * Connection_prepareStatement(), it is copied
+ */
+void ConnectionPool_addPreparedStatement(T P, const char *sql);
+
+
 /**
  * Specify that a reaper thread should be used by the pool. This thread 
  * will close all inactive Connections in the pool, down to initial 
  * connections. An inactive Connection is closed if and only if its 
  * <code>connectionTimeout</code> has expired <i>or</i> if the Connection
  * failed the ping test. Active Connections, that is, connections in current
- * use by your application are <i>never </i> closed by this thread. This 
+ * use by your application are <i>never </i> closed by this thread. After
+ * each sweep the thread opens new Connections if needed to keep at least
+ * ConnectionPool_getMinIdle() Connections idle. This 
  * method sets the reaper thread sweep property, but does not start the
  * thread. This is done in ConnectionPool_start(). So, if the pool should 
  * use a reaper thread, remember to call this method <b>before</b> 
@@ -399,21 +777,36 @@ int ConnectionPool_size(T P);
 
 /**
  * Returns the number of active connections in the pool. I.e. connections
- * in use by clients.
+ * in use by clients. The pool is not locked so the value may be slightly 
+ * behind when connections are concurrently borrowed or returned.
  * @param P A ConnectionPool object
  * @return The number of active connections in the pool
  */
 int ConnectionPool_active(T P);
 
+
+/**
+ * Returns the number of threads currently waiting in line for a 
+ * Connection in ConnectionPool_getConnectionWithTimeout()
+ * @param P A ConnectionPool object
+ * @return The number of waiting threads
+ */
+int ConnectionPool_waiters(T P);
+
 //@}
 
 /**
  * Prepare for the beginning of active use of this component. This method
  * must be called before the pool is used and will connect to the database
- * server and create the initial connections for the pool. This method will
- * also start the reaper thread if specified via ConnectionPool_setReaper().
+ * server and create the initial connections for the pool. The initial 
+ * connections are opened in parallel on a small group of threads, without 
+ * holding the pool lock. If ConnectionPool_setReadyConnections() was used,
+ * this method returns as soon as that many connections are ready and the 
+ * rest are opened in the background. This method will also start the 
+ * reaper thread if specified via ConnectionPool_setReaper().
  * @param P A ConnectionPool object
- * @exception SQLException If a database error occurs.
+ * @exception SQLException If not a single initial connection could be 
+ * opened.
  * @see SQLException.h
  */
 void ConnectionPool_start(T P);
@@ -431,14 +824,56 @@ void ConnectionPool_stop(T P);
 
 
 /**
- * Get a connection from the pool
+ * Get a connection from the pool. The pool lock is only held while an
+ * idle Connection is taken or a slot for a new Connection is reserved;
+ * validating the Connection and connecting to the database is done 
+ * without the lock so a slow database server does not block other 
+ * threads. A Connection that fails validation is closed and the next 
+ * one is tried.
  * @param P A ConnectionPool object
- * @return A connection from the pool or NULL if maxConnection is reached
+ * @return A connection from the pool or NULL if maxConnection is reached,
+ * the pool is stopped or a new Connection could not be established
  * @see Connection.h
  */
 Connection_T ConnectionPool_getConnection(T P);
 
 
+/**
+ * Get a connection from the pool, waiting up to <code>timeout</code> 
+ * milliseconds for one to become available if <i>maxConnections</i> 
+ * Connections are already in use. Waiting threads are served in the 
+ * order they arrived; a returned Connection is handed directly to the
+ * thread that has waited the longest. If ConnectionPool_getMaxWaiters()
+ * threads are already waiting, NULL is returned immediately.
+ * @param P A ConnectionPool object
+ * @param timeout The maximum number of milliseconds to wait. If 0 this 
+ * method behaves like ConnectionPool_getConnection()
+ * @return A connection from the pool or NULL if none became available 
+ * before the timeout, the request was rejected or the pool is stopped
+ * @see Connection.h
+ */
+Connection_T ConnectionPool_getConnectionWithTimeout(T P, int timeout);
+
+
+/**
+ * Get a connection from the pool for running the statement 
+ * <code>sql</code>. If the pool has a statement cache, see 
+ * ConnectionPool_setStatementCacheSize(), an idle Connection which 
+ * already has a prepared statement for <code>sql</code> is preferred, 
+ * so Connection_prepareStatement() can reuse it without a round-trip to 
+ * the database. Only the most recently returned idle Connections are 
+ * searched. Otherwise, and if no such Connection is idle, this method 
+ * behaves like ConnectionPool_getConnection().
+ * @param P A ConnectionPool object
+ * @param sql The SQL statement as it will be given to 
+ * Connection_prepareStatement()
+ * @return A connection from the pool or NULL if maxConnection is reached,
+ * the pool is stopped or a new Connection could not be established
+ * @see Connection.h
+ */
+Connection_T ConnectionPool_getConnectionFor(T P, const char *sql);
+
+
 /**
  * Returns a connection to the pool. The same as calling Connection_close()
  * @param P A ConnectionPool object
@@ -460,6 +895,37 @@ void ConnectionPool_returnConnection(T P, Connection_T connection);
 int ConnectionPool_reapConnections(T P);
 
 
+/**
+ * Take a snapshot of the pool statistics. The pool is not locked, each 
+ * value is read atomically but the snapshot as a whole may mix values 
+ * from before and after a concurrent borrow or return. Counters and 
+ * histograms accumulate while statistics are collected, see 
+ * ConnectionPool_setCollectStatistics(). The gauges, size, active, idle, 
+ * waiters and maxConnections, are always current.
+ * @param P A ConnectionPool object
+ * @param statistics The snapshot is written to this object
+ */
+void ConnectionPool_getStatistics(T P, PoolStatistics_T *statistics);
+
+
+/**
+ * Returns a snapshot of the pool statistics in the Prometheus text 
+ * exposition format. Metric names are prefixed with <code>zdb_pool_</code>
+ * and latencies are exported as histograms in seconds. Example:
+ * <pre>
+ * char *text = ConnectionPool_exportStatistics(pool, "pool=\"main\"");
+ * [..] // Write text to the HTTP response
+ * free(text);
+ * </pre>
+ * @param P A ConnectionPool object
+ * @param labels Labels added to every sample, e.g. <code>pool="main"</code>,
+ * or NULL
+ * @return A new string with the exported statistics. The caller must 
+ * release the string with free(3)
+ */
+char *ConnectionPool_exportStatistics(T P, const char *labels);
+
+
 /** @name Class methods */
 //@{
 
@@ -469,6 +935,18 @@ int ConnectionPool_reapConnections(T P);
  */
 const char *ConnectionPool_version(void);
 
+
+/**
+ * <b>Class method</b>, returns the value at the given percentile of a 
+ * histogram. The value returned is the upper bound of the bucket where
+ * the percentile falls, but never more than the largest recorded value
+ * @param histogram A histogram from a PoolStatistics_T snapshot
+ * @param percentile The percentile, from 0.0 to 100.0, e.g. 99.9
+ * @return The value at the percentile in microseconds or 0 if the 
+ * histogram is empty
+ */
+long long ConnectionPool_percentile(const PoolHistogram_T *histogram, double percentile);
+
 // @}
 
 #undef T
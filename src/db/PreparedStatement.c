@@ -26,6 +26,8 @@
 #include "Config.h"
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "ResultSet.h"
 #include "PreparedStatement.h"
@@ -46,7 +48,13 @@ struct PreparedStatement_S {
         Pop_T op;
         int parameterCount;
         int fetchSize;
+        int batchSize;
+        int batchCapacity;
+        Param_T *params;
+        Param_T *batch;
+        long long *counts;
         ResultSet_T resultSet;
+        ColumnIndex_T columnIndex; // Kept across executions, see ResultSet_shareIndex()
         PreparedStatementDelegate_T D;
 };
 
@@ -60,6 +68,57 @@ static void _clearResultSet(T P) {
 }
 
 
+/* Remember the parameter value just set so addBatch can copy it. The value
+ is recorded by reference, like the delegate does, and copied on addBatch */
+static inline Param_T *_param(T P, int parameterIndex) {
+        int i = parameterIndex - 1;
+        return (P->params && i >= 0 && i < P->parameterCount) ? &P->params[i] : NULL;
+}
+
+
+static void _clearBatch(T P) {
+        int n = P->batchSize * P->parameterCount;
+        for (int i = 0; i < n; i++) {
+                if (P->batch[i].type == PARAM_STRING || P->batch[i].type == PARAM_BLOB) {
+                        void *data = (void *)P->batch[i].value.data;
+                        FREE(data);
+                }
+        }
+        P->batchSize = 0;
+}
+
+
+/* Reset the parameters to NULL after a batch, the delegate may still be bound to the batch copies */
+static void _endBatch(T P) {
+        for (int i = 0; i < P->parameterCount; i++)
+                P->op->setString(P->D, i + 1, NULL);
+        _clearBatch(P);
+        if (P->params)
+                memset(P->params, 0, P->parameterCount * sizeof(Param_T));
+}
+
+
+/* Execute the batch one row at a time with the delegate's setters */
+static void _executeRows(T P) {
+        for (int r = 0; r < P->batchSize; r++) {
+                const Param_T *row = P->batch + (r * P->parameterCount);
+                for (int i = 0; i < P->parameterCount; i++) {
+                        switch (row[i].type) {
+                                case PARAM_NULL:      P->op->setString(P->D, i + 1, NULL); break;
+                                case PARAM_STRING:    P->op->setString(P->D, i + 1, row[i].value.data); break;
+                                case PARAM_INT:       P->op->setInt(P->D, i + 1, (int)row[i].value.integer); break;
+                                case PARAM_LLONG:     P->op->setLLong(P->D, i + 1, row[i].value.integer); break;
+                                case PARAM_DOUBLE:    P->op->setDouble(P->D, i + 1, row[i].value.real); break;
+                                case PARAM_TIMESTAMP: P->op->setTimestamp(P->D, i + 1, (time_t)row[i].value.integer); break;
+                                case PARAM_BLOB:      P->op->setBlob(P->D, i + 1, row[i].value.data, row[i].size); break;
+                        }
+                }
+                P->op->execute(P->D);
+                P->counts[r] = P->op->rowsChanged(P->D);
+        }
+}
+
+
 /* ----------------------------------------------------- Protected methods */
 
 
@@ -75,6 +134,8 @@ T PreparedStatement_new(PreparedStatementDelegate_T D, Pop_T op, int parameterCo
 	P->D = D;
 	P->op = op;
         P->parameterCount = parameterCount;
+        if (P->parameterCount > 0)
+                P->params = CALLOC(P->parameterCount, sizeof(Param_T));
 	return P;
 }
 
@@ -82,10 +143,29 @@ T PreparedStatement_new(PreparedStatementDelegate_T D, Pop_T op, int parameterCo
 void PreparedStatement_free(T *P) {
 	assert(P && *P);
         _clearResultSet((*P));
+        _clearBatch((*P));
+        ResultSet_freeIndex(&(*P)->columnIndex);
         (*P)->op->free(&(*P)->D);
+        FREE((*P)->params);
+        FREE((*P)->batch);
+        FREE((*P)->counts);
 	FREE(*P);
 }
 
+
+void PreparedStatement_clear(T P) {
+        assert(P);
+        _clearResultSet(P);
+        _clearBatch(P);
+}
+
+
+void PreparedStatement_setCached(T P) {
+        assert(P);
+        if (P->op->setCached)
+                P->op->setCached(P->D);
+}
+
 #ifdef PACKAGE_PROTECTED
 #pragma GCC visibility pop
 #endif
@@ -97,36 +177,67 @@ void PreparedStatement_free(T *P) {
 void PreparedStatement_setString(T P, int parameterIndex, const char *x) {
 	assert(P);
         P->op->setString(P->D, parameterIndex, x);
+        Param_T *p = _param(P, parameterIndex);
+        if (p) {
+                p->type = x ? PARAM_STRING : PARAM_NULL;
+                p->value.data = x;
+        }
 }
 
 
 void PreparedStatement_setInt(T P, int parameterIndex, int x) {
 	assert(P);
         P->op->setInt(P->D, parameterIndex, x);
+        Param_T *p = _param(P, parameterIndex);
+        if (p) {
+                p->type = PARAM_INT;
+                p->value.integer = x;
+        }
 }
 
 
 void PreparedStatement_setLLong(T P, int parameterIndex, long long x) {
 	assert(P);
         P->op->setLLong(P->D, parameterIndex, x);
+        Param_T *p = _param(P, parameterIndex);
+        if (p) {
+                p->type = PARAM_LLONG;
+                p->value.integer = x;
+        }
 }
 
 
 void PreparedStatement_setDouble(T P, int parameterIndex, double x) {
 	assert(P);
         P->op->setDouble(P->D, parameterIndex, x);
+        Param_T *p = _param(P, parameterIndex);
+        if (p) {
+                p->type = PARAM_DOUBLE;
+                p->value.real = x;
+        }
 }
 
 
 void PreparedStatement_setBlob(T P, int parameterIndex, const void *x, int size) {
 	assert(P);
         P->op->setBlob(P->D, parameterIndex, x, size);
+        Param_T *p = _param(P, parameterIndex);
+        if (p) {
+                p->type = x ? PARAM_BLOB : PARAM_NULL;
+                p->value.data = x;
+                p->size = x ? size : 0;
+        }
 }
 
 
 void PreparedStatement_setTimestamp(T P, int parameterIndex, time_t x) {
         assert(P);
         P->op->setTimestamp(P->D, parameterIndex, x);
+        Param_T *p = _param(P, parameterIndex);
+        if (p) {
+                p->type = PARAM_TIMESTAMP;
+                p->value.integer = x;
+        }
 }
 
 
@@ -146,6 +257,7 @@ ResultSet_T PreparedStatement_executeQuery(T P) {
 	P->resultSet = P->op->executeQuery(P->D);
         if (! P->resultSet)
                 THROW(SQLException, "PreparedStatement_executeQuery");
+        ResultSet_shareIndex(P->resultSet, &P->columnIndex);
         return P->resultSet;
 }
 
@@ -156,6 +268,66 @@ long long PreparedStatement_rowsChanged(T P) {
 }
 
 
+void PreparedStatement_addBatch(T P) {
+        assert(P);
+        if (P->batchSize >= P->batchCapacity) {
+                if (P->batchCapacity) {
+                        P->batchCapacity *= 2;
+                        RESIZE(P->counts, (long)P->batchCapacity * sizeof(long long));
+                        if (P->parameterCount > 0)
+                                RESIZE(P->batch, (long)P->batchCapacity * P->parameterCount * sizeof(Param_T));
+                } else {
+                        P->batchCapacity = 16;
+                        P->counts = ALLOC((long)P->batchCapacity * sizeof(long long));
+                        if (P->parameterCount > 0)
+                                P->batch = ALLOC((long)P->batchCapacity * P->parameterCount * sizeof(Param_T));
+                }
+        }
+        Param_T *row = P->batch + (P->batchSize * P->parameterCount);
+        for (int i = 0; i < P->parameterCount; i++) {
+                row[i] = P->params[i];
+                if (row[i].type == PARAM_STRING) {
+                        row[i].size = (int)strlen(row[i].value.data);
+                        row[i].value.data = Str_ndup(row[i].value.data, row[i].size);
+                } else if (row[i].type == PARAM_BLOB) {
+                        void *data = ALLOC(row[i].size + 1);
+                        memcpy(data, row[i].value.data, row[i].size);
+                        row[i].value.data = data;
+                }
+        }
+        P->batchSize++;
+}
+
+
+void PreparedStatement_clearBatch(T P) {
+        assert(P);
+        _clearBatch(P);
+}
+
+
+const long long *PreparedStatement_executeBatch(T P, int *size) {
+        assert(P);
+        assert(size);
+        _clearResultSet(P);
+        *size = P->batchSize;
+        if (P->batchSize == 0)
+                return P->counts;
+        TRY
+        {
+                if (! P->op->executeBatch || ! P->op->executeBatch(P->D, P->batch, P->batchSize, P->counts))
+                        _executeRows(P);
+        }
+        ELSE
+        {
+                _endBatch(P);
+                THROW(SQLException, "%s", Exception_frame.message);
+        }
+        END_TRY;
+        _endBatch(P);
+        return P->counts;
+}
+
+
 /* ------------------------------------------------------------ Properties */
 
 
@@ -164,11 +336,18 @@ int PreparedStatement_getParameterCount(T P) {
         return P->parameterCount;
 }
 
+
+int PreparedStatement_getBatchSize(T P) {
+        assert(P);
+        return P->batchSize;
+}
+
 void PreparedStatement_setFetchSize(T P, int prefetch_rows)
 {
         assert(P);
         P->fetchSize = prefetch_rows;
-        P->op->setFetchSize(P->D, prefetch_rows);
+        if (P->op->setFetchSize)
+                P->op->setFetchSize(P->D, prefetch_rows);
 }
 
 int PreparedStatement_getFetchSize(T P)
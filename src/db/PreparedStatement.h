@@ -26,6 +26,37 @@
 #ifndef PREPAREDSTATEMENT_INCLUDED
 #define PREPAREDSTATEMENT_INCLUDED
 #include <time.h>
+
+
+/**
+ * The type of a Param_T value
+ */
+typedef enum {
+        PARAM_NULL = 0,
+        PARAM_STRING,
+        PARAM_INT,
+        PARAM_LLONG,
+        PARAM_DOUBLE,
+        PARAM_TIMESTAMP,
+        PARAM_BLOB
+} ParamType_T;
+
+/**
+ * A typed parameter value, as passed to Connection_executeParams() and 
+ * captured for a batch row by PreparedStatement_addBatch(). String data
+ * must be NUL terminated and string and blob data are referenced, not
+ * copied, by Connection_executeParams().
+ */
+typedef struct Param_T {
+        ParamType_T type;
+        union {
+                long long integer;      /* PARAM_INT, PARAM_LLONG and PARAM_TIMESTAMP */
+                double real;            /* PARAM_DOUBLE */
+                const void *data;       /* PARAM_STRING (NUL terminated) and PARAM_BLOB */
+        } value;
+        int size;                       /* Number of bytes in data */
+} Param_T;
+
 //<< Protected methods
 #include "PreparedStatementDelegate.h"
 //>> End Protected methods
@@ -94,6 +125,28 @@
  * the Prepared Statement is executed again or until the Connection is
  * returned to the Connection Pool. 
  *
+ * <h3>Batch:</h3>
+ * Many rows can be sent to the database in one go by adding each set of
+ * <i>in</i> parameter values to the statement's batch with 
+ * PreparedStatement_addBatch() and then executing them all with 
+ * PreparedStatement_executeBatch(). Parameter values are copied when added,
+ * so they do not need to outlive the call. Each database uses its native 
+ * bulk path: Oracle binds arrays of parameters, MySQL rewrites 
+ * <code>INSERT .. VALUES (..)</code> into multi-row inserts, PostgreSQL 
+ * pipelines the executes and SQLite executes the rows in a single 
+ * transaction. 
+ * <pre>
+ * PreparedStatement_T p = Connection_prepareStatement(con, "INSERT INTO employee(name, age) VALUES(?, ?)");
+ * for (int i = 0; employees[i].name; i++) 
+ * {
+ *        PreparedStatement_setString(p, 1, employees[i].name);
+ *        PreparedStatement_setInt(p, 2, employees[i].age);
+ *        PreparedStatement_addBatch(p);
+ * }
+ * int rows;
+ * const long long *counts = PreparedStatement_executeBatch(p, &rows);
+ * </pre>
+ *
  * <h3>Date and Time</h3>
  * PreparedStatement provides PreparedStatement_setTimestamp() for setting a
  * Unix timestamp value. To set SQL Date, Time or DateTime values, simply use
@@ -113,6 +166,13 @@
 #define T PreparedStatement_T
 typedef struct PreparedStatement_S *T;
 
+/**
+ * Update count of a batch row which was executed successfully, but where
+ * the database did not report the number of rows changed by that row
+ * @see PreparedStatement_executeBatch()
+ */
+#define BATCH_SUCCESS_NO_INFO -2
+
 //<< Protected methods
 
 /**
@@ -131,6 +191,22 @@ T PreparedStatement_new(PreparedStatementDelegate_T D, Pop_T op, int parameterCo
  */
 void PreparedStatement_free(T *P);
 
+
+/**
+ * Close the ResultSet of this PreparedStatement, if any, so the statement
+ * can be kept in the Connection's statement cache between borrows.
+ * @param P A PreparedStatement object
+ */
+void PreparedStatement_clear(T P);
+
+
+/**
+ * Tell the delegate that this PreparedStatement is kept in the Connection's
+ * statement cache, so work done once for the statement pays off.
+ * @param P A PreparedStatement object
+ */
+void PreparedStatement_setCached(T P);
+
 //>> End Protected methods
 
 /** @name Parameters */
@@ -272,6 +348,56 @@ ResultSet_T PreparedStatement_executeQuery(T P);
 long long PreparedStatement_rowsChanged(T P);
 
 
+/** @name Batch */
+//@{
+
+/**
+ * Adds the current set of <i>in</i> parameter values to this 
+ * PreparedStatement's batch. String and blob values are copied, so unlike
+ * for PreparedStatement_execute() they only need to live until this call
+ * returns. A parameter keeps the value it was last set to, so a string or
+ * blob set for an earlier row, and not set again, must still be valid when
+ * this method is called. A parameter which has not been set since the 
+ * statement was prepared or since the last PreparedStatement_executeBatch()
+ * is added as SQL NULL.
+ * @param P A PreparedStatement object
+ * @see PreparedStatement_executeBatch()
+ */
+void PreparedStatement_addBatch(T P);
+
+
+/**
+ * Executes all rows added with PreparedStatement_addBatch() and clears
+ * the batch. The rows are sent using the database's bulk path, so a 
+ * batch of many rows costs a few round trips instead of one per row.
+ * Without an explicit transaction, rows which were executed before a
+ * failing row may or may not be committed, depending on the database. 
+ * Use a transaction if the batch should be all or nothing. 
+ * <i>All parameters of the statement are reset to SQL NULL by this call,
+ * also if it throws, as the values of the last row are released.</i>
+ * @param P A PreparedStatement object
+ * @param size The number of rows executed is stored in size
+ * @return An array with the number of rows changed by each row in the
+ * batch, or BATCH_SUCCESS_NO_INFO if the database did not report the 
+ * count for a row. The array is owned by the PreparedStatement and is
+ * valid until the next call to PreparedStatement_addBatch()
+ * @exception SQLException If a database error occurs. The batch is 
+ * cleared also in this case
+ * @see SQLException.h
+ */
+const long long *PreparedStatement_executeBatch(T P, int *size);
+
+
+/**
+ * Removes all rows added with PreparedStatement_addBatch() without
+ * executing them.
+ * @param P A PreparedStatement object
+ */
+void PreparedStatement_clearBatch(T P);
+
+//@}
+
+
 /** @name Properties */
 //@{
 
@@ -282,10 +408,33 @@ long long PreparedStatement_rowsChanged(T P);
  */
 int PreparedStatement_getParameterCount(T P);
 
+
+/**
+ * Returns the number of rows added with PreparedStatement_addBatch() and
+ * not yet executed.
+ * @param P A PreparedStatement object
+ * @return The number of rows in the batch
+ */
+int PreparedStatement_getBatchSize(T P);
+
 //@}
 
-//set prefetch size, just like JDBC
+/**
+ * Sets the number of rows to fetch from the database at a time for 
+ * ResultSets returned by PreparedStatement_executeQuery(). On PostgreSQL
+ * the default is the Connection's default row prefetch and a value 
+ * greater than 0 streams the result, see Connection_setDefaultRowPrefetch()
+ * @param P A PreparedStatement object
+ * @param prefetch_rows The number of rows to fetch at a time
+ */
 void PreparedStatement_setFetchSize(T P, int prefetch_rows);
+
+
+/**
+ * Returns the fetch size set with PreparedStatement_setFetchSize()
+ * @param P A PreparedStatement object
+ * @return The number of rows to fetch at a time
+ */
 int PreparedStatement_getFetchSize(T P);
 
 #undef T
@@ -48,7 +48,16 @@ typedef struct Pop_T {
         void (*execute)(T P);
         ResultSet_T (*executeQuery)(T P);
         long long (*rowsChanged)(T P);
+        // Optional
         void (*setFetchSize)(T P, int prefetch_rows);
+        /* Optional. Execute count rows of parameters, where the parameter at
+         index i in row r is rows[r * parameterCount + i], and store the update
+         count of each row in counts. Return false to let PreparedStatement
+         execute the rows one at a time instead */
+        int (*executeBatch)(T P, const Param_T *rows, int count, long long *counts);
+        /* Optional. The statement is kept in the Connection's statement cache
+         and will likely be executed again */
+        void (*setCached)(T P);
 } *Pop_T;
 
 /**
@@ -41,10 +41,21 @@
 /* ----------------------------------------------------------- Definitions */
 
 
+/* Open addressing hash table from column name to column number */
+struct ColumnIndex_S {
+        int columns;            // Number of columns indexed
+        unsigned mask;          // Number of slots - 1, slots is a power of 2
+        int *slots;             // Column number or 0 if the slot is empty
+        unsigned *hashes;       // Name hash by column number - 1
+};
+
 #define T ResultSet_T
 struct ResultSet_S {
         Rop_T op;
         int fetchSize;
+        int verified;           // The index was built or verified for this result
+        ColumnIndex_T index;
+        ColumnIndex_T *shared;  // Index kept by the statement across executions
         ResultSetDelegate_T D;
 };
 
@@ -52,11 +63,72 @@ struct ResultSet_S {
 /* ------------------------------------------------------- Private methods */
 
 
+/* FNV-1a */
+static inline unsigned _hash(const char *s) {
+        unsigned h = 2166136261u;
+        while (*s)
+                h = (h ^ (unsigned char)*s++) * 16777619u;
+        return h;
+}
+
+
+static ColumnIndex_T _buildIndex(T R) {
+        ColumnIndex_T I;
+        int columns = R->op->getColumnCount(R->D);
+        unsigned size = 8;
+        while (size < 2 * (unsigned)columns)
+                size <<= 1;
+        NEW(I);
+        I->columns = columns;
+        I->mask = size - 1;
+        I->slots = CALLOC(size, sizeof(int));
+        I->hashes = CALLOC(columns > 0 ? columns : 1, sizeof(unsigned));
+        for (int i = 1; i <= columns; i++) {
+                const char *name = R->op->getColumnName(R->D, i);
+                if (! name)
+                        continue;
+                unsigned slot = I->hashes[i - 1] = _hash(name);
+                // Columns are inserted in order so a duplicate name finds the first column
+                while (I->slots[slot & I->mask])
+                        slot++;
+                I->slots[slot & I->mask] = i;
+        }
+        return I;
+}
+
+
+static inline int _lookup(T R, ColumnIndex_T I, const char *name) {
+        unsigned h = _hash(name);
+        for (unsigned slot = h; I->slots[slot & I->mask]; slot++) {
+                int i = I->slots[slot & I->mask];
+                if (I->hashes[i - 1] == h && Str_isByteEqual(name, R->op->getColumnName(R->D, i)))
+                        return i;
+        }
+        return 0;
+}
+
+
+/* The column name index is built on first use. An index kept from an earlier
+ execution is trusted as long as names resolve, otherwise it is rebuilt once */
 static inline int _getIndex(T R, const char *name) {
-        int columns = ResultSet_getColumnCount(R);
-        for (int i = 1; i <= columns; i++)
-                if (Str_isByteEqual(name, ResultSet_getColumnName(R, i)))
+        if (name) {
+                ColumnIndex_T *index = R->shared ? R->shared : &R->index;
+                if (*index && ! R->verified && (*index)->columns != R->op->getColumnCount(R->D))
+                        ResultSet_freeIndex(index);
+                if (! *index) {
+                        *index = _buildIndex(R);
+                        R->verified = true;
+                }
+                int i = _lookup(R, *index, name);
+                if (! i && ! R->verified) {
+                        ResultSet_freeIndex(index);
+                        *index = _buildIndex(R);
+                        R->verified = true;
+                        i = _lookup(R, *index, name);
+                }
+                if (i)
                         return i;
+        }
         THROW(SQLException, "Invalid column name '%s'", name ? name : "null");
         return -1;
 }
@@ -83,9 +155,27 @@ T ResultSet_new(ResultSetDelegate_T D, Rop_T op) {
 void ResultSet_free(T *R) {
 	assert(R && *R);
         (*R)->op->free(&(*R)->D);
+        ResultSet_freeIndex(&(*R)->index);
 	FREE(*R);
 }
 
+
+void ResultSet_shareIndex(T R, ColumnIndex_T *index) {
+        assert(R);
+        assert(index);
+        R->shared = index;
+}
+
+
+void ResultSet_freeIndex(ColumnIndex_T *index) {
+        assert(index);
+        if (*index) {
+                FREE((*index)->slots);
+                FREE((*index)->hashes);
+                FREE(*index);
+        }
+}
+
 #ifdef PACKAGE_PROTECTED
 #pragma GCC visibility pop
 #endif
@@ -143,6 +233,8 @@ const char *ResultSet_getStringByName(T R, const char *columnName) {
 
 int ResultSet_getInt(T R, int columnIndex) {
 	assert(R);
+        if (R->op->getInt)
+                return R->op->getInt(R->D, columnIndex);
         const char *s = R->op->getString(R->D, columnIndex);
 	return s ? Str_parseInt(s) : 0;
 }
@@ -156,6 +248,8 @@ int ResultSet_getIntByName(T R, const char *columnName) {
 
 long long ResultSet_getLLong(T R, int columnIndex) {
 	assert(R);
+        if (R->op->getLLong)
+                return R->op->getLLong(R->D, columnIndex);
         const char *s = R->op->getString(R->D, columnIndex);
 	return s ? Str_parseLLong(s) : 0;
 }
@@ -169,6 +263,8 @@ long long ResultSet_getLLongByName(T R, const char *columnName) {
 
 double ResultSet_getDouble(T R, int columnIndex) {
 	assert(R);
+        if (R->op->getDouble)
+                return R->op->getDouble(R->D, columnIndex);
         const char *s = R->op->getString(R->D, columnIndex);
 	return s ? Str_parseDouble(s) : 0.0;
 }
@@ -241,7 +337,8 @@ void ResultSet_setFetchSize(T R, int prefetch_rows)
 {
         assert(R);
         R->fetchSize = prefetch_rows;
-        R->op->setFetchSize(R->D, prefetch_rows);
+        if (R->op->setFetchSize)
+                R->op->setFetchSize(R->D, prefetch_rows);
 }
 
 int ResultSet_getFetchSize(T R)
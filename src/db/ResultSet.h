@@ -28,6 +28,11 @@
 #include <time.h>
 //<< Protected methods
 #include "ResultSetDelegate.h"
+
+/**
+ * Index from column name to column number, used by the ByName methods
+ */
+typedef struct ColumnIndex_S *ColumnIndex_T;
 //>> End Protected methods
 
 
@@ -123,6 +128,24 @@ T ResultSet_new(ResultSetDelegate_T D, Rop_T op);
  */
 void ResultSet_free(T *R);
 
+
+/**
+ * Let the ResultSet build and use its column name index in storage owned 
+ * by the caller. A PreparedStatement uses this to keep the index across 
+ * executions. A kept index is verified on lookup and rebuilt if the 
+ * column list changed.
+ * @param R A ResultSet object
+ * @param index The index storage, must outlive the ResultSet
+ */
+void ResultSet_shareIndex(T R, ColumnIndex_T *index);
+
+
+/**
+ * Destroy a column name index and set it to NULL
+ * @param index A ColumnIndex object reference
+ */
+void ResultSet_freeIndex(ColumnIndex_T *index);
+
 //>> End Protected methods
 
 /** @name Properties */
@@ -202,7 +225,10 @@ int ResultSet_isnull(T R, int columnIndex);
  * is outside the range [1..ResultSet_getColumnCount()] this
  * method throws an SQLException. <i>The returned string may only be 
  * valid until the next call to ResultSet_next() and if you plan to use
- * the returned value longer, you must make a copy.</i>
+ * the returned value longer, you must make a copy.</i> A PostgreSQL
+ * bytea column is returned in its hex text form, <code>\\x...</code>, 
+ * also if the result is in binary format. Use ResultSet_getBlob() to 
+ * get the bytes.
  * @param R A ResultSet object
  * @param columnIndex The first column is 1, the second is 2, ...
  * @return The column value; if the value is SQL NULL, the value
@@ -506,8 +532,26 @@ struct tm ResultSet_getDateTime(T R, int columnIndex);
  */
 struct tm ResultSet_getDateTimeByName(T R, const char *columnName);
 
-//set prefetch size, just like JDBC
+/**
+ * Gives the database a hint on the number of rows to fetch at a time for 
+ * the remaining rows of this ResultSet. Ignored by drivers which cannot
+ * change it once the query has started, such as PostgreSQL and SQLite. 
+ * <i>On Oracle, the array size, the number of rows the ResultSet fetches
+ * per call, is fixed when the query is executed and this method does not
+ * change it.</i> It only changes how many rows OCI prefetches. To change 
+ * the array size, use Connection_setDefaultRowPrefetch() or 
+ * PreparedStatement_setFetchSize() before the query is executed.
+ * @param R A ResultSet object
+ * @param prefetch_rows The number of rows to fetch at a time
+ */
 void ResultSet_setFetchSize(T R, int prefetch_rows);
+
+
+/**
+ * Returns the fetch size set with ResultSet_setFetchSize()
+ * @param R A ResultSet object
+ * @return The number of rows to fetch at a time
+ */
 int ResultSet_getFetchSize(T R);
 
 //@}
@@ -46,9 +46,14 @@ typedef struct Rop_T {
         int (*next)(T R);
         int (*isnull)(T R, int columnIndex);
         const char *(*getString)(T R, int columnIndex);
+        // Optional. If not implemented, the string value is parsed
+        int (*getInt)(T R, int columnIndex);
+        long long (*getLLong)(T R, int columnIndex);
+        double (*getDouble)(T R, int columnIndex);
         const void *(*getBlob)(T R, int columnIndex, int *size);
         time_t (*getTimestamp)(T R, int columnIndex);
         struct tm *(*getDateTime)(T R, int columnIndex, struct tm *tm);
+        // Optional
         void (*setFetchSize)(T R, int prefetch_rows);
 } *Rop_T;
 
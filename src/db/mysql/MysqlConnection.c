@@ -31,6 +31,7 @@
 #include <errmsg.h>
 
 #include "URL.h"
+#include "system/Time.h"
 #include "ResultSet.h"
 #include "StringBuffer.h"
 #include "PreparedStatement.h"
@@ -61,6 +62,7 @@ const struct Cop_T mysqlcops = {
         .setMaxRows 	 	= MysqlConnection_setMaxRows,
         .setDefaultRowPrefetch = MysqlConnection_setDefaultRowPrefetch,
         .ping		 	= MysqlConnection_ping,
+        .getSocket              = MysqlConnection_getSocket,
         .beginTransaction       = MysqlConnection_beginTransaction,
         .commit			= MysqlConnection_commit,
         .rollback		= MysqlConnection_rollback,
@@ -69,7 +71,8 @@ const struct Cop_T mysqlcops = {
         .execute		= MysqlConnection_execute,
         .executeQuery		= MysqlConnection_executeQuery,
         .prepareStatement	= MysqlConnection_prepareStatement,
-        .getLastError		= MysqlConnection_getLastError
+        .getLastError		= MysqlConnection_getLastError,
+        .executeParams          = MysqlConnection_executeParams
 };
 
 #define T ConnectionDelegate_T
@@ -91,6 +94,103 @@ extern const struct Pop_T mysqlpops;
 /* ------------------------------------------------------- Private methods */
 
 
+/* Append a parameter of Connection_executeParams() to C->sb as an escaped SQL literal */
+static int _appendParam(T C, const Param_T *param) {
+        switch (param->type) {
+                case PARAM_NULL:
+                        StringBuffer_append(C->sb, "NULL");
+                        break;
+                case PARAM_STRING:
+                {
+                        unsigned long length = strlen(param->value.data);
+                        char *s = ALLOC(2 * length + 1);
+#if defined(MARIADB_PACKAGE_VERSION) || MYSQL_VERSION_ID < 50706
+                        // Doubles the quote instead of a backslash if the server runs with NO_BACKSLASH_ESCAPES
+                        length = mysql_real_escape_string(C->db, s, param->value.data, length);
+#else
+                        // Unlike mysql_real_escape_string() this also works with NO_BACKSLASH_ESCAPES, the quote is doubled
+                        length = mysql_real_escape_string_quote(C->db, s, param->value.data, length, '\'');
+#endif
+                        if (length == (unsigned long)-1) {
+                                FREE(s);
+                                return false;
+                        }
+                        StringBuffer_append(C->sb, "'%s'", s);
+                        FREE(s);
+                        break;
+                }
+                case PARAM_INT:
+                case PARAM_LLONG:
+                        StringBuffer_append(C->sb, "%lld", param->value.integer);
+                        break;
+                case PARAM_DOUBLE:
+                        StringBuffer_append(C->sb, "%.17g", param->value.real);
+                        break;
+                case PARAM_TIMESTAMP:
+                {
+                        char t[20];
+                        StringBuffer_append(C->sb, "'%s'", Time_toString((time_t)param->value.integer, t));
+                        break;
+                }
+                case PARAM_BLOB:
+                        if (param->size > 0) {
+                                char *s = ALLOC(2 * param->size + 1);
+                                mysql_hex_string(s, param->value.data, param->size);
+                                StringBuffer_append(C->sb, "X'%s'", s);
+                                FREE(s);
+                        } else {
+                                StringBuffer_append(C->sb, "''");
+                        }
+                        break;
+        }
+        return true;
+}
+
+
+/* Copy sql to C->sb with each ? placeholder, outside quotes and comments, 
+ replaced by its parameter. Return false if the parameter count does not match
+ or a string could not be escaped */
+static int _inlineParams(T C, const char *sql, int count, const Param_T *params) {
+        int n = 0;
+        const char *s = sql;
+        StringBuffer_clear(C->sb);
+        for (const char *p = sql; *p; p++) {
+                if (*p == '\'' || *p == '"' || *p == '`') {
+                        char quote = *p;
+                        while (*++p && *p != quote)
+                                if (*p == '\\' && p[1])
+                                        p++;
+                        if (! *p)
+                                break;
+                } else if (*p == '#' || (*p == '-' && p[1] == '-' && (p[2] == ' ' || p[2] == '\t'))) {
+                        while (p[1] && p[1] != '\n')
+                                p++;
+                } else if (*p == '/' && p[1] == '*') {
+                        const char *end = strstr(p + 2, "*/");
+                        if (! end)
+                                break;
+                        p = end + 1;
+                } else if (*p == '?') {
+                        if (n < count) {
+                                StringBuffer_append(C->sb, "%.*s", (int)(p - s), s);
+                                if (! _appendParam(C, &params[n])) {
+                                        StringBuffer_set(C->sb, "Failed to escape string parameter %d", n + 1);
+                                        return false;
+                                }
+                                s = p + 1;
+                        }
+                        n++;
+                }
+        }
+        if (n != count) {
+                StringBuffer_set(C->sb, "The statement has %d parameters but %d were given", n, count);
+                return false;
+        }
+        StringBuffer_append(C->sb, "%s", s);
+        return true;
+}
+
+
 static MYSQL *_doConnect(URL_T url, char **error) {
 #define ERROR(e) do {*error = Str_dup(e); goto error;} while (0)
         int port;
@@ -233,6 +333,12 @@ int MysqlConnection_ping(T C) {
 }
 
 
+int MysqlConnection_getSocket(T C) {
+        assert(C);
+        return (int)C->db->net.fd;
+}
+
+
 int MysqlConnection_beginTransaction(T C) {
 	assert(C);
         C->lastError = mysql_query(C->db, "START TRANSACTION;");
@@ -300,6 +406,17 @@ ResultSet_T MysqlConnection_executeQuery(T C, const char *sql, va_list ap) {
 }
 
 
+int MysqlConnection_executeParams(T C, const char *sql, int count, const Param_T *params) {
+        assert(C);
+        if (! _inlineParams(C, sql, count, params)) {
+                C->lastError = CR_UNKNOWN_ERROR;
+                return false;
+        }
+        C->lastError = mysql_real_query(C->db, StringBuffer_toString(C->sb), StringBuffer_length(C->sb));
+        return (C->lastError == MYSQL_OK);
+}
+
+
 PreparedStatement_T MysqlConnection_prepareStatement(T C, const char *sql, va_list ap) {
         va_list ap_copy;
         MYSQL_STMT *stmt = NULL;
@@ -309,7 +426,7 @@ PreparedStatement_T MysqlConnection_prepareStatement(T C, const char *sql, va_li
         va_end(ap_copy);
         if (_prepare(C, StringBuffer_toString(C->sb), StringBuffer_length(C->sb), &stmt)) {
                 int parameterCount = (int)mysql_stmt_param_count(stmt);
-		return PreparedStatement_new(MysqlPreparedStatement_new(stmt, C->maxRows, parameterCount), (Pop_T)&mysqlpops, parameterCount);
+		return PreparedStatement_new(MysqlPreparedStatement_new(C->db, stmt, StringBuffer_toString(C->sb), C->maxRows, parameterCount), (Pop_T)&mysqlpops, parameterCount);
         }
         return NULL;
 }
@@ -30,6 +30,7 @@ void MysqlConnection_setQueryTimeout(T C, int ms);
 void MysqlConnection_setMaxRows(T C, int max);
 void MysqlConnection_setDefaultRowPrefetch(T C, int prefetch_rows);
 int MysqlConnection_ping(T C);
+int MysqlConnection_getSocket(T C);
 int MysqlConnection_beginTransaction(T C);
 int MysqlConnection_commit(T C);
 int MysqlConnection_rollback(T C);
@@ -37,6 +38,7 @@ long long MysqlConnection_lastRowId(T C);
 long long MysqlConnection_rowsChanged(T C);
 int MysqlConnection_execute(T C, const char *sql, va_list ap);
 ResultSet_T MysqlConnection_executeQuery(T C, const char *sql, va_list ap);
+int MysqlConnection_executeParams(T C, const char *sql, int count, const Param_T *params);
 PreparedStatement_T MysqlConnection_prepareStatement(T C, const char *sql, va_list ap);
 const char *MysqlConnection_getLastError(T C);
 #undef T
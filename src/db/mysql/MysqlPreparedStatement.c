@@ -26,10 +26,14 @@
 #include "Config.h"
 
 #include <stdio.h>
+#include <ctype.h>
 #include <string.h>
+#include <strings.h>
 #include <mysql.h>
 
 #include "ResultSet.h"
+#include "StringBuffer.h"
+#include "PreparedStatement.h"
 #include "MysqlResultSet.h"
 #include "PreparedStatementDelegate.h"
 #include "MysqlPreparedStatement.h"
@@ -37,6 +41,8 @@
 
 /**
  * Implementation of the PreparedStatement/Delegate interface for mysql.
+ * A batch for a plain <code>INSERT .. VALUES (..)</code> statement is sent
+ * as multi-row inserts, other statements are executed one row at a time.
  *
  * @file
  */
@@ -47,6 +53,10 @@
 
 #define MYSQL_OK 0
 
+/* Max rows in a multi-row insert and max placeholders in a statement */
+#define BATCH_ROWS 1000
+#define MAX_PLACEHOLDERS 65535
+
 const struct Pop_T mysqlpops = {
         .name           = "mysql",
         .free           = MysqlPreparedStatement_free,
@@ -59,7 +69,8 @@ const struct Pop_T mysqlpops = {
         .execute        = MysqlPreparedStatement_execute,
         .executeQuery   = MysqlPreparedStatement_executeQuery,
         .rowsChanged    = MysqlPreparedStatement_rowsChanged,
-        .setFetchSize   = MysqlPreparedStatement_setFetchSize
+        .setFetchSize   = MysqlPreparedStatement_setFetchSize,
+        .executeBatch   = MysqlPreparedStatement_executeBatch
 };
 
 typedef struct param_t {
@@ -77,7 +88,9 @@ struct T {
         int maxRows;
         int fetchSize;
         int lastError;
+        char *sql;
         param_t params;
+        MYSQL *db;
         MYSQL_STMT *stmt;
         MYSQL_BIND *bind;
         int parameterCount;
@@ -88,6 +101,116 @@ static my_bool yes = true;
 extern const struct Rop_T mysqlrops;
 
 
+/* ------------------------------------------------------- Private methods */
+
+
+static void _setTime(MYSQL_TIME *t, time_t x) {
+        struct tm ts = {.tm_isdst = -1};
+        gmtime_r(&x, &ts);
+        memset(t, 0, sizeof(MYSQL_TIME));
+        t->year = ts.tm_year + 1900;
+        t->month = ts.tm_mon + 1;
+        t->day = ts.tm_mday;
+        t->hour = ts.tm_hour;
+        t->minute = ts.tm_min;
+        t->second = ts.tm_sec;
+}
+
+
+/* Returns a pointer to the closing quote of the quoted string at s or NULL */
+static inline const char *_skipQuoted(const char *s) {
+        char quote = *s;
+        for (s++; *s && *s != quote; s++)
+                if (*s == '\\' && s[1])
+                        s++;
+        return *s ? s : NULL;
+}
+
+
+static inline int _isComment(const char *s) {
+        return *s == '#' || (*s == '-' && s[1] == '-') || (*s == '/' && s[1] == '*');
+}
+
+
+/* Returns true if sql is a plain INSERT .. VALUES (..) where the values list
+ holds all parameters and ends the statement. The list is stored as the 
+ offsets [start, end) so it can be repeated for many rows */
+static int _findValues(const char *sql, int parameterCount, int *start, int *end) {
+        const char *p = sql;
+        while (isspace(*p))
+                p++;
+        if (strncasecmp(p, "insert", 6) != 0)
+                return false;
+        for (p += 6; *p; p++) {
+                if (*p == '\'' || *p == '"' || *p == '`') {
+                        if (! (p = _skipQuoted(p)))
+                                return false;
+                } else if (*p == '?' || _isComment(p)) {
+                        return false;
+                } else if (strncasecmp(p, "values", 6) == 0 && ! (isalnum(p[-1]) || p[-1] == '_') && ! (isalnum(p[6]) || p[6] == '_')) {
+                        break;
+                }
+        }
+        if (! *p)
+                return false;
+        for (p += 6; isspace(*p); p++) ;
+        if (*p != '(')
+                return false;
+        *start = (int)(p - sql);
+        int depth = 0, placeholders = 0;
+        for (; *p; p++) {
+                if (*p == '\'' || *p == '"' || *p == '`') {
+                        if (! (p = _skipQuoted(p)))
+                                return false;
+                } else if (_isComment(p)) {
+                        return false;
+                } else if (*p == '?') {
+                        placeholders++;
+                } else if (*p == '(') {
+                        depth++;
+                } else if (*p == ')' && --depth == 0) {
+                        break;
+                }
+        }
+        if (! *p)
+                return false;
+        *end = (int)(p - sql) + 1;
+        for (p++; isspace(*p) || *p == ';'; p++) ;
+        return (! *p && placeholders == parameterCount);
+}
+
+
+static void _bind(MYSQL_BIND *bind, const Param_T *p, unsigned long *length, MYSQL_TIME *t) {
+        memset(bind, 0, sizeof(MYSQL_BIND));
+        switch (p->type) {
+                case PARAM_NULL:
+                        bind->buffer_type = MYSQL_TYPE_NULL;
+                        break;
+                case PARAM_STRING:
+                case PARAM_BLOB:
+                        bind->buffer_type = (p->type == PARAM_STRING) ? MYSQL_TYPE_STRING : MYSQL_TYPE_BLOB;
+                        bind->buffer = (void *)p->value.data;
+                        *length = p->size;
+                        bind->length = length;
+                        break;
+                case PARAM_INT:
+                case PARAM_LLONG:
+                        bind->buffer_type = MYSQL_TYPE_LONGLONG;
+                        bind->buffer = (void *)&p->value.integer;
+                        break;
+                case PARAM_DOUBLE:
+                        bind->buffer_type = MYSQL_TYPE_DOUBLE;
+                        bind->buffer = (void *)&p->value.real;
+                        break;
+                case PARAM_TIMESTAMP:
+                        _setTime(t, (time_t)p->value.integer);
+                        bind->buffer_type = MYSQL_TYPE_TIMESTAMP;
+                        bind->buffer = t;
+                        break;
+        }
+}
+
+
 /* ----------------------------------------------------- Protected methods */
 
 
@@ -95,11 +218,15 @@ extern const struct Rop_T mysqlrops;
 #pragma GCC visibility push(hidden)
 #endif
 
-T MysqlPreparedStatement_new(void *stmt, int maxRows, int parameterCount) {
+T MysqlPreparedStatement_new(void *db, void *stmt, const char *sql, int maxRows, int parameterCount) {
         T P;
+        assert(db);
         assert(stmt);
+        assert(sql);
         NEW(P);
+        P->db = db;
         P->stmt = stmt;
+        P->sql = Str_dup(sql);
         P->maxRows = maxRows;
         P->parameterCount = parameterCount;
         if (P->parameterCount > 0) {
@@ -122,6 +249,7 @@ void MysqlPreparedStatement_free(T *P) {
 #endif
         mysql_stmt_close((*P)->stmt);
         FREE((*P)->params);
+        FREE((*P)->sql);
 	FREE(*P);
 }
 
@@ -175,14 +303,7 @@ void MysqlPreparedStatement_setDouble(T P, int parameterIndex, double x) {
 void MysqlPreparedStatement_setTimestamp(T P, int parameterIndex, time_t x) {
         assert(P);
         int i = checkAndSetParameterIndex(parameterIndex, P->parameterCount);
-        struct tm ts = {.tm_isdst = -1};
-        gmtime_r(&x, &ts);
-        P->params[i].type.timestamp.year = ts.tm_year + 1900;
-        P->params[i].type.timestamp.month = ts.tm_mon + 1;
-        P->params[i].type.timestamp.day = ts.tm_mday;
-        P->params[i].type.timestamp.hour = ts.tm_hour;
-        P->params[i].type.timestamp.minute = ts.tm_min;
-        P->params[i].type.timestamp.second = ts.tm_sec;
+        _setTime(&P->params[i].type.timestamp, x);
         P->bind[i].buffer_type = MYSQL_TYPE_TIMESTAMP;
         P->bind[i].buffer = &P->params[i].type.timestamp;
         P->bind[i].is_null = 0;
@@ -246,6 +367,66 @@ long long MysqlPreparedStatement_rowsChanged(T P) {
         return (long long)mysql_stmt_affected_rows(P->stmt);
 }
 
+int MysqlPreparedStatement_executeBatch(T P, const Param_T *rows, int count, long long *counts) {
+        assert(P);
+        int start, end;
+        if (P->parameterCount <= 0 || ! _findValues(P->sql, P->parameterCount, &start, &end))
+                return false;
+        char error[STRLEN] = {};
+        int chunk = MAX_PLACEHOLDERS / P->parameterCount;
+        if (chunk > BATCH_ROWS)
+                chunk = BATCH_ROWS;
+        if (chunk > count)
+                chunk = count;
+        int prepared = 0;
+        MYSQL_STMT *stmt = NULL;
+        MYSQL_BIND *bind = CALLOC(chunk * P->parameterCount, sizeof(MYSQL_BIND));
+        unsigned long *lengths = CALLOC(chunk * P->parameterCount, sizeof(unsigned long));
+        MYSQL_TIME *times = CALLOC(chunk * P->parameterCount, sizeof(MYSQL_TIME));
+        StringBuffer_T sb = StringBuffer_create(end + chunk * (end - start + 1));
+        for (int r = 0; r < count; r += chunk) {
+                int n = (count - r) < chunk ? (count - r) : chunk;
+                /* Prepare INSERT .. VALUES (..),(..),.. with n rows, the last chunk may be shorter */
+                if (n != prepared) {
+                        if (stmt)
+                                mysql_stmt_close(stmt);
+                        StringBuffer_set(sb, "%.*s", end, P->sql);
+                        for (int k = 1; k < n; k++)
+                                StringBuffer_append(sb, ",%.*s", end - start, P->sql + start);
+                        if (! (stmt = mysql_stmt_init(P->db))) {
+                                snprintf(error, STRLEN, "mysql_stmt_init -- Out of memory");
+                                break;
+                        }
+                        if ((P->lastError = mysql_stmt_prepare(stmt, StringBuffer_toString(sb), StringBuffer_length(sb)))) {
+                                snprintf(error, STRLEN, "%s", mysql_stmt_error(stmt));
+                                break;
+                        }
+                        prepared = n;
+                }
+                const Param_T *row = rows + (r * P->parameterCount);
+                for (int i = 0; i < n * P->parameterCount; i++)
+                        _bind(&bind[i], &row[i], &lengths[i], &times[i]);
+                if ((P->lastError = mysql_stmt_bind_param(stmt, bind)) || (P->lastError = mysql_stmt_execute(stmt))) {
+                        snprintf(error, STRLEN, "%s", mysql_stmt_error(stmt));
+                        break;
+                }
+                /* The server only reports the rows changed by the whole insert */
+                long long changed = (long long)mysql_stmt_affected_rows(stmt);
+                for (int k = 0; k < n; k++)
+                        counts[r + k] = (changed == n) ? 1 : BATCH_SUCCESS_NO_INFO;
+        }
+        if (stmt)
+                mysql_stmt_close(stmt);
+        StringBuffer_free(&sb);
+        FREE(bind);
+        FREE(lengths);
+        FREE(times);
+        if (*error)
+                THROW(SQLException, "%s", error);
+        return true;
+}
+
+
 void MysqlPreparedStatement_setFetchSize(T P, int prefetch_rows) {
         assert(P);
         P->fetchSize = prefetch_rows;
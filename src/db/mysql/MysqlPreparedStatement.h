@@ -24,7 +24,7 @@
 #ifndef MYSQLPREPAREDSTATEMENT_INCLUDED
 #define MYSQLPREPAREDSTATEMENT_INCLUDED
 #define T PreparedStatementDelegate_T
-T MysqlPreparedStatement_new(void *stmt, int maxRows, int parameterCount);
+T MysqlPreparedStatement_new(void *db, void *stmt, const char *sql, int maxRows, int parameterCount);
 void MysqlPreparedStatement_free(T *P);
 void MysqlPreparedStatement_setString(T P, int parameterIndex, const char *x);
 void MysqlPreparedStatement_setInt(T P, int parameterIndex, int x);
@@ -36,5 +36,6 @@ void MysqlPreparedStatement_execute(T P);
 ResultSet_T MysqlPreparedStatement_executeQuery(T P);
 long long MysqlPreparedStatement_rowsChanged(T P);
 void MysqlPreparedStatement_setFetchSize(T P, int prefetch_rows);
+int MysqlPreparedStatement_executeBatch(T P, const Param_T *rows, int count, long long *counts);
 #undef T
 #endif
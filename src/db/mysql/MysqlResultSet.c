@@ -27,9 +27,13 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <time.h>
 #include <mysql.h>
 #include <errmsg.h>
 
+#include "system/Time.h"
 #include "ResultSetDelegate.h"
 #include "MysqlResultSet.h"
 
@@ -38,6 +42,11 @@
  * Implementation of the ResultSet/Delegate interface for mysql. 
  * Accessing columns with index outside range throws SQLException
  *
+ * Integer, floating point and temporal columns are bound with their
+ * native buffer types and only formatted as text if the column is 
+ * read with getString. Other columns, including DECIMAL, are bound 
+ * as strings.
+ *
  * @file
  */
 
@@ -56,15 +65,35 @@ const struct Rop_T mysqlrops = {
         .next           = MysqlResultSet_next,
         .isnull         = MysqlResultSet_isnull,
         .getString      = MysqlResultSet_getString,
+        .getInt         = MysqlResultSet_getInt,
+        .getLLong       = MysqlResultSet_getLLong,
+        .getDouble      = MysqlResultSet_getDouble,
         .getBlob        = MysqlResultSet_getBlob,
+        .getTimestamp   = MysqlResultSet_getTimestamp,
+        .getDateTime    = MysqlResultSet_getDateTime,
         .setFetchSize   = MysqlResultSet_setFetchSize
-        // getTimestamp and getDateTime is handled in ResultSet
 };
 
+/* How a column is bound */
+#define COLUMN_STRING   0
+#define COLUMN_INTEGER  1
+#define COLUMN_REAL     2
+#define COLUMN_TIME     3
+
+/* Size of the text buffer of a native column */
+#define NATIVE_LENGTH   64
+
 typedef struct column_t {
         my_bool is_null;
+        int kind;
+        int formatted; // Row the buffer was formatted for, native columns only
         MYSQL_FIELD *field;
         unsigned long real_length;
+        union {
+                long long integer;
+                double real;
+                MYSQL_TIME time;
+        } value;
         char *buffer;
 } *column_t;
 
@@ -75,6 +104,7 @@ struct T {
         int maxRows;
         int lastError;
         int needRebind;
+        int row;
 	int currentRow;
 	int columnCount;
         MYSQL_RES *meta;
@@ -100,6 +130,99 @@ static inline void _ensureCapacity(T R, int i) {
 }
 
 
+/* Bind column i with a native buffer type if it has one, otherwise as a string */
+static void _bindColumn(T R, int i) {
+        column_t c = &R->columns[i];
+        MYSQL_BIND *b = &R->bind[i];
+        switch (c->field->type) {
+                case MYSQL_TYPE_TINY:
+                case MYSQL_TYPE_SHORT:
+                case MYSQL_TYPE_INT24:
+                case MYSQL_TYPE_LONG:
+                case MYSQL_TYPE_LONGLONG:
+                case MYSQL_TYPE_YEAR:
+                        c->kind = COLUMN_INTEGER;
+                        b->buffer_type = MYSQL_TYPE_LONGLONG;
+                        b->buffer = &c->value.integer;
+                        b->is_unsigned = (c->field->flags & UNSIGNED_FLAG) ? true : false;
+                        break;
+                case MYSQL_TYPE_FLOAT:
+                case MYSQL_TYPE_DOUBLE:
+                        c->kind = COLUMN_REAL;
+                        b->buffer_type = MYSQL_TYPE_DOUBLE;
+                        b->buffer = &c->value.real;
+                        break;
+                case MYSQL_TYPE_DATE:
+                case MYSQL_TYPE_TIME:
+                case MYSQL_TYPE_DATETIME:
+                case MYSQL_TYPE_TIMESTAMP:
+                        c->kind = COLUMN_TIME;
+                        b->buffer_type = c->field->type;
+                        b->buffer = &c->value.time;
+                        break;
+                default:
+                        c->kind = COLUMN_STRING;
+                        break;
+        }
+        if (c->kind == COLUMN_STRING) {
+                c->buffer = ALLOC(STRLEN + 1);
+                b->buffer_type = MYSQL_TYPE_STRING;
+                b->buffer = c->buffer;
+                b->buffer_length = STRLEN;
+        } else {
+                c->buffer = ALLOC(NATIVE_LENGTH);
+        }
+        b->is_null = &c->is_null;
+        b->length = &c->real_length;
+}
+
+
+/* Shortest text that reads back as the same value, as the server would send it */
+static void _formatReal(char *s, double d, int isFloat) {
+        for (int precision = isFloat ? 6 : 15; precision <= 17; precision++) {
+                snprintf(s, NATIVE_LENGTH, "%.*g", precision, d);
+                double r = strtod(s, NULL);
+                if (isFloat ? ((float)r == (float)d) : (r == d))
+                        break;
+        }
+}
+
+
+/* Format the native value of column i as text in its buffer, once per row */
+static const char *_format(T R, int i) {
+        column_t c = &R->columns[i];
+        if (c->formatted == R->row)
+                return c->buffer;
+        switch (c->kind) {
+                case COLUMN_INTEGER:
+                        if (R->bind[i].is_unsigned)
+                                snprintf(c->buffer, NATIVE_LENGTH, "%llu", (unsigned long long)c->value.integer);
+                        else
+                                snprintf(c->buffer, NATIVE_LENGTH, "%lld", c->value.integer);
+                        break;
+                case COLUMN_REAL:
+                        _formatReal(c->buffer, c->value.real, c->field->type == MYSQL_TYPE_FLOAT);
+                        break;
+                case COLUMN_TIME:
+                {
+                        MYSQL_TIME *t = &c->value.time;
+                        int n = 0;
+                        if (c->field->type == MYSQL_TYPE_TIME)
+                                n = snprintf(c->buffer, NATIVE_LENGTH, "%s%02u:%02u:%02u", t->neg ? "-" : "", t->hour, t->minute, t->second);
+                        else if (c->field->type == MYSQL_TYPE_DATE)
+                                n = snprintf(c->buffer, NATIVE_LENGTH, "%04u-%02u-%02u", t->year, t->month, t->day);
+                        else
+                                n = snprintf(c->buffer, NATIVE_LENGTH, "%04u-%02u-%02u %02u:%02u:%02u", t->year, t->month, t->day, t->hour, t->minute, t->second);
+                        if (t->second_part && c->field->type != MYSQL_TYPE_DATE)
+                                snprintf(c->buffer + n, NATIVE_LENGTH - n, ".%06lu", (unsigned long)t->second_part);
+                        break;
+                }
+        }
+        c->formatted = R->row;
+        return c->buffer;
+}
+
+
 /* ----------------------------------------------------- Protected methods */
 
 
@@ -122,13 +245,8 @@ T MysqlResultSet_new(void *stmt, int maxRows, int keep, int fetchSize) {
                 R->bind = CALLOC(R->columnCount, sizeof (MYSQL_BIND));
                 R->columns = CALLOC(R->columnCount, sizeof (struct column_t));
                 for (int i = 0; i < R->columnCount; i++) {
-                        R->columns[i].buffer = ALLOC(STRLEN + 1);
-                        R->bind[i].buffer_type = MYSQL_TYPE_STRING;
-                        R->bind[i].buffer = R->columns[i].buffer;
-                        R->bind[i].buffer_length = STRLEN;
-                        R->bind[i].is_null = &R->columns[i].is_null;
-                        R->bind[i].length = &R->columns[i].real_length;
                         R->columns[i].field = mysql_fetch_field_direct(R->meta, i);
+                        _bindColumn(R, i);
                 }
                 if ((R->lastError = mysql_stmt_bind_result(R->stmt, R->bind))) {
                         DEBUG("Error: bind - %s\n", mysql_stmt_error(stmt));
@@ -177,6 +295,8 @@ long MysqlResultSet_getColumnSize(T R, int columnIndex) {
         int i = checkAndSetColumnIndex(columnIndex, R->columnCount);
         if (R->columns[i].is_null)
                 return 0;
+        if (R->columns[i].kind != COLUMN_STRING)
+                return strlen(_format(R, i));
         return R->columns[i].real_length;
 }
 
@@ -203,6 +323,7 @@ int MysqlResultSet_next(T R) {
         R->lastError = mysql_stmt_fetch(R->stmt);
         if (R->lastError == 1)
                 THROW(SQLException, "mysql_stmt_fetch -- %s", mysql_stmt_error(R->stmt));
+        R->row++;
         return ((R->lastError == MYSQL_OK) || (R->lastError == MYSQL_DATA_TRUNCATED));
 }
 
@@ -219,17 +340,110 @@ const char *MysqlResultSet_getString(T R, int columnIndex) {
         int i = checkAndSetColumnIndex(columnIndex, R->columnCount);
         if (R->columns[i].is_null)
                 return NULL;
+        if (R->columns[i].kind != COLUMN_STRING)
+                return _format(R, i);
         _ensureCapacity(R, i);
         R->columns[i].buffer[R->columns[i].real_length] = 0;
         return R->columns[i].buffer;
 }
 
 
+int MysqlResultSet_getInt(T R, int columnIndex) {
+        assert(R);
+        int i = checkAndSetColumnIndex(columnIndex, R->columnCount);
+        if (R->columns[i].kind == COLUMN_INTEGER) {
+                long long n = MysqlResultSet_getLLong(R, columnIndex);
+                if (n < INT_MIN || n > INT_MAX)
+                        THROW(SQLException, "NumberFormatException: Value %lld is out of range for int", n);
+                return (int)n;
+        }
+        const char *s = MysqlResultSet_getString(R, columnIndex);
+        return s ? Str_parseInt(s) : 0;
+}
+
+
+long long MysqlResultSet_getLLong(T R, int columnIndex) {
+        assert(R);
+        int i = checkAndSetColumnIndex(columnIndex, R->columnCount);
+        if (R->columns[i].is_null)
+                return 0;
+        if (R->columns[i].kind == COLUMN_INTEGER) {
+                if (R->bind[i].is_unsigned && R->columns[i].value.integer < 0)
+                        THROW(SQLException, "NumberFormatException: Value %llu is out of range for long long", (unsigned long long)R->columns[i].value.integer);
+                return R->columns[i].value.integer;
+        }
+        return Str_parseLLong(MysqlResultSet_getString(R, columnIndex));
+}
+
+
+double MysqlResultSet_getDouble(T R, int columnIndex) {
+        assert(R);
+        int i = checkAndSetColumnIndex(columnIndex, R->columnCount);
+        if (R->columns[i].is_null)
+                return 0.0;
+        if (R->columns[i].kind == COLUMN_REAL)
+                return R->columns[i].value.real;
+        if (R->columns[i].kind == COLUMN_INTEGER)
+                return R->bind[i].is_unsigned ? (double)(unsigned long long)R->columns[i].value.integer : (double)R->columns[i].value.integer;
+        return Str_parseDouble(MysqlResultSet_getString(R, columnIndex));
+}
+
+
+time_t MysqlResultSet_getTimestamp(T R, int columnIndex) {
+        assert(R);
+        int i = checkAndSetColumnIndex(columnIndex, R->columnCount);
+        if (R->columns[i].is_null)
+                return 0;
+        if (R->columns[i].kind == COLUMN_TIME && R->columns[i].field->type != MYSQL_TYPE_TIME) {
+                MYSQL_TIME *t = &R->columns[i].value.time;
+                if (t->year == 0 && t->month == 0 && t->day == 0)
+                        return 0; // Zero date
+                struct tm tm = {
+                        .tm_year = t->year - 1900, .tm_mon = t->month - 1, .tm_mday = t->day, 
+                        .tm_hour = t->hour, .tm_min = t->minute, .tm_sec = t->second
+                };
+                return timegm(&tm);
+        }
+        const char *s = MysqlResultSet_getString(R, columnIndex);
+        return STR_DEF(s) ? Time_toTimestamp(s) : 0;
+}
+
+
+struct tm *MysqlResultSet_getDateTime(T R, int columnIndex, struct tm *tm) {
+        assert(R);
+        int i = checkAndSetColumnIndex(columnIndex, R->columnCount);
+        if (R->columns[i].is_null)
+                return tm;
+        if (R->columns[i].kind == COLUMN_TIME) {
+                MYSQL_TIME *t = &R->columns[i].value.time;
+                *tm = (struct tm){.tm_isdst = -1};
+                if (R->columns[i].field->type != MYSQL_TYPE_TIME) {
+                        tm->tm_year = t->year; // The year literal, see ResultSet_getDateTime()
+                        tm->tm_mon = t->month - 1;
+                        tm->tm_mday = t->day;
+                }
+                tm->tm_hour = t->hour;
+                tm->tm_min = t->minute;
+                tm->tm_sec = t->second;
+                return tm;
+        }
+        const char *s = MysqlResultSet_getString(R, columnIndex);
+        if (STR_DEF(s))
+                Time_toDateTime(s, tm);
+        return tm;
+}
+
+
 const void *MysqlResultSet_getBlob(T R, int columnIndex, int *size) {
         assert(R);
         int i = checkAndSetColumnIndex(columnIndex, R->columnCount);
         if (R->columns[i].is_null)
                 return NULL;
+        if (R->columns[i].kind != COLUMN_STRING) {
+                const char *s = _format(R, i);
+                *size = (int)strlen(s);
+                return s;
+        }
         _ensureCapacity(R, i);
         *size = (int)R->columns[i].real_length;
         return R->columns[i].buffer;
@@ -32,6 +32,11 @@ long MysqlResultSet_getColumnSize(T R, int columnIndex);
 int MysqlResultSet_next(T R);
 int MysqlResultSet_isnull(T R, int columnIndex);
 const char *MysqlResultSet_getString(T R, int columnIndex);
+int MysqlResultSet_getInt(T R, int columnIndex);
+long long MysqlResultSet_getLLong(T R, int columnIndex);
+double MysqlResultSet_getDouble(T R, int columnIndex);
+time_t MysqlResultSet_getTimestamp(T R, int columnIndex);
+struct tm *MysqlResultSet_getDateTime(T R, int columnIndex, struct tm *tm);
 const void *MysqlResultSet_getBlob(T R, int columnIndex, int *size);
 void MysqlResultSet_setFetchSize(T R, int prefetch_rows);
 #undef T
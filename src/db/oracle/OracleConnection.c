@@ -74,10 +74,27 @@ const struct Cop_T oraclesqlcops = {
 
 #define ERB_SIZE 152
 #define ORACLE_TRANSACTION_PERIOD 10
+#define ORACLE_SESSION_POOL_MAX 1024
+#define ORACLE_SESSION_POOL_TIMEOUT 60
+
+/* An OCI environment, and optionally an OCI session pool, shared by all
+ Connections with the same URL, which are those of a ConnectionPool */
+typedef struct environment_t {
+        char *url;
+        int connections;
+        OCIEnv *env;
+        OCIError *err;
+        OCISPool *spool;
+        int spoolCreated;
+        OraText *spoolName;
+        ub4 spoolNameLength;
+        struct environment_t *next;
+} *environment_t;
 
 #define T ConnectionDelegate_T
 struct T {
         URL_T          url;
+        environment_t  environment;
         OCIEnv*        env;
         OCIError*      err;
         OCISvcCtx*     svc;
@@ -99,13 +116,103 @@ struct T {
 extern const struct Rop_T oraclerops;
 extern const struct Pop_T oraclepops;
 
+static environment_t environments = NULL;
+static Mutex_T environmentMutex = PTHREAD_MUTEX_INITIALIZER;
+
 
 /* ------------------------------------------------------- Private methods */
 
 
-static int _doConnect(T C, URL_T url, char**  error) {
 #define ERROR(e) do {*error = Str_dup(e); return false;} while (0)
 #define ORAERROR(e) do{ *error = Str_dup(OracleConnection_getLastError(e)); return false;} while(0)
+
+
+static void _freeEnvironment(environment_t e) {
+        if (e->spoolCreated)
+                OCISessionPoolDestroy(e->spool, e->err, OCI_SPD_FORCE);
+        if (e->spool)
+                OCIHandleFree(e->spool, OCI_HTYPE_SPOOL);
+        if (e->err)
+                OCIHandleFree(e->err, OCI_HTYPE_ERROR);
+        if (e->env)
+                OCIHandleFree(e->env, OCI_HTYPE_ENV);
+        FREE(e->url);
+        FREE(e);
+}
+
+
+static int _createEnvironment(environment_t e, const char *database, const char *username, const char *password, int sessionPool, char **error) {
+        /* Create a thread-safe OCI environment with N' substitution turned on. */
+        if (OCIEnvCreate(&e->env, OCI_THREADED | OCI_OBJECT | OCI_NCHAR_LITERAL_REPLACE_ON, 0, 0, 0, 0, 0, 0))
+                ERROR("Create a OCI environment failed");
+        if (! sessionPool)
+                return true;
+        if (OCI_SUCCESS != OCIHandleAlloc(e->env, (dvoid**)&e->err, OCI_HTYPE_ERROR, 0, 0))
+                ERROR("Allocating error handler failed");
+        if (OCI_SUCCESS != OCIHandleAlloc(e->env, (dvoid**)&e->spool, OCI_HTYPE_SPOOL, 0, 0))
+                ERROR("Allocating session pool handle failed");
+        /* The ConnectionPool bounds the number of sessions in use, the OCI maximum is only a safeguard */
+        sword status = OCISessionPoolCreate(e->env, e->err, e->spool, &e->spoolName, &e->spoolNameLength,
+                                            (OraText *)database, (ub4)strlen(database), 0, ORACLE_SESSION_POOL_MAX, 1,
+                                            (OraText *)username, (ub4)strlen(username), (OraText *)password, (ub4)strlen(password),
+                                            OCI_SPC_HOMOGENEOUS | OCI_SPC_STMTCACHE);
+        if (status != OCI_SUCCESS && status != OCI_SUCCESS_WITH_INFO) {
+                sb4 errcode;
+                char erb[ERB_SIZE] = {0};
+                OCIErrorGet(e->err, 1, NULL, &errcode, (OraText *)erb, (ub4)ERB_SIZE, OCI_HTYPE_ERROR);
+                ERROR(erb);
+        }
+        e->spoolCreated = true;
+        /* Close sessions left idle in the OCI pool after the ConnectionPool reaped their Connection */
+        ub4 timeout = ORACLE_SESSION_POOL_TIMEOUT;
+        OCIAttrSet(e->spool, OCI_HTYPE_SPOOL, &timeout, sizeof(timeout), OCI_ATTR_SPOOL_TIMEOUT, e->err);
+        return true;
+}
+
+
+static environment_t _getEnvironment(URL_T url, const char *database, const char *username, const char *password, char **error) {
+        environment_t e = NULL;
+        LOCK(environmentMutex)
+        {
+                const char *key = URL_toString(url);
+                for (e = environments; e; e = e->next)
+                        if (Str_isEqual(e->url, key))
+                                break;
+                if (! e) {
+                        NEW(e);
+                        e->url = Str_dup(key);
+                        if (_createEnvironment(e, database, username, password, IS(URL_getParameter(url, "session-pool"), "true"), error)) {
+                                e->next = environments;
+                                environments = e;
+                        } else {
+                                _freeEnvironment(e);
+                                e = NULL;
+                        }
+                }
+                if (e)
+                        e->connections++;
+        }
+        END_LOCK;
+        return e;
+}
+
+
+static void _releaseEnvironment(environment_t e) {
+        LOCK(environmentMutex)
+        {
+                if (--e->connections == 0) {
+                        environment_t *p = &environments;
+                        while (*p != e)
+                                p = &(*p)->next;
+                        *p = e->next;
+                        _freeEnvironment(e);
+                }
+        }
+        END_LOCK;
+}
+
+
+static int _doConnect(T C, URL_T url, char**  error) {
         const char *database, *username, *password;
         const char *host = URL_getHost(url);
         int port = URL_getPort(url);
@@ -118,18 +225,6 @@ static int _doConnect(T C, URL_T url, char**  error) {
         if (! (database = URL_getPath(url)))
                 ERROR("no database specified in URL");
         ++database;
-        /* Create a thread-safe OCI environment with N' substitution turned on. */
-        if (OCIEnvCreate(&C->env, OCI_THREADED | OCI_OBJECT | OCI_NCHAR_LITERAL_REPLACE_ON, 0, 0, 0, 0, 0, 0))
-                ERROR("Create a OCI environment failed");
-        /* allocate an error handle */
-        if (OCI_SUCCESS != OCIHandleAlloc(C->env, (dvoid**)&C->err, OCI_HTYPE_ERROR, 0, 0))
-                ERROR("Allocating error handler failed");
-        /* server contexts */
-        if (OCI_SUCCESS != OCIHandleAlloc(C->env, (dvoid**)&C->srv, OCI_HTYPE_SERVER, 0, 0))
-                ERROR("Allocating server context failed");
-        /* allocate a service handle */
-        if (OCI_SUCCESS != OCIHandleAlloc(C->env, (dvoid**)&C->svc, OCI_HTYPE_SVCCTX, 0, 0))
-                ERROR("Allocating service handle failed");
         StringBuffer_clear(C->sb);
         /* Oracle connect string is on the form: //host[:port]/service name */
         if (host) {
@@ -139,6 +234,29 @@ static int _doConnect(T C, URL_T url, char**  error) {
                 StringBuffer_append(C->sb, "/%s", database);
         } else /* Or just service name */
                 StringBuffer_append(C->sb, "%s", database);
+        if (! (C->environment = _getEnvironment(url, StringBuffer_toString(C->sb), username, password, error)))
+                return false;
+        C->env = C->environment->env;
+        /* allocate an error handle */
+        if (OCI_SUCCESS != OCIHandleAlloc(C->env, (dvoid**)&C->err, OCI_HTYPE_ERROR, 0, 0))
+                ERROR("Allocating error handler failed");
+        if (C->environment->spool) {
+                /* Take a session, with its own statement cache, from the OCI session pool */
+                C->lastError = OCISessionGet(C->env, C->err, &C->svc, NULL, C->environment->spoolName, C->environment->spoolNameLength,
+                                             NULL, 0, NULL, NULL, NULL, OCI_SESSGET_SPOOL);
+                if (C->lastError != OCI_SUCCESS && C->lastError != OCI_SUCCESS_WITH_INFO) {
+                        C->svc = NULL;
+                        ORAERROR(C);
+                }
+                OCIAttrGet(C->svc, OCI_HTYPE_SVCCTX, &C->usr, NULL, OCI_ATTR_SESSION, C->err);
+                return true;
+        }
+        /* server contexts */
+        if (OCI_SUCCESS != OCIHandleAlloc(C->env, (dvoid**)&C->srv, OCI_HTYPE_SERVER, 0, 0))
+                ERROR("Allocating server context failed");
+        /* allocate a service handle */
+        if (OCI_SUCCESS != OCIHandleAlloc(C->env, (dvoid**)&C->svc, OCI_HTYPE_SVCCTX, 0, 0))
+                ERROR("Allocating service handle failed");
         /* Create a server context */
         C->lastError = OCIServerAttach(C->srv, C->err, StringBuffer_toString(C->sb), StringBuffer_length(C->sb), 0);
         if (C->lastError != OCI_SUCCESS && C->lastError != OCI_SUCCESS_WITH_INFO)
@@ -156,7 +274,8 @@ static int _doConnect(T C, URL_T url, char**  error) {
         C->lastError = OCIAttrSet(C->usr, OCI_HTYPE_SESSION, (dvoid *)password, (int)strlen(password), OCI_ATTR_PASSWORD, C->err);
         if (C->lastError != OCI_SUCCESS && C->lastError != OCI_SUCCESS_WITH_INFO)
                 ORAERROR(C);
-        C->lastError = OCISessionBegin(C->svc, C->err, C->usr, OCI_CRED_RDBMS, OCI_DEFAULT);
+        /* Begin the session with a statement cache used by OCIStmtPrepare2 */
+        C->lastError = OCISessionBegin(C->svc, C->err, C->usr, OCI_CRED_RDBMS, OCI_STMT_CACHE);
         if (C->lastError != OCI_SUCCESS && C->lastError != OCI_SUCCESS_WITH_INFO)
                 ORAERROR(C);
         OCIAttrSet(C->svc, OCI_HTYPE_SVCCTX, C->usr, 0, OCI_ATTR_SESSION, C->err);
@@ -195,17 +314,37 @@ T OracleConnection_new(URL_T url, char **error) {
 
 void OracleConnection_free(T* C) {
         assert(C && *C);
-        if ((*C)->svc) {
-                OCISessionEnd((*C)->svc, (*C)->err, (*C)->usr, OCI_DEFAULT);
-                (*C)->svc = NULL;
-        }
-        if ((*C)->srv)
-                OCIServerDetach((*C)->srv, (*C)->err, OCI_DEFAULT);
-        if ((*C)->env)
-                OCIHandleFree((*C)->env, OCI_HTYPE_ENV);
-        StringBuffer_free(&(*C)->sb);
+        OCISvcCtx *svc = (*C)->svc;
+        /* Stop the watchdog before the service context goes away */
+        (*C)->svc = NULL;
         if ((*C)->watchdog)
             Thread_join((*C)->watchdog);
+        if ((*C)->environment) {
+                if ((*C)->environment->spool) {
+                        if (svc) {
+                                if ((*C)->txnhp)
+                                        OCIAttrSet(svc, OCI_HTYPE_SVCCTX, NULL, 0, OCI_ATTR_TRANS, (*C)->err);
+                                OCISessionRelease(svc, (*C)->err, NULL, 0, OCI_DEFAULT);
+                        }
+                } else {
+                        if (svc && (*C)->usr)
+                                OCISessionEnd(svc, (*C)->err, (*C)->usr, OCI_DEFAULT);
+                        if ((*C)->srv)
+                                OCIServerDetach((*C)->srv, (*C)->err, OCI_DEFAULT);
+                        if ((*C)->usr)
+                                OCIHandleFree((*C)->usr, OCI_HTYPE_SESSION);
+                        if (svc)
+                                OCIHandleFree(svc, OCI_HTYPE_SVCCTX);
+                        if ((*C)->srv)
+                                OCIHandleFree((*C)->srv, OCI_HTYPE_SERVER);
+                }
+                if ((*C)->txnhp)
+                        OCIHandleFree((*C)->txnhp, OCI_HTYPE_TRANS);
+                if ((*C)->err)
+                        OCIHandleFree((*C)->err, OCI_HTYPE_ERROR);
+                _releaseEnvironment((*C)->environment);
+        }
+        StringBuffer_free(&(*C)->sb);
         FREE(*C);
 }
 
@@ -302,7 +441,7 @@ long long OracleConnection_rowsChanged(T C) {
 
 
 int  OracleConnection_execute(T C, const char *sql, va_list ap) {
-        OCIStmt* stmtp;
+        OCIStmt* stmtp = NULL;
         va_list ap_copy;
         assert(C);
         C->rowsChanged = 0;
@@ -311,12 +450,10 @@ int  OracleConnection_execute(T C, const char *sql, va_list ap) {
         va_end(ap_copy);
         StringBuffer_trim(C->sb);
         /* Build statement */
-        C->lastError = OCIHandleAlloc(C->env, (void **)&stmtp, OCI_HTYPE_STMT, 0, NULL);
-        if (C->lastError != OCI_SUCCESS && C->lastError != OCI_SUCCESS_WITH_INFO)
-                return false;
-        C->lastError = OCIStmtPrepare(stmtp, C->err, StringBuffer_toString(C->sb), StringBuffer_length(C->sb), OCI_NTV_SYNTAX, OCI_DEFAULT);
+        C->lastError = OCIStmtPrepare2(C->svc, &stmtp, C->err, StringBuffer_toString(C->sb), StringBuffer_length(C->sb), NULL, 0, OCI_NTV_SYNTAX, OCI_DEFAULT);
         if (C->lastError != OCI_SUCCESS && C->lastError != OCI_SUCCESS_WITH_INFO) {
-                OCIHandleFree(stmtp, OCI_HTYPE_STMT);
+                if (stmtp)
+                        OCIStmtRelease(stmtp, C->err, NULL, 0, OCI_STRLS_CACHE_DELETE);
                 return false;
         }
         /* Execute */
@@ -328,19 +465,19 @@ int  OracleConnection_execute(T C, const char *sql, va_list ap) {
                 ub4 parmcnt = 0;
                 OCIAttrGet(stmtp, OCI_HTYPE_STMT, &parmcnt, NULL, OCI_ATTR_PARSE_ERROR_OFFSET, C->err);
                 DEBUG("Error occured in StmtExecute %d (%s), offset is %d\n", C->lastError, OracleConnection_getLastError(C), parmcnt);
-                OCIHandleFree(stmtp, OCI_HTYPE_STMT);
+                OCIStmtRelease(stmtp, C->err, NULL, 0, OCI_DEFAULT);
                 return false;
         }
         C->lastError = OCIAttrGet(stmtp, OCI_HTYPE_STMT, &C->rowsChanged, 0, OCI_ATTR_ROW_COUNT, C->err);
         if (C->lastError != OCI_SUCCESS && C->lastError != OCI_SUCCESS_WITH_INFO)
                 DEBUG("OracleConnection_execute: Error in OCIAttrGet %d (%s)\n", C->lastError, OracleConnection_getLastError(C));
-        OCIHandleFree(stmtp, OCI_HTYPE_STMT);
+        OCIStmtRelease(stmtp, C->err, NULL, 0, OCI_DEFAULT);
         return C->lastError == OCI_SUCCESS;
 }
 
 
 ResultSet_T OracleConnection_executeQuery(T C, const char *sql, va_list ap) {
-        OCIStmt* stmtp;
+        OCIStmt* stmtp = NULL;
         va_list  ap_copy;
         assert(C);
         C->rowsChanged = 0;
@@ -349,12 +486,10 @@ ResultSet_T OracleConnection_executeQuery(T C, const char *sql, va_list ap) {
         va_end(ap_copy);
         StringBuffer_trim(C->sb);
         /* Build statement */
-        C->lastError = OCIHandleAlloc(C->env, (void **)&stmtp, OCI_HTYPE_STMT, 0, NULL);
-        if (C->lastError != OCI_SUCCESS && C->lastError != OCI_SUCCESS_WITH_INFO)
-                return NULL;
-        C->lastError = OCIStmtPrepare(stmtp, C->err, StringBuffer_toString(C->sb), StringBuffer_length(C->sb), OCI_NTV_SYNTAX, OCI_DEFAULT);
+        C->lastError = OCIStmtPrepare2(C->svc, &stmtp, C->err, StringBuffer_toString(C->sb), StringBuffer_length(C->sb), NULL, 0, OCI_NTV_SYNTAX, OCI_DEFAULT);
         if (C->lastError != OCI_SUCCESS && C->lastError != OCI_SUCCESS_WITH_INFO) {
-                OCIHandleFree(stmtp, OCI_HTYPE_STMT);
+                if (stmtp)
+                        OCIStmtRelease(stmtp, C->err, NULL, 0, OCI_STRLS_CACHE_DELETE);
                 return NULL;
         }
         /* Execute and create Result Set */
@@ -366,7 +501,7 @@ ResultSet_T OracleConnection_executeQuery(T C, const char *sql, va_list ap) {
                 ub4 parmcnt = 0;
                 OCIAttrGet(stmtp, OCI_HTYPE_STMT, &parmcnt, NULL, OCI_ATTR_PARSE_ERROR_OFFSET, C->err);
                 DEBUG("Error occured in StmtExecute %d (%s), offset is %d\n", C->lastError, OracleConnection_getLastError(C), parmcnt);
-                OCIHandleFree(stmtp, OCI_HTYPE_STMT);
+                OCIStmtRelease(stmtp, C->err, NULL, 0, OCI_DEFAULT);
                 return NULL;
         }
         C->lastError = OCIAttrGet(stmtp, OCI_HTYPE_STMT, &C->rowsChanged, 0, OCI_ATTR_ROW_COUNT, C->err);
@@ -377,7 +512,7 @@ ResultSet_T OracleConnection_executeQuery(T C, const char *sql, va_list ap) {
 
 
 PreparedStatement_T OracleConnection_prepareStatement(T C, const char *sql, va_list ap) {
-        OCIStmt *stmtp;
+        OCIStmt *stmtp = NULL;
         va_list ap_copy;
         assert(C);
         va_copy(ap_copy, ap);
@@ -386,12 +521,10 @@ PreparedStatement_T OracleConnection_prepareStatement(T C, const char *sql, va_l
         StringBuffer_trim(C->sb);
         int paramCount = StringBuffer_prepare4oracle(C->sb);
         /* Build statement */
-        C->lastError = OCIHandleAlloc(C->env, (void **)&stmtp, OCI_HTYPE_STMT, 0, 0);
-        if (C->lastError != OCI_SUCCESS && C->lastError != OCI_SUCCESS_WITH_INFO)
-                return NULL;
-        C->lastError = OCIStmtPrepare(stmtp, C->err, StringBuffer_toString(C->sb), StringBuffer_length(C->sb), OCI_NTV_SYNTAX, OCI_DEFAULT);
+        C->lastError = OCIStmtPrepare2(C->svc, &stmtp, C->err, StringBuffer_toString(C->sb), StringBuffer_length(C->sb), NULL, 0, OCI_NTV_SYNTAX, OCI_DEFAULT);
         if (C->lastError != OCI_SUCCESS && C->lastError != OCI_SUCCESS_WITH_INFO) {
-                OCIHandleFree(stmtp, OCI_HTYPE_STMT);
+                if (stmtp)
+                        OCIStmtRelease(stmtp, C->err, NULL, 0, OCI_STRLS_CACHE_DELETE);
                 return NULL;
         }
         return PreparedStatement_new(OraclePreparedStatement_new(stmtp, C->env, C->usr, C->err, C->svc, C->maxRows, C->timeout), (Pop_T)&oraclepops, paramCount);
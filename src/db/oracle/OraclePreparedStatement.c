@@ -47,6 +47,7 @@
 
 /**
  * Implementation of the PreparedStatement/Delegate interface for oracle.
+ * A batch is bound as one array per parameter and sent in a single execute.
  *
  * @file
  */
@@ -67,8 +68,20 @@ const struct Pop_T oraclepops = {
         .execute        = OraclePreparedStatement_execute,
         .executeQuery   = OraclePreparedStatement_executeQuery,
         .rowsChanged    = OraclePreparedStatement_rowsChanged,
-        .setFetchSize   = OraclePreparedStatement_setFetchSize
+        .setFetchSize   = OraclePreparedStatement_setFetchSize,
+        .executeBatch   = OraclePreparedStatement_executeBatch
 };
+
+/* Longest string which can be bound in a batch array */
+#define BATCH_STRING_SIZE 4000
+/* A batch parameter bound as an array of count fixed size elements */
+typedef struct column_t {
+        ub2 type;
+        sb4 size;
+        char *data;
+        sb2 *indicators;
+        ub2 *lengths;
+} column_t;
 typedef struct param_t {
         union {
                 double real;
@@ -109,6 +122,40 @@ extern const struct Rop_T oraclerops;
 WATCHDOG(watchdog, T)
 
 
+/* All values of a parameter must have the same type to be bound as an array.
+ Timestamps and blobs are not, the batch is then executed row by row */
+static int _column(const Param_T *rows, int count, int parameterCount, int i, ParamType_T *type, int *size) {
+        *type = PARAM_NULL;
+        *size = 1;
+        for (int r = 0; r < count; r++) {
+                const Param_T *p = &rows[(r * parameterCount) + i];
+                ParamType_T t = (p->type == PARAM_INT) ? PARAM_LLONG : p->type;
+                if (t == PARAM_NULL)
+                        continue;
+                if (t == PARAM_TIMESTAMP || t == PARAM_BLOB || (*type != PARAM_NULL && *type != t))
+                        return false;
+                *type = t;
+                if (t == PARAM_STRING) {
+                        if (p->size > BATCH_STRING_SIZE)
+                                return false;
+                        if (p->size > *size)
+                                *size = p->size;
+                }
+        }
+        return true;
+}
+
+
+static void _freeColumns(column_t *columns, int parameterCount) {
+        for (int i = 0; i < parameterCount; i++) {
+                FREE(columns[i].data);
+                FREE(columns[i].indicators);
+                FREE(columns[i].lengths);
+        }
+        FREE(columns);
+}
+
+
 /* ----------------------------------------------------- Protected methods */
 
 
@@ -146,7 +193,7 @@ T OraclePreparedStatement_new(OCIStmt *stmt, OCIEnv *env, OCISession* usr, OCIEr
 
 void OraclePreparedStatement_free(T *P) {
         assert(P && *P);
-        OCIHandleFree((*P)->stmt, OCI_HTYPE_STMT);
+        OCIStmtRelease((*P)->stmt, (*P)->err, NULL, 0, OCI_DEFAULT);
         if ((*P)->params) {
                 // (*P)->params[i].bind is freed implicitly when the statement handle is deallocated
                 FREE((*P)->params);
@@ -288,6 +335,91 @@ long long OraclePreparedStatement_rowsChanged(T P) {
 }
 
 
+int OraclePreparedStatement_executeBatch(T P, const Param_T *rows, int count, long long *counts) {
+        assert(P);
+        int size;
+        ParamType_T type;
+        int parameterCount = (int)P->paramCount;
+        if (parameterCount <= 0)
+                return false;
+        for (int i = 0; i < parameterCount; i++)
+                if (! _column(rows, count, parameterCount, i, &type, &size))
+                        return false;
+        column_t *columns = CALLOC(parameterCount, sizeof(column_t));
+        P->lastError = OCI_SUCCESS;
+        for (int i = 0; i < parameterCount && P->lastError == OCI_SUCCESS; i++) {
+                column_t *c = &columns[i];
+                _column(rows, count, parameterCount, i, &type, &size);
+                switch (type) {
+                        case PARAM_LLONG:
+                                c->type = SQLT_VNU;
+                                c->size = sizeof(OCINumber);
+                                break;
+                        case PARAM_DOUBLE:
+                                c->type = SQLT_FLT;
+                                c->size = sizeof(double);
+                                break;
+                        default:
+                                c->type = SQLT_CHR;
+                                c->size = size;
+                                c->lengths = CALLOC(count, sizeof(ub2));
+                                break;
+                }
+                c->data = CALLOC(count, c->size);
+                c->indicators = CALLOC(count, sizeof(sb2));
+                for (int r = 0; r < count && P->lastError == OCI_SUCCESS; r++) {
+                        const Param_T *p = &rows[(r * parameterCount) + i];
+                        char *element = c->data + ((long)r * c->size);
+                        if (p->type == PARAM_NULL) {
+                                c->indicators[r] = -1;
+                        } else if (c->type == SQLT_VNU) {
+                                P->lastError = OCINumberFromInt(P->err, &p->value.integer, sizeof(p->value.integer), OCI_NUMBER_SIGNED, (OCINumber *)element);
+                        } else if (c->type == SQLT_FLT) {
+                                memcpy(element, &p->value.real, sizeof(double));
+                        } else {
+                                memcpy(element, p->value.data, p->size);
+                                c->lengths[r] = (ub2)p->size;
+                        }
+                }
+                if (P->lastError == OCI_SUCCESS)
+                        P->lastError = OCIBindByPos(P->stmt, &P->params[i].bind, P->err, i + 1, c->data, c->size, c->type, c->indicators, c->lengths, 0, 0, 0, OCI_DEFAULT);
+                if (P->lastError == OCI_SUCCESS || P->lastError == OCI_SUCCESS_WITH_INFO)
+                        P->lastError = OCIBindArrayOfStruct(P->params[i].bind, P->err, c->size, sizeof(sb2), c->lengths ? sizeof(ub2) : 0, 0);
+                if (P->lastError == OCI_SUCCESS_WITH_INFO)
+                        P->lastError = OCI_SUCCESS;
+        }
+        if (P->lastError == OCI_SUCCESS) {
+#ifdef OCI_RETURN_ROW_COUNT_ARRAY
+                ub4 mode = OCI_RETURN_ROW_COUNT_ARRAY;
+#else
+                ub4 mode = OCI_DEFAULT;
+#endif
+                P->rowsChanged = 0;
+                P->countdown = P->timeout;
+                P->running = true;
+                P->lastError = OCIStmtExecute(P->svc, P->stmt, P->err, (ub4)count, 0, NULL, NULL, mode);
+                P->running = false;
+        }
+        _freeColumns(columns, parameterCount);
+        if (P->lastError != OCI_SUCCESS && P->lastError != OCI_SUCCESS_WITH_INFO)
+                THROW(SQLException, "%s", OraclePreparedStatement_getLastError(P->lastError, P->err));
+        OCIAttrGet(P->stmt, OCI_HTYPE_STMT, &P->rowsChanged, 0, OCI_ATTR_ROW_COUNT, P->err);
+#ifdef OCI_RETURN_ROW_COUNT_ARRAY
+        ub8 *rowCounts = NULL;
+        ub4 rowCountsSize = 0;
+        if (OCIAttrGet(P->stmt, OCI_HTYPE_STMT, &rowCounts, &rowCountsSize, OCI_ATTR_DML_ROW_COUNT_ARRAY, P->err) == OCI_SUCCESS && rowCounts && rowCountsSize == (ub4)count) {
+                for (int r = 0; r < count; r++)
+                        counts[r] = (long long)rowCounts[r];
+                return true;
+        }
+#endif
+        /* Only the total is known, which for a plain insert is one per row */
+        for (int r = 0; r < count; r++)
+                counts[r] = (P->rowsChanged == (ub4)count) ? 1 : BATCH_SUCCESS_NO_INFO;
+        return true;
+}
+
+
 /* Error handling: Oracle requires a buffer to store
    error message, to keep error handling thread safe
    TSD is used
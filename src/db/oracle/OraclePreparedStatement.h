@@ -39,5 +39,6 @@ ResultSet_T OraclePreparedStatement_executeQuery(T P);
 long long OraclePreparedStatement_rowsChanged(T P);
 const char *OraclePreparedStatement_getLastError(int err, OCIError *errhp);
 void OraclePreparedStatement_setFetchSize(T P, int prefetch_rows);
+int OraclePreparedStatement_executeBatch(T P, const Param_T *rows, int count, long long *counts);
 #undef T
 #endif
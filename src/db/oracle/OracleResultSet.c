@@ -60,23 +60,47 @@ const struct Rop_T oraclerops = {
         .next           = OracleResultSet_next,
         .isnull         = OracleResultSet_isnull,
         .getString      = OracleResultSet_getString,
+        .getInt         = OracleResultSet_getInt,
+        .getLLong       = OracleResultSet_getLLong,
+        .getDouble      = OracleResultSet_getDouble,
         .getBlob        = OracleResultSet_getBlob,
         .setFetchSize   = OracleResultSet_setFetchSize
         // getTimestamp and getDateTime is handled in ResultSet
 };
+/* How a column is defined. NUMBER and BINARY_DOUBLE/FLOAT columns are 
+ fetched in their native form and only formatted as text by getString */
+#define COLUMN_STRING   0
+#define COLUMN_NUMBER   1
+#define COLUMN_REAL     2
+#define NATIVE_LENGTH   64
+
+/* Rows fetched per OCIStmtFetch2 call if no fetch size is set */
+#define FETCH_ROWS      32
+
+/* Columns are defined as arrays of R->rows values, the current row is R->cursor */
 typedef struct column_t {
         OCIDefine *def;
-        int isNull;
-        char *buffer;
+        int kind;
+        int formatted; // Row the buffer was formatted for, native columns only
+        int width; // Size of a value in data
+        sb2 *indicators;
+        char *data;
+        OCINumber *numbers;
+        double *reals;
+        OCILobLocator **lobs;
+        OCIDateTime **dates;
+        char *buffer; // Text or blob of the current row
         char *name;
         unsigned long length;
-        OCILobLocator *lob_loc;
-        OCIDateTime   *date; 
 } *column_t;
 #define T ResultSetDelegate_T
 struct T {
         int         columnCount;
         int         row;
+        int         rows;
+        int         cursor;
+        int         fetched;
+        int         done;
         ub4         maxRow;
         OCIStmt*    stmt;
         OCIEnv*     env;
@@ -98,14 +122,40 @@ struct T {
 /* ------------------------------------------------------- Private methods */
 
 
+/* Index of the current row in the column arrays */
+static inline int _cursor(T R) {
+        return (R->cursor >= 0 && R->cursor < R->fetched) ? R->cursor : 0;
+}
+
+
+static inline int _isNull(T R, int i) {
+        return R->columns[i].indicators[_cursor(R)] == -1;
+}
+
+
+/* Allocate a descriptor for each row of a LOB or TIMESTAMP column */
+static void _allocDescriptors(T R, void **descriptors, ub4 type) {
+        for (int r = 0; r < R->rows; r++)
+                OCIDescriptorAlloc((dvoid *)R->env, (dvoid **)&descriptors[r], type, (size_t)0, (dvoid **)0);
+}
+
+
+static void _freeDescriptors(T R, void **descriptors, ub4 type) {
+        if (descriptors)
+                for (int r = 0; r < R->rows; r++)
+                        if (descriptors[r])
+                                OCIDescriptorFree(descriptors[r], type);
+}
+
+
 static int _initaleDefiningBuffers(T R) {
         ub2 dtype = 0;
         int deptlen;
         int sizelen = sizeof(deptlen);
         OCIParam* pard = NULL;
-        sword status;
         for (int i = 1; i <= R->columnCount; i++) {
-                 deptlen = 0;
+                column_t c = &R->columns[i-1];
+                deptlen = 0;
                 /* The next two statements describe the select-list item, dname, and
                  return its length */
                 R->lastError = OCIParamGet(R->stmt, OCI_HTYPE_STMT, R->err, (void **)&pard, i);
@@ -118,47 +168,49 @@ static int _initaleDefiningBuffers(T R) {
                         return false;
                 }
                 OCIAttrGet(pard, OCI_DTYPE_PARAM, &dtype, 0, OCI_ATTR_DATA_TYPE, R->err); 
-                /* Use the retrieved length of dname to allocate an output buffer, and
+                /* Use the retrieved length of dname to allocate an output array, and
                  then define the output variable. */
                 deptlen +=1;
-                R->columns[i-1].length = deptlen;
-                R->columns[i-1].isNull = 0;
+                c->indicators = CALLOC(R->rows, sizeof(sb2));
                 switch(dtype) 
                 {
                         case SQLT_BLOB:
-                                R->columns[i-1].buffer = NULL;
-                                status = OCIDescriptorAlloc((dvoid *)R->env, (dvoid **) &(R->columns[i-1].lob_loc),
-                                                (ub4) OCI_DTYPE_LOB,
-                                                (size_t) 0, (dvoid **) 0);
-                                R->lastError = OCIDefineByPos(R->stmt, &R->columns[i-1].def, R->err, i, 
-                                        &(R->columns[i-1].lob_loc), deptlen, SQLT_BLOB, &(R->columns[i-1].isNull), 0, 0, OCI_DEFAULT);
-                                break;
-
                         case SQLT_CLOB: 
-                                R->columns[i-1].buffer = NULL;
-                                status = OCIDescriptorAlloc((dvoid *)R->env, (dvoid **) &(R->columns[i-1].lob_loc),
-                                                (ub4) OCI_DTYPE_LOB,
-                                                (size_t) 0, (dvoid **) 0);
-                                R->lastError = OCIDefineByPos(R->stmt, &R->columns[i-1].def, R->err, i, 
-                                        &(R->columns[i-1].lob_loc), deptlen, SQLT_CLOB, &(R->columns[i-1].isNull), 0, 0, OCI_DEFAULT);
+                                c->lobs = CALLOC(R->rows, sizeof(OCILobLocator *));
+                                _allocDescriptors(R, (void **)c->lobs, OCI_DTYPE_LOB);
+                                R->lastError = OCIDefineByPos(R->stmt, &c->def, R->err, i, 
+                                        c->lobs, sizeof(OCILobLocator *), dtype, c->indicators, 0, 0, OCI_DEFAULT);
                                 break;
                         case SQLT_DAT:
                         case SQLT_DATE:
                         case SQLT_TIMESTAMP:
                         case SQLT_TIMESTAMP_TZ:
                         case SQLT_TIMESTAMP_LTZ:
-                                R->columns[i-1].buffer = NULL;
-                                status = OCIDescriptorAlloc((dvoid *)R->env, (dvoid **) &(R->columns[i-1].date),
-                                                (ub4) OCI_DTYPE_TIMESTAMP,
-                                                (size_t) 0, (dvoid **) 0);
-                                R->lastError = OCIDefineByPos(R->stmt, &R->columns[i-1].def, R->err, i, 
-                                        &(R->columns[i-1].date), sizeof(R->columns[i-1].date), SQLT_TIMESTAMP, &(R->columns[i-1].isNull), 0, 0, OCI_DEFAULT);
+                                c->dates = CALLOC(R->rows, sizeof(OCIDateTime *));
+                                _allocDescriptors(R, (void **)c->dates, OCI_DTYPE_TIMESTAMP);
+                                R->lastError = OCIDefineByPos(R->stmt, &c->def, R->err, i, 
+                                        c->dates, sizeof(OCIDateTime *), SQLT_TIMESTAMP, c->indicators, 0, 0, OCI_DEFAULT);
+                                break;
+                        case SQLT_NUM:
+                                c->kind = COLUMN_NUMBER;
+                                c->buffer = ALLOC(NATIVE_LENGTH);
+                                c->numbers = CALLOC(R->rows, sizeof(OCINumber));
+                                R->lastError = OCIDefineByPos(R->stmt, &c->def, R->err, i, 
+                                        c->numbers, sizeof(OCINumber), SQLT_VNU, c->indicators, 0, 0, OCI_DEFAULT);
+                                break;
+                        case SQLT_IBFLOAT:
+                        case SQLT_IBDOUBLE:
+                                c->kind = COLUMN_REAL;
+                                c->buffer = ALLOC(NATIVE_LENGTH);
+                                c->reals = CALLOC(R->rows, sizeof(double));
+                                R->lastError = OCIDefineByPos(R->stmt, &c->def, R->err, i, 
+                                        c->reals, sizeof(double), SQLT_BDOUBLE, c->indicators, 0, 0, OCI_DEFAULT);
                                 break;
                         default:
-                                R->columns[i-1].lob_loc = NULL;
-                                R->columns[i-1].buffer = ALLOC(deptlen + 1);
-                                R->lastError = OCIDefineByPos(R->stmt, &R->columns[i-1].def, R->err, i, 
-                                        R->columns[i-1].buffer, deptlen, SQLT_STR, &(R->columns[i-1].isNull), 0, 0, OCI_DEFAULT);
+                                c->width = deptlen;
+                                c->data = CALLOC(R->rows, deptlen);
+                                R->lastError = OCIDefineByPos(R->stmt, &c->def, R->err, i, 
+                                        c->data, deptlen, SQLT_STR, c->indicators, 0, 0, OCI_DEFAULT);
                 }
                 {
                         char *col_name;
@@ -173,11 +225,11 @@ static int _initaleDefiningBuffers(T R) {
                         // so, copy the string
                         tmp_buffer = Str_ndup(col_name, col_name_len);
 #if defined(ORACLE_COLUMN_NAME_LOWERCASE) && ORACLE_COLUMN_NAME_LOWERCASE > 1
-                        R->columns[i-1].name = CALLOC(1, col_name_len+1);
-                        OCIMultiByteStrCaseConversion(R->env, R->columns[i-1].name, tmp_buffer, OCI_NLS_LOWERCASE);
+                        c->name = CALLOC(1, col_name_len+1);
+                        OCIMultiByteStrCaseConversion(R->env, c->name, tmp_buffer, OCI_NLS_LOWERCASE);
                         FREE(tmp_buffer);
 #else
-                        R->columns[i-1].name = tmp_buffer;
+                        c->name = tmp_buffer;
 #endif /*COLLUMN_NAME_LOWERCASE*/
                 }
                 OCIDescriptorFree(pard, OCI_DTYPE_PARAM);
@@ -199,7 +251,7 @@ static int _toString(T R, int i)
         R->columns[i].buffer = ALLOC(R->columns[i].length + 1);
         R->lastError = OCIDateTimeToText(R->usr, 
                                          R->err, 
-                                         R->columns[i].date,
+                                         R->columns[i].dates[_cursor(R)],
                                          fmt, strlen(fmt),
                                          0,
                                          NULL, 0,
@@ -208,6 +260,40 @@ static int _toString(T R, int i)
 }
 
 
+/* Format the native value of column i as text in its buffer, once per row */
+static const char *_format(T R, int i) {
+        column_t c = &R->columns[i];
+        if (c->formatted == R->row)
+                return c->buffer;
+        if (c->kind == COLUMN_NUMBER) {
+                const char fmt[] = "TM9"; // Text minimum, as a NUMBER fetched as a string
+                ub4 size = NATIVE_LENGTH - 1;
+                R->lastError = OCINumberToText(R->err, &c->numbers[_cursor(R)], (const oratext *)fmt, strlen(fmt), NULL, 0, &size, (oratext *)c->buffer);
+                if (R->lastError != OCI_SUCCESS && R->lastError != OCI_SUCCESS_WITH_INFO)
+                        THROW(SQLException, "%s", OraclePreparedStatement_getLastError(R->lastError, R->err));
+                c->buffer[size] = 0;
+        } else {
+                // Shortest text that reads back as the same value
+                double real = c->reals[_cursor(R)];
+                for (int precision = 15; precision <= 17; precision++) {
+                        snprintf(c->buffer, NATIVE_LENGTH, "%.*g", precision, real);
+                        if (strtod(c->buffer, NULL) == real)
+                                break;
+                }
+        }
+        c->formatted = R->row;
+        return c->buffer;
+}
+
+
+/* Convert a NUMBER column to a native integer of size bytes */
+static void _toInt(T R, int i, void *n, int size) {
+        R->lastError = OCINumberToInt(R->err, &R->columns[i].numbers[_cursor(R)], size, OCI_NUMBER_SIGNED, n);
+        if (R->lastError != OCI_SUCCESS && R->lastError != OCI_SUCCESS_WITH_INFO)
+                THROW(SQLException, "%s", OraclePreparedStatement_getLastError(R->lastError, R->err));
+}
+
+
 /* ----------------------------------------------------- Protected methods */
 
 
@@ -229,9 +315,16 @@ T OracleResultSet_new(OCIStmt *stmt, OCIEnv *env, OCISession* usr, OCIError *err
         R->usr  = usr;
         R->freeStatement = need_free;
         R->row = 0;
+        R->cursor = -1;
         R->lastError = OCIAttrGet(R->stmt, OCI_HTYPE_STMT, &R->maxRow, NULL, OCI_ATTR_ROW_COUNT/*OCI_ATTR_ROWS_FETCHED*/, R->err);
         if (R->lastError != OCI_SUCCESS && R->lastError != OCI_SUCCESS_WITH_INFO)
                 DEBUG("OracleResultSet_new: Error %d, '%s'\n", R->lastError, OraclePreparedStatement_getLastError(R->lastError,R->err));
+        if ((max_row != 0) && ((R->maxRow > max_row) ||(R->maxRow == 0))) 
+                R->maxRow = max_row;
+        /* Rows are fetched fetchSize at a time into the defined arrays */
+        R->rows = (fetchSize > 0) ? fetchSize : FETCH_ROWS;
+        if ((R->maxRow > 0) && (R->maxRow < (ub4)R->rows))
+                R->rows = R->maxRow;
         /* Get the number of columns in the select list */
         R->lastError = OCIAttrGet (R->stmt, OCI_HTYPE_STMT, &R->columnCount, NULL, OCI_ATTR_PARAM_COUNT, R->err);
         if (R->lastError != OCI_SUCCESS && R->lastError != OCI_SUCCESS_WITH_INFO)
@@ -241,8 +334,6 @@ T OracleResultSet_new(OCIStmt *stmt, OCIEnv *env, OCISession* usr, OCIError *err
                 DEBUG("OracleResultSet_new: Error %d, '%s'\n", R->lastError, OraclePreparedStatement_getLastError(R->lastError,R->err));
                 R->row = -1;
         }
-        if ((max_row != 0) && ((R->maxRow > max_row) ||(R->maxRow == 0))) 
-                R->maxRow = max_row;
         if (R->row != -1) {
                 OracleResultSet_setFetchSize(R, fetchSize);
         }
@@ -254,14 +345,19 @@ T OracleResultSet_new(OCIStmt *stmt, OCIEnv *env, OCISession* usr, OCIError *err
 void OracleResultSet_free(T *R) {
         assert(R && *R);
         if ((*R)->freeStatement)
-                OCIHandleFree((*R)->stmt, OCI_HTYPE_STMT);
+                OCIStmtRelease((*R)->stmt, (*R)->err, NULL, 0, OCI_DEFAULT);
         for (int i = 0; i < (*R)->columnCount; i++) {
-                if ((*R)->columns[i].lob_loc)
-                        OCIDescriptorFree((*R)->columns[i].lob_loc, OCI_DTYPE_LOB);
-                if ((*R)->columns[i].date)
-                        OCIDescriptorFree((dvoid*)(*R)->columns[i].date, OCI_DTYPE_TIMESTAMP);
-                FREE((*R)->columns[i].buffer);
-                FREE((*R)->columns[i].name);
+                column_t c = &(*R)->columns[i];
+                _freeDescriptors(*R, (void **)c->lobs, OCI_DTYPE_LOB);
+                _freeDescriptors(*R, (void **)c->dates, OCI_DTYPE_TIMESTAMP);
+                FREE(c->lobs);
+                FREE(c->dates);
+                FREE(c->indicators);
+                FREE(c->data);
+                FREE(c->numbers);
+                FREE(c->reals);
+                FREE(c->buffer);
+                FREE(c->name);
         }
         FREE((*R)->columns);
         FREE(*R);
@@ -309,48 +405,111 @@ int OracleResultSet_next(T R) {
         assert(R);
         if ((R->row < 0) || ((R->maxRow > 0) && (R->row >= R->maxRow)))
                 return false;
-        R->lastError = OCIStmtFetch2(R->stmt, R->err, 1, OCI_FETCH_NEXT, 0, OCI_DEFAULT);
-        if (R->lastError == OCI_NO_DATA) 
-                return false;
-        if (R->lastError != OCI_SUCCESS && R->lastError != OCI_SUCCESS_WITH_INFO)
-                THROW(SQLException, "%s", OraclePreparedStatement_getLastError(R->lastError, R->err));
-        if (R->lastError == OCI_SUCCESS_WITH_INFO)
-                DEBUG("OracleResultSet_next Error %d, '%s'\n", R->lastError, OraclePreparedStatement_getLastError(R->lastError, R->err));
+        if (++R->cursor >= R->fetched) {
+                /* Fetch the next array of rows, the last array may be partial and ends with OCI_NO_DATA */
+                ub4 fetched = 0;
+                if (R->done)
+                        return false;
+                R->lastError = OCIStmtFetch2(R->stmt, R->err, R->rows, OCI_FETCH_NEXT, 0, OCI_DEFAULT);
+                if (R->lastError == OCI_NO_DATA) 
+                        R->done = true;
+                else if (R->lastError != OCI_SUCCESS && R->lastError != OCI_SUCCESS_WITH_INFO)
+                        THROW(SQLException, "%s", OraclePreparedStatement_getLastError(R->lastError, R->err));
+                if (R->lastError == OCI_SUCCESS_WITH_INFO)
+                        DEBUG("OracleResultSet_next Error %d, '%s'\n", R->lastError, OraclePreparedStatement_getLastError(R->lastError, R->err));
+                OCIAttrGet(R->stmt, OCI_HTYPE_STMT, &fetched, NULL, OCI_ATTR_ROWS_FETCHED, R->err);
+                R->fetched = fetched;
+                R->cursor = 0;
+                if (R->fetched <= 0)
+                        return false;
+        }
         R->row++;
-        return ((R->lastError == OCI_SUCCESS) || (R->lastError == OCI_SUCCESS_WITH_INFO));
+        return true;
 }
 
 
 int OracleResultSet_isnull(T R, int columnIndex) {
         assert(R);
         int i = checkAndSetColumnIndex(columnIndex, R->columnCount);
-        return R->columns[i].isNull;
+        return _isNull(R, i);
 }
 
 
 const char *OracleResultSet_getString(T R, int columnIndex) {
         assert(R);
         int i = checkAndSetColumnIndex(columnIndex, R->columnCount);
-        if (R->columns[i].isNull)
+        if (_isNull(R, i))
                 return NULL;
-        if (R->columns[i].date)
+        if (R->columns[i].kind != COLUMN_STRING)
+                return _format(R, i);
+        if (R->columns[i].dates)
         {
                 if (!_toString(R, i))
                 {
                         THROW(SQLException, "%s", OraclePreparedStatement_getLastError(R->lastError, R->err));
                 }
-        }
-        if (R->columns[i].buffer)
                 R->columns[i].buffer[R->columns[i].length] = 0;
-        return R->columns[i].buffer;
+                return R->columns[i].buffer;
+        }
+        if (R->columns[i].data)
+                return R->columns[i].data + (_cursor(R) * R->columns[i].width);
+        return NULL;
+}
+
+
+int OracleResultSet_getInt(T R, int columnIndex) {
+        assert(R);
+        int i = checkAndSetColumnIndex(columnIndex, R->columnCount);
+        if (_isNull(R, i))
+                return 0;
+        if (R->columns[i].kind == COLUMN_NUMBER) {
+                int n = 0;
+                _toInt(R, i, &n, sizeof(n));
+                return n;
+        }
+        return Str_parseInt(OracleResultSet_getString(R, columnIndex));
+}
+
+
+long long OracleResultSet_getLLong(T R, int columnIndex) {
+        assert(R);
+        int i = checkAndSetColumnIndex(columnIndex, R->columnCount);
+        if (_isNull(R, i))
+                return 0;
+        if (R->columns[i].kind == COLUMN_NUMBER) {
+                long long n = 0;
+                _toInt(R, i, &n, sizeof(n));
+                return n;
+        }
+        return Str_parseLLong(OracleResultSet_getString(R, columnIndex));
+}
+
+
+double OracleResultSet_getDouble(T R, int columnIndex) {
+        assert(R);
+        int i = checkAndSetColumnIndex(columnIndex, R->columnCount);
+        if (_isNull(R, i))
+                return 0.0;
+        if (R->columns[i].kind == COLUMN_REAL)
+                return R->columns[i].reals[_cursor(R)];
+        if (R->columns[i].kind == COLUMN_NUMBER) {
+                double d = 0.0;
+                R->lastError = OCINumberToReal(R->err, &R->columns[i].numbers[_cursor(R)], sizeof(d), &d);
+                if (R->lastError != OCI_SUCCESS && R->lastError != OCI_SUCCESS_WITH_INFO)
+                        THROW(SQLException, "%s", OraclePreparedStatement_getLastError(R->lastError, R->err));
+                return d;
+        }
+        return Str_parseDouble(OracleResultSet_getString(R, columnIndex));
 }
 
 
 const void *OracleResultSet_getBlob(T R, int columnIndex, int *size) {
         assert(R);
         int i = checkAndSetColumnIndex(columnIndex, R->columnCount);
-        if (R->columns[i].isNull)
+        if (_isNull(R, i))
                 return NULL;
+        if (! R->columns[i].lobs)
+                THROW(SQLException, "Column %d is not a BLOB or CLOB", columnIndex);
         if (R->columns[i].buffer)
                 FREE(R->columns[i].buffer);
         oraub8 read_chars = 0;
@@ -362,7 +521,7 @@ const void *OracleResultSet_getBlob(T R, int columnIndex, int *size) {
         do {
                 read_bytes = 0;
                 read_chars = 0;
-                R->lastError = OCILobRead2(R->svc, R->err, R->columns[i].lob_loc, &read_bytes, &read_chars, 1, 
+                R->lastError = OCILobRead2(R->svc, R->err, R->columns[i].lobs[_cursor(R)], &read_bytes, &read_chars, 1, 
                                 R->columns[i].buffer + total_bytes, LOB_CHUNK_SIZE, piece, NULL, NULL, 0, SQLCS_IMPLICIT);
                 if (read_bytes) {
                         total_bytes += read_bytes;
@@ -34,6 +34,9 @@ long OracleResultSet_getColumnSize(T R, int columnIndex);
 int  OracleResultSet_next(T R);
 int OracleResultSet_isnull(T R, int columnIndex);
 const char *OracleResultSet_getString(T R, int columnIndex);
+int OracleResultSet_getInt(T R, int columnIndex);
+long long OracleResultSet_getLLong(T R, int columnIndex);
+double OracleResultSet_getDouble(T R, int columnIndex);
 const void *OracleResultSet_getBlob(T R, int columnIndex, int *size);
 void OracleResultSet_setFetchSize(T R, int prefetch_rows);
 #undef T
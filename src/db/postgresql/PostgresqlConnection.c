@@ -30,6 +30,7 @@
 #include <libpq-fe.h>
 
 #include "URL.h"
+#include "system/Time.h"
 #include "ResultSet.h"
 #include "StringBuffer.h"
 #include "PreparedStatement.h"
@@ -41,6 +42,10 @@
 
 /**
  * Implementation of the Connection/Delegate interface for postgresql. 
+ * In pipeline mode statements are only sent to the server and their 
+ * results are read in order when the pipeline is synced. This requires
+ * libpq 14 or later. COPY data is streamed with PQputCopyData and 
+ * PQgetCopyData in whatever format the COPY statement selected.
  * 
  * @file
  */
@@ -55,7 +60,9 @@ const struct Cop_T postgresqlcops = {
         .free 		 	= PostgresqlConnection_free,
         .setQueryTimeout 	= PostgresqlConnection_setQueryTimeout,
         .setMaxRows 	 	= PostgresqlConnection_setMaxRows,
+        .setDefaultRowPrefetch  = PostgresqlConnection_setDefaultRowPrefetch,
         .ping		 	= PostgresqlConnection_ping,
+        .getSocket              = PostgresqlConnection_getSocket,
         .beginTransaction	= PostgresqlConnection_beginTransaction,
         .commit			= PostgresqlConnection_commit,
         .rollback		= PostgresqlConnection_rollback,
@@ -64,7 +71,19 @@ const struct Cop_T postgresqlcops = {
         .execute		= PostgresqlConnection_execute,
         .executeQuery		= PostgresqlConnection_executeQuery,
         .prepareStatement	= PostgresqlConnection_prepareStatement,
-        .getLastError		= PostgresqlConnection_getLastError
+        .getLastError		= PostgresqlConnection_getLastError,
+        .executeParams          = PostgresqlConnection_executeParams,
+        .executeQueryParams     = PostgresqlConnection_executeQueryParams,
+        .copyIn                 = PostgresqlConnection_copyIn,
+        .putCopyData            = PostgresqlConnection_putCopyData,
+        .endCopyIn              = PostgresqlConnection_endCopyIn,
+        .copyOut                = PostgresqlConnection_copyOut,
+        .getCopyData            = PostgresqlConnection_getCopyData,
+#ifdef LIBPQ_HAS_PIPELINING
+        .beginPipeline          = PostgresqlConnection_beginPipeline,
+        .syncPipeline           = PostgresqlConnection_syncPipeline,
+        .endPipeline            = PostgresqlConnection_endPipeline
+#endif
 };
 
 #define T ConnectionDelegate_T
@@ -74,7 +93,10 @@ struct T {
 	PGresult *res;
 	int maxRows;
 	int timeout;
+        int fetchSize; // If > 0, query results are streamed
+        int resultFormat; // 1 if query results are requested in binary format
 	ExecStatusType lastError;
+        char *copyData; // Last buffer from PQgetCopyData
         StringBuffer_T sb;
 };
 static uint32_t statementid = 0;
@@ -85,6 +107,184 @@ extern const struct Pop_T postgresqlpops;
 /* ------------------------------------------------------- Private methods */
 
 
+static inline int _isPipelined(T C) {
+#ifdef LIBPQ_HAS_PIPELINING
+        return PQpipelineStatus(C->db) != PQ_PIPELINE_OFF;
+#else
+        return false;
+#endif
+}
+
+
+/* Queue a statement in pipeline mode, its result is read on sync */
+static int _send(T C, const char *sql) {
+        PQclear(C->res);
+        C->res = NULL;
+        if (PQsendQueryParams(C->db, sql, 0, NULL, NULL, NULL, NULL, 0)) {
+                C->lastError = PGRES_COMMAND_OK;
+                return true;
+        }
+        C->lastError = PGRES_FATAL_ERROR;
+        return false;
+}
+
+
+/* Parameters of Connection_executeParams() in the form PQexecParams wants them */
+typedef struct params_t {
+        int count;
+        char **values;
+        int *lengths;
+        int *formats;
+        char (*text)[65];
+} params_t;
+
+
+static void _bindParams(params_t *p, int count, const Param_T *params) {
+        *p = (params_t){.count = count};
+        if (count <= 0)
+                return;
+        p->values = CALLOC(count, sizeof(char *));
+        p->lengths = CALLOC(count, sizeof(int));
+        p->formats = CALLOC(count, sizeof(int));
+        p->text = CALLOC(count, sizeof(*p->text));
+        for (int i = 0; i < count; i++) {
+                switch (params[i].type) {
+                        case PARAM_NULL:
+                                break;
+                        case PARAM_STRING:
+                                p->values[i] = (char *)params[i].value.data;
+                                break;
+                        case PARAM_INT:
+                        case PARAM_LLONG:
+                                snprintf(p->text[i], 64, "%lld", params[i].value.integer);
+                                p->values[i] = p->text[i];
+                                break;
+                        case PARAM_DOUBLE:
+                                snprintf(p->text[i], 64, "%.17g", params[i].value.real);
+                                p->values[i] = p->text[i];
+                                break;
+                        case PARAM_TIMESTAMP:
+                                p->values[i] = Time_toString((time_t)params[i].value.integer, p->text[i]);
+                                break;
+                        case PARAM_BLOB:
+                                p->values[i] = (char *)params[i].value.data;
+                                p->lengths[i] = params[i].size;
+                                p->formats[i] = 1;
+                                break;
+                }
+        }
+}
+
+
+static void _freeParams(params_t *p) {
+        if (p->count > 0) {
+                FREE(p->values);
+                FREE(p->lengths);
+                FREE(p->formats);
+                FREE(p->text);
+        }
+}
+
+
+/* Run the query in C->sb, with parameters if not NULL, and return its result. 
+ The result is streamed if a fetch size is set */
+static ResultSet_T _query(T C, params_t *p) {
+        int count = p ? p->count : 0;
+        const char **values = p ? (const char **)p->values : NULL;
+        int *lengths = p ? p->lengths : NULL;
+        int *formats = p ? p->formats : NULL;
+        if (C->fetchSize > 0) {
+                C->res = NULL;
+                int cancel = (PQtransactionStatus(C->db) == PQTRANS_IDLE);
+                int sent = (p || C->resultFormat)
+                        ? PQsendQueryParams(C->db, StringBuffer_toString(C->sb), count, NULL, values, lengths, formats, C->resultFormat) 
+                        : PQsendQuery(C->db, StringBuffer_toString(C->sb));
+                if (! sent) {
+                        C->lastError = PGRES_FATAL_ERROR;
+                        return NULL;
+                }
+                ResultSetDelegate_T R = PostgresqlResultSet_stream(C->db, C->maxRows, C->fetchSize, cancel, (void **)&C->res);
+                if (R)
+                        return ResultSet_new(R, (Rop_T)&postgresqlrops);
+                C->lastError = C->res ? PQresultStatus(C->res) : PGRES_FATAL_ERROR;
+                return NULL;
+        }
+        if (p || C->resultFormat)
+                C->res = PQexecParams(C->db, StringBuffer_toString(C->sb), count, NULL, values, lengths, formats, C->resultFormat);
+        else
+                C->res = PQexec(C->db, StringBuffer_toString(C->sb));
+        C->lastError = C->res ? PQresultStatus(C->res) : PGRES_FATAL_ERROR;
+        if (C->lastError == PGRES_TUPLES_OK)
+                return ResultSet_new(PostgresqlResultSet_new(C->res, C->maxRows), (Rop_T)&postgresqlrops);
+        return NULL;
+}
+
+
+/* Start a COPY statement, the server answers with the copy state we expect */
+static int _copy(T C, const char *sql, va_list ap, ExecStatusType expect) {
+        va_list ap_copy;
+        PQclear(C->res);
+        va_copy(ap_copy, ap);
+        StringBuffer_vset(C->sb, sql, ap_copy);
+        va_end(ap_copy);
+        C->res = PQexec(C->db, StringBuffer_toString(C->sb));
+        C->lastError = C->res ? PQresultStatus(C->res) : PGRES_FATAL_ERROR;
+        return (C->lastError == expect);
+}
+
+
+/* Read the result of a finished COPY, which has the row count */
+static int _endCopy(T C) {
+        PGresult *res;
+        PQclear(C->res);
+        C->res = PQgetResult(C->db);
+        C->lastError = C->res ? PQresultStatus(C->res) : PGRES_FATAL_ERROR;
+        while ((res = PQgetResult(C->db)))
+                PQclear(res);
+        return (C->lastError == PGRES_COMMAND_OK);
+}
+
+
+#ifdef LIBPQ_HAS_PIPELINING
+/* Read results up to and including the next sync point. The first failed
+ result is kept in C->res for getLastError, else the last completed one 
+ so rowsChanged refers to the last statement in the pipeline */
+static int _readPipeline(T C) {
+        int nulls = 0;
+        PGresult *res, *error = NULL;
+        ExecStatusType status = PGRES_FATAL_ERROR;
+        PQclear(C->res);
+        C->res = NULL;
+        while (status != PGRES_PIPELINE_SYNC) {
+                if (! (res = PQgetResult(C->db))) {
+                        // Every statement's results end with NULL, two in a row means nothing is pending
+                        if (++nulls > 1)
+                                break;
+                        continue;
+                }
+                nulls = 0;
+                status = PQresultStatus(res);
+                if (status == PGRES_COMMAND_OK || status == PGRES_TUPLES_OK) {
+                        PQclear(C->res);
+                        C->res = res;
+                } else if (status != PGRES_PIPELINE_SYNC && status != PGRES_PIPELINE_ABORTED && ! error) {
+                        error = res;
+                } else {
+                        PQclear(res);
+                }
+        }
+        if (error) {
+                PQclear(C->res);
+                C->res = error;
+                C->lastError = PQresultStatus(error);
+                return false;
+        }
+        C->lastError = (status == PGRES_PIPELINE_SYNC) ? PGRES_COMMAND_OK : PGRES_FATAL_ERROR;
+        return (status == PGRES_PIPELINE_SYNC);
+}
+#endif
+
+
 static int _doConnect(T C, char **error) {
 #define ERROR(e) do {*error = Str_dup(e); goto error;} while (0)
         /* User */
@@ -132,6 +332,7 @@ static int _doConnect(T C, char **error) {
                 StringBuffer_append(C->sb, "connect_timeout=%d ", SQL_DEFAULT_TCP_TIMEOUT);
         if (URL_getParameter(C->url, "application-name"))
                 StringBuffer_append(C->sb, "application_name='%s' ", URL_getParameter(C->url, "application-name"));
+        C->resultFormat = IS(URL_getParameter(C->url, "binary-result"), "true") ? 1 : 0;
         /* Connect */
         C->db = PQconnectdb(StringBuffer_toString(C->sb));
         if (PQstatus(C->db) == CONNECTION_OK)
@@ -167,6 +368,8 @@ void PostgresqlConnection_free(T *C) {
 	assert(C && *C);
         if ((*C)->res)
                 PQclear((*C)->res);
+        if ((*C)->copyData)
+                PQfreemem((*C)->copyData);
         if ((*C)->db)
                 PQfinish((*C)->db);
         StringBuffer_free(&(*C)->sb);
@@ -189,15 +392,36 @@ void PostgresqlConnection_setMaxRows(T C, int max) {
 }
 
 
+void PostgresqlConnection_setDefaultRowPrefetch(T C, int prefetch_rows) {
+        assert(C);
+        C->fetchSize = prefetch_rows;
+}
+
+
 int PostgresqlConnection_ping(T C) {
         assert(C);
-        return (PQstatus(C->db) == CONNECTION_OK);
+        /* PQstatus only changes when libpq reads from the socket. An empty
+         query makes the round trip, so libpq reads the FATAL error and EOF 
+         a terminated backend left behind */
+        PGresult *res = PQexec(C->db, "");
+        int alive = (PQresultStatus(res) == PGRES_EMPTY_QUERY);
+        PQclear(res);
+        return alive && (PQstatus(C->db) == CONNECTION_OK);
+}
+
+
+int PostgresqlConnection_getSocket(T C) {
+        assert(C);
+        // A connection libpq already knows is bad has no usable socket
+        return (PQstatus(C->db) == CONNECTION_OK) ? PQsocket(C->db) : -1;
 }
 
 
 
 int PostgresqlConnection_beginTransaction(T C) {
 	assert(C);
+        if (_isPipelined(C))
+                return _send(C, "BEGIN TRANSACTION;");
         PGresult *res = PQexec(C->db, "BEGIN TRANSACTION;");
         C->lastError = PQresultStatus(res);
         PQclear(res);
@@ -207,6 +431,8 @@ int PostgresqlConnection_beginTransaction(T C) {
 
 int PostgresqlConnection_commit(T C) {
 	assert(C);
+        if (_isPipelined(C))
+                return _send(C, "COMMIT TRANSACTION;");
         PGresult *res = PQexec(C->db, "COMMIT TRANSACTION;");
         C->lastError = PQresultStatus(res);
         PQclear(res);
@@ -216,6 +442,8 @@ int PostgresqlConnection_commit(T C) {
 
 int PostgresqlConnection_rollback(T C) {
 	assert(C);
+        if (_isPipelined(C))
+                return _send(C, "ROLLBACK TRANSACTION;");
         PGresult *res = PQexec(C->db, "ROLLBACK TRANSACTION;");
         C->lastError = PQresultStatus(res);
         PQclear(res);
@@ -232,7 +460,7 @@ long long PostgresqlConnection_lastRowId(T C) {
 long long PostgresqlConnection_rowsChanged(T C) {
         assert(C);
         char *changes = PQcmdTuples(C->res);
-        return changes ? Str_parseLLong(changes) : 0;
+        return (changes && *changes) ? Str_parseLLong(changes) : 0;
 }
 
 
@@ -243,6 +471,8 @@ int PostgresqlConnection_execute(T C, const char *sql, va_list ap) {
         va_copy(ap_copy, ap);
         StringBuffer_vset(C->sb, sql, ap_copy);
         va_end(ap_copy);
+        if (_isPipelined(C))
+                return _send(C, StringBuffer_toString(C->sb));
         C->res = PQexec(C->db, StringBuffer_toString(C->sb));
         C->lastError = PQresultStatus(C->res);
         return (C->lastError == PGRES_COMMAND_OK);
@@ -256,11 +486,40 @@ ResultSet_T PostgresqlConnection_executeQuery(T C, const char *sql, va_list ap)
         va_copy(ap_copy, ap);
         StringBuffer_vset(C->sb, sql, ap_copy);
         va_end(ap_copy);
-        C->res = PQexec(C->db, StringBuffer_toString(C->sb));
-        C->lastError = PQresultStatus(C->res);
-        if (C->lastError == PGRES_TUPLES_OK)
-                return ResultSet_new(PostgresqlResultSet_new(C->res, C->maxRows), (Rop_T)&postgresqlrops);
-        return NULL;
+        return _query(C, NULL);
+}
+
+
+int PostgresqlConnection_executeParams(T C, const char *sql, int count, const Param_T *params) {
+        params_t p;
+        assert(C);
+        PQclear(C->res);
+        C->res = NULL;
+        StringBuffer_set(C->sb, "%s", sql);
+        StringBuffer_prepare4postgres(C->sb);
+        _bindParams(&p, count, params);
+        if (_isPipelined(C)) {
+                int sent = PQsendQueryParams(C->db, StringBuffer_toString(C->sb), p.count, NULL, (const char **)p.values, p.lengths, p.formats, 0);
+                C->lastError = sent ? PGRES_COMMAND_OK : PGRES_FATAL_ERROR;
+        } else {
+                C->res = PQexecParams(C->db, StringBuffer_toString(C->sb), p.count, NULL, (const char **)p.values, p.lengths, p.formats, 0);
+                C->lastError = C->res ? PQresultStatus(C->res) : PGRES_FATAL_ERROR;
+        }
+        _freeParams(&p);
+        return (C->lastError == PGRES_COMMAND_OK || C->lastError == PGRES_TUPLES_OK);
+}
+
+
+ResultSet_T PostgresqlConnection_executeQueryParams(T C, const char *sql, int count, const Param_T *params) {
+        params_t p;
+        assert(C);
+        PQclear(C->res);
+        StringBuffer_set(C->sb, "%s", sql);
+        StringBuffer_prepare4postgres(C->sb);
+        _bindParams(&p, count, params);
+        ResultSet_T r = _query(C, &p);
+        _freeParams(&p);
+        return r;
 }
 
 
@@ -280,17 +539,122 @@ PreparedStatement_T PostgresqlConnection_prepareStatement(T C, const char *sql,
         C->res = PQprepare(C->db, name, StringBuffer_toString(C->sb), 0, NULL);
         C->lastError = C->res ? PQresultStatus(C->res) : PGRES_FATAL_ERROR;
         if (C->lastError == PGRES_EMPTY_QUERY || C->lastError == PGRES_COMMAND_OK || C->lastError == PGRES_TUPLES_OK)
-		return PreparedStatement_new(PostgresqlPreparedStatement_new(C->db, C->maxRows, name, paramCount), (Pop_T)&postgresqlpops, paramCount);
+		return PreparedStatement_new(PostgresqlPreparedStatement_new(C->db, C->maxRows, C->fetchSize, C->resultFormat, name, paramCount), (Pop_T)&postgresqlpops, paramCount);
         return NULL;
 }
 
 
 const char *PostgresqlConnection_getLastError(T C) {
 	assert(C);
-        return C->res ? PQresultErrorMessage(C->res) : "unknown error";
+        return C->res ? PQresultErrorMessage(C->res) : PQerrorMessage(C->db);
+}
+
+
+int PostgresqlConnection_copyIn(T C, const char *sql, va_list ap) {
+        assert(C);
+        return _copy(C, sql, ap, PGRES_COPY_IN);
+}
+
+
+int PostgresqlConnection_putCopyData(T C, const void *data, int size) {
+        assert(C);
+        if (PQputCopyData(C->db, data, size) == 1)
+                return true;
+        PQclear(C->res);
+        C->res = NULL;
+        C->lastError = PGRES_FATAL_ERROR;
+        return false;
+}
+
+
+long long PostgresqlConnection_endCopyIn(T C, const char *error) {
+        assert(C);
+        if (PQputCopyEnd(C->db, error) != 1) {
+                PQclear(C->res);
+                C->res = NULL;
+                C->lastError = PGRES_FATAL_ERROR;
+                return -1;
+        }
+        return _endCopy(C) ? PostgresqlConnection_rowsChanged(C) : -1;
 }
 
 
+int PostgresqlConnection_copyOut(T C, const char *sql, va_list ap) {
+        assert(C);
+        return _copy(C, sql, ap, PGRES_COPY_OUT);
+}
+
+
+int PostgresqlConnection_getCopyData(T C, const void **data) {
+        assert(C);
+        if (C->copyData) {
+                PQfreemem(C->copyData);
+                C->copyData = NULL;
+        }
+        int size = PQgetCopyData(C->db, &C->copyData, 0);
+        if (size > 0) {
+                *data = C->copyData;
+                return size;
+        }
+        if (size == -1) // Done, the COPY result follows
+                return _endCopy(C) ? 0 : -1;
+        PQclear(C->res);
+        C->res = NULL;
+        C->lastError = PGRES_FATAL_ERROR;
+        return -1;
+}
+
+
+#ifdef LIBPQ_HAS_PIPELINING
+
+int PostgresqlConnection_beginPipeline(T C) {
+        assert(C);
+        PQclear(C->res);
+        C->res = NULL;
+        C->lastError = PQenterPipelineMode(C->db) ? PGRES_COMMAND_OK : PGRES_FATAL_ERROR;
+        return (C->lastError == PGRES_COMMAND_OK);
+}
+
+
+int PostgresqlConnection_syncPipeline(T C) {
+        assert(C);
+        if (! PQpipelineSync(C->db)) {
+                PQclear(C->res);
+                C->res = NULL;
+                C->lastError = PGRES_FATAL_ERROR;
+                return false;
+        }
+        if (_readPipeline(C))
+                return true;
+        /* A failed statement inside BEGIN leaves the transaction aborted, roll it back so the Connection is usable */
+        if (PQtransactionStatus(C->db) == PQTRANS_INERROR) {
+                PGresult *error = C->res;
+                C->res = NULL;
+                if (PQsendQueryParams(C->db, "ROLLBACK TRANSACTION;", 0, NULL, NULL, NULL, NULL, 0) && PQpipelineSync(C->db))
+                        _readPipeline(C);
+                PQclear(C->res);
+                C->res = error;
+                C->lastError = PQresultStatus(error);
+        }
+        return false;
+}
+
+
+int PostgresqlConnection_endPipeline(T C) {
+        assert(C);
+        int success = PostgresqlConnection_syncPipeline(C);
+        if (! PQexitPipelineMode(C->db) && success) {
+                PQclear(C->res);
+                C->res = NULL;
+                C->lastError = PGRES_FATAL_ERROR;
+                return false;
+        }
+        return success;
+}
+
+#endif
+
+
 #ifdef PACKAGE_PROTECTED
 #pragma GCC visibility pop
 #endif
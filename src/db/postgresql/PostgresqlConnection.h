@@ -28,7 +28,9 @@ T PostgresqlConnection_new(URL_T url, char **error);
 void PostgresqlConnection_free(T *C);
 void PostgresqlConnection_setQueryTimeout(T C, int ms);
 void PostgresqlConnection_setMaxRows(T C, int max);
+void PostgresqlConnection_setDefaultRowPrefetch(T C, int prefetch_rows);
 int PostgresqlConnection_ping(T C);
+int PostgresqlConnection_getSocket(T C);
 int PostgresqlConnection_beginTransaction(T C);
 int PostgresqlConnection_commit(T C);
 int PostgresqlConnection_rollback(T C);
@@ -36,8 +38,20 @@ long long PostgresqlConnection_lastRowId(T C);
 long long PostgresqlConnection_rowsChanged(T C);
 int PostgresqlConnection_execute(T C, const char *sql, va_list ap);
 ResultSet_T PostgresqlConnection_executeQuery(T C, const char *sql, va_list ap);
+int PostgresqlConnection_executeParams(T C, const char *sql, int count, const Param_T *params);
+ResultSet_T PostgresqlConnection_executeQueryParams(T C, const char *sql, int count, const Param_T *params);
 PreparedStatement_T PostgresqlConnection_prepareStatement(T C, const char *sql, va_list ap);
 const char *PostgresqlConnection_getLastError(T C);
+int PostgresqlConnection_copyIn(T C, const char *sql, va_list ap);
+int PostgresqlConnection_putCopyData(T C, const void *data, int size);
+long long PostgresqlConnection_endCopyIn(T C, const char *error);
+int PostgresqlConnection_copyOut(T C, const char *sql, va_list ap);
+int PostgresqlConnection_getCopyData(T C, const void **data);
+#ifdef LIBPQ_HAS_PIPELINING
+int PostgresqlConnection_beginPipeline(T C);
+int PostgresqlConnection_syncPipeline(T C);
+int PostgresqlConnection_endPipeline(T C);
+#endif
 #undef T
 #endif
 
@@ -27,19 +27,31 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <stdint.h>
 #include <libpq-fe.h>
 
 #include "system/Time.h"
 #include "ResultSet.h"
 #include "PostgresqlResultSet.h"
-#include "PreparedStatementDelegate.h"
+#include "PreparedStatement.h"
 #include "PostgresqlPreparedStatement.h"
 
 
 /**
  * Implementation of the PreparedStatement/Delegate interface for postgresql.
- * All parameter values are sent as text except for blobs. Postgres ignore
- * paramLengths for text parameters and it is therefor set to 0, except for blob.
+ * Parameter types of a statement kept in the Connection's statement cache
+ * are described by the server when the first number or timestamp is bound.
+ * The extra round trip is then paid once for many executions, other 
+ * statements send all values as text. In a described statement, numbers
+ * and timestamps bound to integer, float and timestamp parameters are sent
+ * in binary format, everything else is sent as text except for blobs. Postgres ignore paramLengths for text parameters and 
+ * it is therefor set to 0, except for binary values.
+ * A batch is sent in pipeline mode when libpq supports it, so the rows are 
+ * executed without waiting for the result of each row. If the Connection
+ * is in pipeline mode, execute only sends the statement and the result is
+ * read by the Connection when the pipeline is synced.
+ * If a fetch size is set, executeQuery streams the result instead of 
+ * reading all rows into memory, see PostgresqlResultSet.
  *
  * @file
  */
@@ -59,20 +71,44 @@ const struct Pop_T postgresqlpops = {
         .setBlob        = PostgresqlPreparedStatement_setBlob,
         .execute        = PostgresqlPreparedStatement_execute,
         .executeQuery   = PostgresqlPreparedStatement_executeQuery,
-        .rowsChanged    = PostgresqlPreparedStatement_rowsChanged
+        .rowsChanged    = PostgresqlPreparedStatement_rowsChanged,
+        .setFetchSize   = PostgresqlPreparedStatement_setFetchSize,
+        .executeBatch   = PostgresqlPreparedStatement_executeBatch,
+        .setCached      = PostgresqlPreparedStatement_setCached
 };
 
+/* Number of rows sent in a pipeline before reading their results. Keeps the
+ results small enough to not fill the socket buffers while we are sending */
+#define PIPELINE_ROWS 256
+
+/* Type oids from the server's catalog/pg_type.h */
+#define INT8OID         20
+#define INT2OID         21
+#define INT4OID         23
+#define FLOAT4OID       700
+#define FLOAT8OID       701
+#define TIMESTAMPOID    1114
+#define TIMESTAMPTZOID  1184
+
+/* Seconds between the Unix epoch and the Postgres epoch, 2000-01-01 */
+#define POSTGRES_EPOCH  946684800LL
+
 typedef struct param_t {
         char s[65];
 } *param_t;
 #define T PreparedStatementDelegate_T
 struct T {
         int maxRows;
+        int fetchSize;
+        int resultFormat;
         int lastError;
         char *stmt;
         PGconn *db;
         PGresult *res;
         int paramCount;
+        int cached;
+        int described;
+        Oid *paramTypes; // Described by the server, 0 if unknown
         char **paramValues; 
         int *paramLengths; 
         int *paramFormats;
@@ -81,6 +117,226 @@ struct T {
 
 extern const struct Rop_T postgresqlrops;
 
+/* Parameters of one batch row in the form PQexecPrepared wants them */
+typedef struct batch_t {
+        char **values;
+        int *lengths;
+        int *formats;
+        param_t params;
+} batch_t;
+
+
+/* ------------------------------------------------------- Private methods */
+
+
+static inline void _put16(char *p, uint16_t x) {
+        p[0] = (char)(x >> 8);
+        p[1] = (char)x;
+}
+
+
+static inline void _put32(char *p, uint32_t x) {
+        _put16(p, (uint16_t)(x >> 16));
+        _put16(p + 2, (uint16_t)x);
+}
+
+
+static inline void _put64(char *p, uint64_t x) {
+        _put32(p, (uint32_t)(x >> 32));
+        _put32(p + 4, (uint32_t)x);
+}
+
+
+/* Bind a double in binary format to a float parameter, otherwise as text */
+static void _setDouble(Oid type, double x, param_t p, char **value, int *length, int *format) {
+        *value = p->s;
+        *format = 1;
+        if (type == FLOAT8OID) {
+                uint64_t n;
+                memcpy(&n, &x, sizeof(n));
+                _put64(p->s, n);
+                *length = 8;
+        } else if (type == FLOAT4OID) {
+                uint32_t n;
+                float f = (float)x;
+                memcpy(&n, &f, sizeof(n));
+                _put32(p->s, n);
+                *length = 4;
+        } else {
+                snprintf(p->s, 64, "%lf", x);
+                *length = 0;
+                *format = 0;
+        }
+}
+
+
+/* Bind an integer in binary format to an integer parameter if the value 
+ fits or to a float parameter, otherwise as text which the server checks */
+static void _setInteger(Oid type, long long x, param_t p, char **value, int *length, int *format) {
+        *value = p->s;
+        *format = 1;
+        if (type == INT8OID) {
+                _put64(p->s, (uint64_t)x);
+                *length = 8;
+        } else if (type == INT4OID && x >= INT32_MIN && x <= INT32_MAX) {
+                _put32(p->s, (uint32_t)(int32_t)x);
+                *length = 4;
+        } else if (type == INT2OID && x >= INT16_MIN && x <= INT16_MAX) {
+                _put16(p->s, (uint16_t)(int16_t)x);
+                *length = 2;
+        } else if (type == FLOAT8OID || type == FLOAT4OID) {
+                _setDouble(type, (double)x, p, value, length, format);
+        } else {
+                snprintf(p->s, 64, "%lld", x);
+                *length = 0;
+                *format = 0;
+        }
+}
+
+
+/* Bind a timestamp in binary format, microseconds since the Postgres epoch, 
+ to a timestamp parameter, otherwise as text */
+static void _setTimestamp(Oid type, time_t x, param_t p, char **value, int *length, int *format) {
+        if (type == TIMESTAMPTZOID || type == TIMESTAMPOID) {
+                _put64(p->s, (uint64_t)(((int64_t)x - POSTGRES_EPOCH) * 1000000));
+                *value = p->s;
+                *length = 8;
+                *format = 1;
+        } else {
+                *value = Time_toString(x, p->s);
+                *length = 0;
+                *format = 0;
+        }
+}
+
+
+static inline int _isPipelined(T P) {
+#ifdef LIBPQ_HAS_PIPELINING
+        return PQpipelineStatus(P->db) != PQ_PIPELINE_OFF;
+#else
+        return false;
+#endif
+}
+
+
+/* Ask the server for the parameter types of a cached statement, once and only
+ when a number or a timestamp is bound. Not possible in pipeline mode, values
+ are then sent as text */
+static void _describe(T P) {
+        if (P->described || ! P->cached || _isPipelined(P))
+                return;
+        P->described = true;
+        PGresult *res = PQdescribePrepared(P->db, P->stmt);
+        if (PQresultStatus(res) == PGRES_COMMAND_OK) {
+                for (int i = 0; i < P->paramCount && i < PQnparams(res); i++)
+                        P->paramTypes[i] = PQparamtype(res, i);
+        }
+        PQclear(res);
+}
+
+
+static inline Oid _paramType(T P, int i) {
+        _describe(P);
+        return P->paramTypes[i];
+}
+
+
+static void _bindRow(T P, batch_t *b, const Param_T *row) {
+        for (int i = 0; i < P->paramCount; i++) {
+                b->lengths[i] = 0;
+                b->formats[i] = 0;
+                switch (row[i].type) {
+                        case PARAM_NULL:
+                                b->values[i] = NULL;
+                                break;
+                        case PARAM_STRING:
+                                b->values[i] = (char *)row[i].value.data;
+                                break;
+                        case PARAM_INT:
+                        case PARAM_LLONG:
+                                _setInteger(_paramType(P, i), row[i].value.integer, &b->params[i], &b->values[i], &b->lengths[i], &b->formats[i]);
+                                break;
+                        case PARAM_DOUBLE:
+                                _setDouble(_paramType(P, i), row[i].value.real, &b->params[i], &b->values[i], &b->lengths[i], &b->formats[i]);
+                                break;
+                        case PARAM_TIMESTAMP:
+                                _setTimestamp(_paramType(P, i), (time_t)row[i].value.integer, &b->params[i], &b->values[i], &b->lengths[i], &b->formats[i]);
+                                break;
+                        case PARAM_BLOB:
+                                b->values[i] = (char *)row[i].value.data;
+                                b->lengths[i] = row[i].size;
+                                b->formats[i] = 1;
+                                break;
+                }
+        }
+}
+
+
+static inline long long _changes(PGresult *res) {
+        char *changes = PQcmdTuples(res);
+        return (changes && *changes) ? Str_parseLLong(changes) : 0;
+}
+
+
+/* Execute the rows one at a time. Used if libpq cannot pipeline */
+static void _executeRows(T P, batch_t *b, const Param_T *rows, int count, long long *counts, char error[STRLEN]) {
+        for (int r = 0; r < count; r++) {
+                _bindRow(P, b, rows + (r * P->paramCount));
+                PQclear(P->res);
+                P->res = PQexecPrepared(P->db, P->stmt, P->paramCount, (const char **)b->values, b->lengths, b->formats, 0);
+                P->lastError = P->res ? PQresultStatus(P->res) : PGRES_FATAL_ERROR;
+                if (P->lastError != PGRES_COMMAND_OK && P->lastError != PGRES_TUPLES_OK) {
+                        snprintf(error, STRLEN, "%s", P->res ? PQresultErrorMessage(P->res) : PQerrorMessage(P->db));
+                        return;
+                }
+                counts[r] = _changes(P->res);
+        }
+}
+
+
+#ifdef LIBPQ_HAS_PIPELINING
+/* Send the rows in chunks of PIPELINE_ROWS, each chunk terminated by a sync
+ point. If a row fails, the server skips the rest of its chunk and we stop */
+static void _executePipeline(T P, batch_t *b, const Param_T *rows, int count, long long *counts, char error[STRLEN]) {
+        for (int start = 0; start < count && ! *error; start += PIPELINE_ROWS) {
+                int sent = 0, n = (count - start) < PIPELINE_ROWS ? (count - start) : PIPELINE_ROWS;
+                for (; sent < n; sent++) {
+                        _bindRow(P, b, rows + ((start + sent) * P->paramCount));
+                        if (! PQsendQueryPrepared(P->db, P->stmt, P->paramCount, (const char **)b->values, b->lengths, b->formats, 0))
+                                break;
+                }
+                if (sent < n || ! PQpipelineSync(P->db)) {
+                        snprintf(error, STRLEN, "%s", PQerrorMessage(P->db));
+                        return;
+                }
+                for (int r = 0; r < sent; r++) {
+                        PGresult *res = PQgetResult(P->db);
+                        if (! res) {
+                                snprintf(error, STRLEN, "%s", PQerrorMessage(P->db));
+                                return;
+                        }
+                        P->lastError = PQresultStatus(res);
+                        if (P->lastError == PGRES_COMMAND_OK || P->lastError == PGRES_TUPLES_OK)
+                                counts[start + r] = _changes(res);
+                        else if (P->lastError != PGRES_PIPELINE_ABORTED && ! *error)
+                                snprintf(error, STRLEN, "%s", PQresultErrorMessage(res));
+                        PQclear(res);
+                        /* Each row's results are terminated by NULL */
+                        while ((res = PQgetResult(P->db)))
+                                PQclear(res);
+                }
+                PGresult *sync = PQgetResult(P->db);
+                if (! sync || PQresultStatus(sync) != PGRES_PIPELINE_SYNC) {
+                        if (! *error)
+                                snprintf(error, STRLEN, "%s", sync ? PQresultErrorMessage(sync) : PQerrorMessage(P->db));
+                        PQclear(sync);
+                        return;
+                }
+                PQclear(sync);
+        }
+}
+#endif
+
 
 /* ----------------------------------------------------- Protected methods */
 
@@ -89,7 +345,7 @@ extern const struct Rop_T postgresqlrops;
 #pragma GCC visibility push(hidden)
 #endif
 
-T PostgresqlPreparedStatement_new(PGconn *db, int maxRows, char *stmt, int paramCount) {
+T PostgresqlPreparedStatement_new(PGconn *db, int maxRows, int fetchSize, int resultFormat, char *stmt, int paramCount) {
         T P;
         assert(db);
         assert(stmt);
@@ -97,9 +353,12 @@ T PostgresqlPreparedStatement_new(PGconn *db, int maxRows, char *stmt, int param
         P->db = db;
         P->stmt = stmt;
         P->maxRows = maxRows;
+        P->fetchSize = fetchSize;
+        P->resultFormat = resultFormat;
         P->paramCount = paramCount;
         P->lastError = PGRES_COMMAND_OK;
         if (P->paramCount) {
+                P->paramTypes = CALLOC(P->paramCount, sizeof(Oid));
                 P->paramValues = CALLOC(P->paramCount, sizeof(char *));
                 P->paramLengths = CALLOC(P->paramCount, sizeof(int));
                 P->paramFormats = CALLOC(P->paramCount, sizeof(int));
@@ -121,6 +380,7 @@ void PostgresqlPreparedStatement_free(T *P) {
         PQclear((*P)->res);
 	FREE((*P)->stmt);
         if ((*P)->paramCount) {
+	        FREE((*P)->paramTypes);
 	        FREE((*P)->paramValues);
 	        FREE((*P)->paramLengths);
 	        FREE((*P)->paramFormats);
@@ -142,39 +402,28 @@ void PostgresqlPreparedStatement_setString(T P, int parameterIndex, const char *
 void PostgresqlPreparedStatement_setInt(T P, int parameterIndex, int x) {
         assert(P);
         int i = checkAndSetParameterIndex(parameterIndex, P->paramCount);
-        snprintf(P->params[i].s, 64, "%d", x);
-        P->paramValues[i] =  P->params[i].s;
-        P->paramLengths[i] = 0;
-        P->paramFormats[i] = 0;
+        _setInteger(_paramType(P, i), x, &P->params[i], &P->paramValues[i], &P->paramLengths[i], &P->paramFormats[i]);
 }
 
 
 void PostgresqlPreparedStatement_setLLong(T P, int parameterIndex, long long x) {
         assert(P);
         int i = checkAndSetParameterIndex(parameterIndex, P->paramCount);
-        snprintf(P->params[i].s, 64, "%lld", x);
-        P->paramValues[i] =  P->params[i].s;
-        P->paramLengths[i] = 0; 
-        P->paramFormats[i] = 0;
+        _setInteger(_paramType(P, i), x, &P->params[i], &P->paramValues[i], &P->paramLengths[i], &P->paramFormats[i]);
 }
 
 
 void PostgresqlPreparedStatement_setDouble(T P, int parameterIndex, double x) {
         assert(P);
         int i = checkAndSetParameterIndex(parameterIndex, P->paramCount);
-        snprintf(P->params[i].s, 64, "%lf", x);
-        P->paramValues[i] =  P->params[i].s;
-        P->paramLengths[i] = 0;
-        P->paramFormats[i] = 0;
+        _setDouble(_paramType(P, i), x, &P->params[i], &P->paramValues[i], &P->paramLengths[i], &P->paramFormats[i]);
 }
 
 
 void PostgresqlPreparedStatement_setTimestamp(T P, int parameterIndex, time_t x) {
         assert(P);
         int i = checkAndSetParameterIndex(parameterIndex, P->paramCount);
-        P->paramValues[i] = Time_toString(x, P->params[i].s);
-        P->paramLengths[i] = 0;
-        P->paramFormats[i] = 0;
+        _setTimestamp(_paramType(P, i), x, &P->params[i], &P->paramValues[i], &P->paramLengths[i], &P->paramFormats[i]);
 }
 
 
@@ -190,6 +439,12 @@ void PostgresqlPreparedStatement_setBlob(T P, int parameterIndex, const void *x,
 void PostgresqlPreparedStatement_execute(T P) {
         assert(P);
         PQclear(P->res);
+        if (_isPipelined(P)) {
+                P->res = NULL;
+                if (! PQsendQueryPrepared(P->db, P->stmt, P->paramCount, (const char **)P->paramValues, P->paramLengths, P->paramFormats, 0))
+                        THROW(SQLException, "%s", PQerrorMessage(P->db));
+                return;
+        }
         P->res = PQexecPrepared(P->db, P->stmt, P->paramCount, (const char **)P->paramValues, P->paramLengths, P->paramFormats, 0);
         P->lastError = P->res ? PQresultStatus(P->res) : PGRES_FATAL_ERROR;
         if (P->lastError != PGRES_COMMAND_OK)
@@ -199,8 +454,21 @@ void PostgresqlPreparedStatement_execute(T P) {
 
 ResultSet_T PostgresqlPreparedStatement_executeQuery(T P) {
         assert(P);
+        if (_isPipelined(P))
+                THROW(SQLException, "PreparedStatement_executeQuery() cannot be used in pipeline mode");
         PQclear(P->res);
-        P->res = PQexecPrepared(P->db, P->stmt, P->paramCount, (const char **)P->paramValues, P->paramLengths, P->paramFormats, 0);
+        if (P->fetchSize > 0) {
+                P->res = NULL;
+                int cancel = (PQtransactionStatus(P->db) == PQTRANS_IDLE);
+                if (! PQsendQueryPrepared(P->db, P->stmt, P->paramCount, (const char **)P->paramValues, P->paramLengths, P->paramFormats, P->resultFormat))
+                        THROW(SQLException, "%s", PQerrorMessage(P->db));
+                ResultSetDelegate_T R = PostgresqlResultSet_stream(P->db, P->maxRows, P->fetchSize, cancel, (void **)&P->res);
+                if (R)
+                        return ResultSet_new(R, (Rop_T)&postgresqlrops);
+                P->lastError = P->res ? PQresultStatus(P->res) : PGRES_FATAL_ERROR;
+                THROW(SQLException, "%s", P->res ? PQresultErrorMessage(P->res) : PQerrorMessage(P->db));
+        }
+        P->res = PQexecPrepared(P->db, P->stmt, P->paramCount, (const char **)P->paramValues, P->paramLengths, P->paramFormats, P->resultFormat);
         P->lastError = P->res ? PQresultStatus(P->res) : PGRES_FATAL_ERROR;
         if (P->lastError == PGRES_TUPLES_OK)
                 return ResultSet_new(PostgresqlResultSet_new(P->res, P->maxRows), (Rop_T)&postgresqlrops);
@@ -211,8 +479,69 @@ ResultSet_T PostgresqlPreparedStatement_executeQuery(T P) {
 
 long long PostgresqlPreparedStatement_rowsChanged(T P) {
         assert(P);
-        char *changes = PQcmdTuples(P->res);
-        return changes ? Str_parseLLong(changes) : 0;
+        return _changes(P->res);
+}
+
+
+void PostgresqlPreparedStatement_setFetchSize(T P, int prefetch_rows) {
+        assert(P);
+        P->fetchSize = prefetch_rows;
+}
+
+
+void PostgresqlPreparedStatement_setCached(T P) {
+        assert(P);
+        P->cached = true;
+}
+
+
+int PostgresqlPreparedStatement_executeBatch(T P, const Param_T *rows, int count, long long *counts) {
+        assert(P);
+        char error[STRLEN] = {};
+        batch_t b = {};
+        if (P->paramCount) {
+                b.values = CALLOC(P->paramCount, sizeof(char *));
+                b.lengths = CALLOC(P->paramCount, sizeof(int));
+                b.formats = CALLOC(P->paramCount, sizeof(int));
+                b.params = CALLOC(P->paramCount, sizeof(struct param_t));
+                /* Describe before the rows are sent, the types cannot be asked for in pipeline mode */
+                for (int i = 0; P->cached && i < count * P->paramCount && ! P->described; i++)
+                        if (rows[i].type != PARAM_NULL && rows[i].type != PARAM_STRING && rows[i].type != PARAM_BLOB)
+                                _describe(P);
+        }
+#ifdef LIBPQ_HAS_PIPELINING
+        if (_isPipelined(P)) {
+                /* Part of the Connection's pipeline, the results are read when it is synced */
+                for (int r = 0; r < count; r++) {
+                        _bindRow(P, &b, rows + (r * P->paramCount));
+                        if (! PQsendQueryPrepared(P->db, P->stmt, P->paramCount, (const char **)b.values, b.lengths, b.formats, 0)) {
+                                snprintf(error, STRLEN, "%s", PQerrorMessage(P->db));
+                                break;
+                        }
+                        counts[r] = BATCH_SUCCESS_NO_INFO;
+                }
+        } else if (PQenterPipelineMode(P->db)) {
+                _executePipeline(P, &b, rows, count, counts, error);
+                if (! PQexitPipelineMode(P->db)) {
+                        /* Drain what is left, e.g. after a send error, so the connection is usable again */
+                        PGresult *res;
+                        while ((res = PQgetResult(P->db)) && PQresultStatus(res) != PGRES_PIPELINE_SYNC)
+                                PQclear(res);
+                        PQclear(res);
+                        PQexitPipelineMode(P->db);
+                }
+        } else
+#endif
+        _executeRows(P, &b, rows, count, counts, error);
+        if (P->paramCount) {
+                FREE(b.values);
+                FREE(b.lengths);
+                FREE(b.formats);
+                FREE(b.params);
+        }
+        if (*error)
+                THROW(SQLException, "%s", error);
+        return true;
 }
 
 
@@ -24,7 +24,7 @@
 #ifndef POSTGRESQLPREPAREDSTATEMENT_INCLUDED
 #define POSTGRESQLPREPAREDSTATEMENT_INCLUDED
 #define T PreparedStatementDelegate_T
-T PostgresqlPreparedStatement_new(PGconn *db, int maxRows, char *stmt, int paramCount);
+T PostgresqlPreparedStatement_new(PGconn *db, int maxRows, int fetchSize, int resultFormat, char *stmt, int paramCount);
 void PostgresqlPreparedStatement_free(T *P);
 void PostgresqlPreparedStatement_setString(T P, int parameterIndex, const char *x);
 void PostgresqlPreparedStatement_setInt(T P, int parameterIndex, int x);
@@ -35,5 +35,8 @@ void PostgresqlPreparedStatement_setBlob(T P, int parameterIndex, const void *x,
 void PostgresqlPreparedStatement_execute(T P);
 ResultSet_T PostgresqlPreparedStatement_executeQuery(T P);
 long long PostgresqlPreparedStatement_rowsChanged(T P);
+void PostgresqlPreparedStatement_setFetchSize(T P, int prefetch_rows);
+int PostgresqlPreparedStatement_executeBatch(T P, const Param_T *rows, int count, long long *counts);
+void PostgresqlPreparedStatement_setCached(T P);
 #undef T
 #endif
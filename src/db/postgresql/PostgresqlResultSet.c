@@ -28,16 +28,26 @@
 #include <stdio.h>
 #include <string.h>
 #include <ctype.h>
+#include <stdint.h>
 #include <sys/types.h>
 #include <libpq-fe.h>
 
+#include "system/Time.h"
 #include "ResultSetDelegate.h"
 #include "PostgresqlResultSet.h"
 
 
 /**
  * Implementation of the ResultSet/Delegate interface for postgresql. 
- * Accessing columns with index outside range throws SQLException
+ * Accessing columns with index outside range throws SQLException. 
+ * A streaming ResultSet reads rows from the server as next() is called, 
+ * one row at a time in single row mode, or fetch size rows at a time in 
+ * chunked mode when libpq supports it. It owns its results and must be 
+ * read or freed before the Connection can send another statement.
+ * 
+ * Results in binary format are decoded directly from network byte order 
+ * for the common types and getString converts them to the text Postgres 
+ * would have sent. Columns of other types cannot be read in binary format.
  *
  * @file
  */
@@ -55,16 +65,59 @@ const struct Rop_T postgresqlrops = {
         .next           = PostgresqlResultSet_next,
         .isnull         = PostgresqlResultSet_isnull,
         .getString      = PostgresqlResultSet_getString,
-        .getBlob        = PostgresqlResultSet_getBlob
-        // getTimestamp and getDateTime is handled in ResultSet
+        .getInt         = PostgresqlResultSet_getInt,
+        .getLLong       = PostgresqlResultSet_getLLong,
+        .getDouble      = PostgresqlResultSet_getDouble,
+        .getBlob        = PostgresqlResultSet_getBlob,
+        .getTimestamp   = PostgresqlResultSet_getTimestamp
+        // getDateTime is handled in ResultSet
 };
 
+/* Type oids from the server's catalog/pg_type.h */
+#define BOOLOID         16
+#define BYTEAOID        17
+#define CHAROID         18
+#define NAMEOID         19
+#define INT8OID         20
+#define INT2OID         21
+#define INT4OID         23
+#define TEXTOID         25
+#define OIDOID          26
+#define JSONOID         114
+#define XMLOID          142
+#define FLOAT4OID       700
+#define FLOAT8OID       701
+#define BPCHAROID       1042
+#define VARCHAROID      1043
+#define DATEOID         1082
+#define TIMEOID         1083
+#define TIMESTAMPOID    1114
+#define TIMESTAMPTZOID  1184
+#define NUMERICOID      1700
+#define UUIDOID         2950
+#define JSONBOID        3802
+
+/* Seconds between the Unix epoch and the Postgres epoch, 2000-01-01 */
+#define POSTGRES_EPOCH  946684800LL
+
+typedef struct column_t {
+        Oid type;
+        int size;
+        char *text; // Text conversion of a binary value
+} *column_t;
+
 #define T ResultSetDelegate_T
 struct T {
         int maxRows;
         int currentRow;
         int columnCount;
         int rowCount;
+        int rows;       // Number of rows returned by next()
+        int stream;     // true if res is owned and fetched from db
+        int cancel;     // true if an unfinished stream can be canceled
+        int binary;     // true if the result is in binary format
+        column_t columns;
+        PGconn *db;     // Not NULL while a stream has more results
         PGresult *res;
 };
 
@@ -132,6 +185,239 @@ static inline const void *_unescape_bytea(uchar_t *s, int len, int *r) {
 }
 
 
+static inline int _isRow(PGresult *res) {
+        ExecStatusType status = PQresultStatus(res);
+#ifdef LIBPQ_HAS_CHUNK_MODE
+        if (status == PGRES_TUPLES_CHUNK)
+                return true;
+#endif
+        return (status == PGRES_SINGLE_TUPLE);
+}
+
+
+static inline uint16_t _uint16(const uchar_t *p) {
+        return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+
+static inline uint32_t _uint32(const uchar_t *p) {
+        return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+
+static inline uint64_t _uint64(const uchar_t *p) {
+        return ((uint64_t)_uint32(p) << 32) | _uint32(p + 4);
+}
+
+
+static void _setColumns(T R) {
+        R->binary = (R->columnCount > 0 && PQfformat(R->res, 0) == 1);
+        if (R->binary) {
+                R->columns = CALLOC(R->columnCount, sizeof(struct column_t));
+                for (int i = 0; i < R->columnCount; i++)
+                        R->columns[i].type = PQftype(R->res, i);
+        }
+}
+
+
+/* Returns the text buffer of column i with room for at least size bytes */
+static char *_text(T R, int i, int size) {
+        column_t c = &R->columns[i];
+        if (size > c->size) {
+                if (c->text)
+                        RESIZE(c->text, size);
+                else
+                        c->text = ALLOC(size);
+                c->size = size;
+        }
+        return c->text;
+}
+
+
+/* Microseconds since the Postgres epoch to a Unix timestamp */
+static inline time_t _toTimestamp(int64_t usec) {
+        int64_t seconds = usec / 1000000;
+        if (usec % 1000000 < 0)
+                seconds--;
+        return (time_t)(POSTGRES_EPOCH + seconds);
+}
+
+
+static const char *_formatTimestamp(T R, int i, int64_t usec, int date, int zone) {
+        char *s = _text(R, i, 64);
+        if (usec == INT64_MAX || usec == INT64_MIN) {
+                snprintf(s, 64, "%sinfinity", usec == INT64_MIN ? "-" : "");
+                return s;
+        }
+        struct tm tm;
+        time_t t = _toTimestamp(usec);
+        int fraction = (int)(usec - ((int64_t)(t - POSTGRES_EPOCH) * 1000000));
+        gmtime_r(&t, &tm);
+        int n = 0;
+        if (date)
+                n = snprintf(s, 64, "%04d-%02d-%02d", tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday);
+        if (date < 2) {
+                n += snprintf(s + n, 64 - n, "%s%02d:%02d:%02d", date ? " " : "", tm.tm_hour, tm.tm_min, tm.tm_sec);
+                if (fraction)
+                        n += snprintf(s + n, 64 - n, ".%06d", fraction);
+                if (zone)
+                        snprintf(s + n, 64 - n, "+00");
+        }
+        return s;
+}
+
+
+/* Binary numeric is a sign, a weight and base 10000 digits */
+static const char *_formatNumeric(T R, int i, const uchar_t *v) {
+        int ndigits = (int16_t)_uint16(v);
+        int weight = (int16_t)_uint16(v + 2);
+        int sign = _uint16(v + 4);
+        int dscale = _uint16(v + 6);
+        const uchar_t *digits = v + 8;
+        char *s = _text(R, i, (weight >= 0 ? (weight + 1) * 4 : 1) + dscale + 8);
+        if (sign == 0xC000)
+                return strcpy(s, "NaN");
+        if (sign == 0xD000 || sign == 0xF000)
+                return strcpy(s, sign == 0xF000 ? "-Infinity" : "Infinity");
+        char *p = s;
+        if (sign == 0x4000)
+                *p++ = '-';
+        if (weight < 0)
+                *p++ = '0';
+        for (int d = 0; d <= weight; d++) {
+                int digit = d < ndigits ? _uint16(digits + 2 * d) : 0;
+                p += sprintf(p, d ? "%04d" : "%d", digit);
+        }
+        if (dscale > 0) {
+                *p++ = '.';
+                for (int d = weight + 1, scale = 0; scale < dscale; d++) {
+                        char group[8];
+                        snprintf(group, sizeof(group), "%04d", (d >= 0 && d < ndigits) ? _uint16(digits + 2 * d) : 0);
+                        for (int j = 0; j < 4 && scale < dscale; j++, scale++)
+                                *p++ = group[j];
+                }
+        }
+        *p = 0;
+        return s;
+}
+
+
+/* Returns the text representation of a binary value */
+static const char *_toString(T R, int i) {
+        const uchar_t *v = (const uchar_t *)PQgetvalue(R->res, R->currentRow, i);
+        char *s;
+        switch (R->columns[i].type) {
+                case BOOLOID:
+                        return *v ? "t" : "f";
+                case INT2OID:
+                        s = _text(R, i, 8);
+                        snprintf(s, 8, "%d", (int16_t)_uint16(v));
+                        return s;
+                case INT4OID:
+                        s = _text(R, i, 16);
+                        snprintf(s, 16, "%d", (int32_t)_uint32(v));
+                        return s;
+                case OIDOID:
+                        s = _text(R, i, 16);
+                        snprintf(s, 16, "%u", _uint32(v));
+                        return s;
+                case INT8OID:
+                        s = _text(R, i, 24);
+                        snprintf(s, 24, "%lld", (long long)(int64_t)_uint64(v));
+                        return s;
+                case FLOAT4OID:
+                case FLOAT8OID:
+                        s = _text(R, i, 32);
+                        snprintf(s, 32, "%.17g", PostgresqlResultSet_getDouble(R, i + 1));
+                        return s;
+                case NUMERICOID:
+                        return _formatNumeric(R, i, v);
+                case DATEOID:
+                {
+                        int32_t days = (int32_t)_uint32(v);
+                        int64_t usec = (days == INT32_MAX) ? INT64_MAX : (days == INT32_MIN) ? INT64_MIN : (int64_t)days * 86400 * 1000000;
+                        return _formatTimestamp(R, i, usec, 2, false);
+                }
+                case TIMEOID:
+                        return _formatTimestamp(R, i, (int64_t)_uint64(v), 0, false);
+                case TIMESTAMPOID:
+                        return _formatTimestamp(R, i, (int64_t)_uint64(v), 1, false);
+                case TIMESTAMPTZOID:
+                        return _formatTimestamp(R, i, (int64_t)_uint64(v), 1, true);
+                case UUIDOID:
+                        s = _text(R, i, 40);
+                        for (int j = 0, n = 0; j < 16; j++)
+                                n += sprintf(s + n, (j == 4 || j == 6 || j == 8 || j == 10) ? "-%02x" : "%02x", v[j]);
+                        return s;
+                case JSONBOID:
+                        return (const char *)v + 1; // Skip the jsonb version byte
+                case BYTEAOID:
+                {
+                        // The hex format of a text result, raw bytes may contain NUL
+                        static const char hex[] = "0123456789abcdef";
+                        int length = PQgetlength(R->res, R->currentRow, i);
+                        s = _text(R, i, 2 * length + 3);
+                        s[0] = '\\';
+                        s[1] = 'x';
+                        for (int j = 0; j < length; j++) {
+                                s[2 + 2 * j] = hex[v[j] >> 4];
+                                s[3 + 2 * j] = hex[v[j] & 0x0f];
+                        }
+                        s[2 + 2 * length] = 0;
+                        return s;
+                }
+                case CHAROID:
+                case NAMEOID:
+                case TEXTOID:
+                case JSONOID:
+                case XMLOID:
+                case BPCHAROID:
+                case VARCHAROID:
+                        return (const char *)v; // Same as text, libpq NUL terminates all values
+        }
+        THROW(SQLException, "Column %d of type oid %u cannot be read in binary format -- cast it to text", i + 1, R->columns[i].type);
+        return NULL;
+}
+
+
+/* Read results until the query has ended so the connection can be reused */
+static void _drain(PGconn *db) {
+        PGresult *res;
+        while ((res = PQgetResult(db)))
+                PQclear(res);
+}
+
+
+/* Read the next result of a stream. The last result of a stream has no 
+ rows and is kept so column names can still be read */
+static int _fetch(T R) {
+        PGresult *res = PQgetResult(R->db);
+        if (! res) {
+                R->db = NULL;
+                return false;
+        }
+        if (_isRow(res) || PQresultStatus(res) == PGRES_TUPLES_OK) {
+                PQclear(R->res);
+                R->res = res;
+                R->currentRow = 0;
+                R->rowCount = PQntuples(res);
+                if (R->rowCount > 0)
+                        return true;
+                _drain(R->db);
+                R->db = NULL;
+                return false;
+        }
+        char error[STRLEN];
+        snprintf(error, STRLEN, "%s", PQresultErrorMessage(res));
+        PQclear(res);
+        _drain(R->db);
+        R->db = NULL;
+        R->rowCount = 0;
+        THROW(SQLException, "%s", error);
+        return false;
+}
+
+
 /* ----------------------------------------------------- Protected methods */
 
 
@@ -148,12 +434,66 @@ T PostgresqlResultSet_new(void *res, int maxRows) {
         R->currentRow = -1;
         R->columnCount = PQnfields(R->res);
         R->rowCount = PQntuples(R->res);
+        _setColumns(R);
+        return R;
+}
+
+
+T PostgresqlResultSet_stream(void *db, int maxRows, int fetchSize, int cancel, void **error) {
+        T R;
+        assert(db);
+        assert(error);
+#ifdef LIBPQ_HAS_CHUNK_MODE
+        if (fetchSize > 1)
+                PQsetChunkedRowsMode(db, fetchSize);
+        else
+#endif
+                PQsetSingleRowMode(db);
+        PGresult *res = PQgetResult(db);
+        if (! res || ! (_isRow(res) || PQresultStatus(res) == PGRES_TUPLES_OK)) {
+                _drain(db);
+                *error = res;
+                return NULL;
+        }
+        NEW(R);
+        R->db = db;
+        R->res = res;
+        R->stream = true;
+        R->cancel = cancel;
+        R->maxRows = maxRows;
+        R->currentRow = -1;
+        R->columnCount = PQnfields(res);
+        R->rowCount = PQntuples(res);
+        _setColumns(R);
+        if (! _isRow(res)) {
+                _drain(db);
+                R->db = NULL;
+        }
         return R;
 }
 
 
 void PostgresqlResultSet_free(T *R) {
         assert(R && *R);
+        if ((*R)->db) {
+                // Outside a transaction an unfinished query can be canceled instead of reading all its rows
+                if ((*R)->cancel) {
+                        char error[256];
+                        PGcancel *c = PQgetCancel((*R)->db);
+                        if (c) {
+                                PQcancel(c, error, sizeof(error));
+                                PQfreeCancel(c);
+                        }
+                }
+                _drain((*R)->db);
+        }
+        if ((*R)->stream)
+                PQclear((*R)->res);
+        if ((*R)->columns) {
+                for (int i = 0; i < (*R)->columnCount; i++)
+                        FREE((*R)->columns[i].text);
+                FREE((*R)->columns);
+        }
         FREE(*R);
 }
 
@@ -183,7 +523,12 @@ long PostgresqlResultSet_getColumnSize(T R, int columnIndex) {
 
 int PostgresqlResultSet_next(T R) {
         assert(R);
-        return (! ((R->currentRow++ >= (R->rowCount - 1)) || (R->maxRows && (R->currentRow >= R->maxRows))));
+        if (R->maxRows && (R->rows >= R->maxRows))
+                return false;
+        if (++R->currentRow >= R->rowCount && ! (R->db && _fetch(R)))
+                return false;
+        R->rows++;
+        return true;
 }
 
 
@@ -199,10 +544,97 @@ const char *PostgresqlResultSet_getString(T R, int columnIndex) {
         int i = checkAndSetColumnIndex(columnIndex, R->columnCount);
         if (PQgetisnull(R->res, R->currentRow, i))
                 return NULL; 
+        if (R->binary)
+                return _toString(R, i);
         return PQgetvalue(R->res, R->currentRow, i);
 }
 
 
+int PostgresqlResultSet_getInt(T R, int columnIndex) {
+        assert(R);
+        if (R->binary) {
+                long long n = PostgresqlResultSet_getLLong(R, columnIndex);
+                if (n < INT32_MIN || n > INT32_MAX)
+                        THROW(SQLException, "NumberFormatException: Value %lld is out of range for int", n);
+                return (int)n;
+        }
+        const char *s = PostgresqlResultSet_getString(R, columnIndex);
+        return s ? Str_parseInt(s) : 0;
+}
+
+
+long long PostgresqlResultSet_getLLong(T R, int columnIndex) {
+        assert(R);
+        int i = checkAndSetColumnIndex(columnIndex, R->columnCount);
+        if (PQgetisnull(R->res, R->currentRow, i))
+                return 0;
+        if (R->binary) {
+                const uchar_t *v = (const uchar_t *)PQgetvalue(R->res, R->currentRow, i);
+                switch (R->columns[i].type) {
+                        case BOOLOID: return *v ? 1 : 0;
+                        case INT2OID: return (int16_t)_uint16(v);
+                        case INT4OID: return (int32_t)_uint32(v);
+                        case OIDOID:  return _uint32(v);
+                        case INT8OID: return (int64_t)_uint64(v);
+                }
+        }
+        return Str_parseLLong(PostgresqlResultSet_getString(R, columnIndex));
+}
+
+
+double PostgresqlResultSet_getDouble(T R, int columnIndex) {
+        assert(R);
+        int i = checkAndSetColumnIndex(columnIndex, R->columnCount);
+        if (PQgetisnull(R->res, R->currentRow, i))
+                return 0.0;
+        if (R->binary) {
+                const uchar_t *v = (const uchar_t *)PQgetvalue(R->res, R->currentRow, i);
+                switch (R->columns[i].type) {
+                        case FLOAT4OID:
+                        {
+                                float f;
+                                uint32_t n = _uint32(v);
+                                memcpy(&f, &n, sizeof(f));
+                                return f;
+                        }
+                        case FLOAT8OID:
+                        {
+                                double d;
+                                uint64_t n = _uint64(v);
+                                memcpy(&d, &n, sizeof(d));
+                                return d;
+                        }
+                        case INT2OID:
+                        case INT4OID:
+                        case INT8OID:
+                        case OIDOID:
+                                return (double)PostgresqlResultSet_getLLong(R, columnIndex);
+                }
+        }
+        return Str_parseDouble(PostgresqlResultSet_getString(R, columnIndex));
+}
+
+
+time_t PostgresqlResultSet_getTimestamp(T R, int columnIndex) {
+        assert(R);
+        int i = checkAndSetColumnIndex(columnIndex, R->columnCount);
+        if (PQgetisnull(R->res, R->currentRow, i))
+                return 0;
+        if (R->binary) {
+                const uchar_t *v = (const uchar_t *)PQgetvalue(R->res, R->currentRow, i);
+                switch (R->columns[i].type) {
+                        case TIMESTAMPOID:
+                        case TIMESTAMPTZOID:
+                                return _toTimestamp((int64_t)_uint64(v));
+                        case DATEOID:
+                                return (time_t)(POSTGRES_EPOCH + (int64_t)(int32_t)_uint32(v) * 86400);
+                }
+        }
+        const char *s = PostgresqlResultSet_getString(R, columnIndex);
+        return STR_DEF(s) ? Time_toTimestamp(s) : 0;
+}
+
+
 /*
  * As a "hack" to avoid extra allocation and complications by using PQunescapeBytea()
  * we instead unescape the buffer retrieved via PQgetvalue 'in-place'. This should 
@@ -214,6 +646,10 @@ const void *PostgresqlResultSet_getBlob(T R, int columnIndex, int *size) {
         int i = checkAndSetColumnIndex(columnIndex, R->columnCount);
         if (PQgetisnull(R->res, R->currentRow, i))
                 return NULL; 
+        if (R->binary) {
+                *size = PQgetlength(R->res, R->currentRow, i);
+                return PQgetvalue(R->res, R->currentRow, i);
+        }
         return _unescape_bytea((uchar_t*)PQgetvalue(R->res, R->currentRow, i), PQgetlength(R->res, R->currentRow, i), size);
 }
 
@@ -25,6 +25,7 @@
 #define POSTGRESQLRESULTSET_INCLUDED
 #define T ResultSetDelegate_T
 T PostgresqlResultSet_new(void *stmt, int maxRows);
+T PostgresqlResultSet_stream(void *db, int maxRows, int fetchSize, int cancel, void **error);
 void PostgresqlResultSet_free(T *R);
 int PostgresqlResultSet_getColumnCount(T R);
 const char *PostgresqlResultSet_getColumnName(T R, int columnIndex);
@@ -32,6 +33,10 @@ long PostgresqlResultSet_getColumnSize(T R, int columnIndex);
 int PostgresqlResultSet_next(T R);
 int PostgresqlResultSet_isnull(T R, int columnIndex);
 const char *PostgresqlResultSet_getString(T R, int columnIndex);
+int PostgresqlResultSet_getInt(T R, int columnIndex);
+long long PostgresqlResultSet_getLLong(T R, int columnIndex);
+double PostgresqlResultSet_getDouble(T R, int columnIndex);
+time_t PostgresqlResultSet_getTimestamp(T R, int columnIndex);
 const void *PostgresqlResultSet_getBlob(T R, int columnIndex, int *size);
 #undef T
 #endif
@@ -32,6 +32,7 @@
 #include "system/Time.h"
 #include "ResultSet.h"
 #include "SQLiteResultSet.h"
+#include "PreparedStatement.h"
 #include "PreparedStatementDelegate.h"
 #include "SQLitePreparedStatement.h"
 
@@ -59,7 +60,8 @@ const struct Pop_T sqlite3pops = {
         .setBlob        = SQLitePreparedStatement_setBlob,
         .execute        = SQLitePreparedStatement_execute,
         .executeQuery   = SQLitePreparedStatement_executeQuery,
-        .rowsChanged    = SQLitePreparedStatement_rowsChanged
+        .rowsChanged    = SQLitePreparedStatement_rowsChanged,
+        .executeBatch   = SQLitePreparedStatement_executeBatch
 };
 
 #define T PreparedStatementDelegate_T
@@ -73,6 +75,36 @@ struct T {
 extern const struct Rop_T sqlite3rops;
 
 
+/* ------------------------------------------------------- Private methods */
+
+
+static inline int _exec(T P, const char *sql) {
+        int status;
+#if defined SQLITEUNLOCK && SQLITE_VERSION_NUMBER >= 3006012
+        status = sqlite3_blocking_exec(P->db, sql, NULL, NULL, NULL);
+#else
+        EXEC_SQLITE(status, sqlite3_exec(P->db, sql, NULL, NULL, NULL), SQL_DEFAULT_TIMEOUT);
+#endif
+        return status;
+}
+
+
+static void _bind(T P, const Param_T *row, int count) {
+        sqlite3_reset(P->stmt);
+        for (int i = 0; i < count; i++) {
+                switch (row[i].type) {
+                        case PARAM_NULL:      P->lastError = sqlite3_bind_null(P->stmt, i + 1); break;
+                        case PARAM_STRING:    P->lastError = sqlite3_bind_text(P->stmt, i + 1, row[i].value.data, row[i].size, SQLITE_STATIC); break;
+                        case PARAM_INT:
+                        case PARAM_LLONG:
+                        case PARAM_TIMESTAMP: P->lastError = sqlite3_bind_int64(P->stmt, i + 1, row[i].value.integer); break;
+                        case PARAM_DOUBLE:    P->lastError = sqlite3_bind_double(P->stmt, i + 1, row[i].value.real); break;
+                        case PARAM_BLOB:      P->lastError = sqlite3_bind_blob(P->stmt, i + 1, row[i].value.data, row[i].size, SQLITE_STATIC); break;
+                }
+        }
+}
+
+
 /* ----------------------------------------------------- Protected methods */
 
 
@@ -192,6 +224,36 @@ long long SQLitePreparedStatement_rowsChanged(T P) {
         return (long long)sqlite3_changes(P->db);
 }
 
+
+int SQLitePreparedStatement_executeBatch(T P, const Param_T *rows, int count, long long *counts) {
+        assert(P);
+        int parameterCount = sqlite3_bind_parameter_count(P->stmt);
+        /* Run the batch in one transaction unless the caller already started one */
+        int transaction = sqlite3_get_autocommit(P->db);
+        if (transaction && (P->lastError = _exec(P, "BEGIN TRANSACTION;")) != SQLITE_OK)
+                THROW(SQLException, "%s", sqlite3_errmsg(P->db));
+        TRY
+        {
+                for (int r = 0; r < count; r++) {
+                        _bind(P, rows + (r * parameterCount), parameterCount);
+                        SQLitePreparedStatement_execute(P);
+                        counts[r] = (long long)sqlite3_changes(P->db);
+                }
+                sqlite3_clear_bindings(P->stmt);
+                if (transaction && (P->lastError = _exec(P, "COMMIT TRANSACTION;")) != SQLITE_OK)
+                        THROW(SQLException, "%s", sqlite3_errmsg(P->db));
+        }
+        ELSE
+        {
+                sqlite3_clear_bindings(P->stmt);
+                if (transaction && ! sqlite3_get_autocommit(P->db))
+                        _exec(P, "ROLLBACK TRANSACTION;");
+                THROW(SQLException, "%s", Exception_frame.message);
+        }
+        END_TRY;
+        return true;
+}
+
 #ifdef PACKAGE_PROTECTED
 #pragma GCC visibility pop
 #endif
@@ -35,5 +35,6 @@ void SQLitePreparedStatement_setBlob(T P, int parameterIndex, const void *x, int
 void SQLitePreparedStatement_execute(T P);
 ResultSet_T SQLitePreparedStatement_executeQuery(T P);
 long long SQLitePreparedStatement_rowsChanged(T P);
+int SQLitePreparedStatement_executeBatch(T P, const Param_T *rows, int count, long long *counts);
 #undef T
 #endif
@@ -27,6 +27,7 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <limits.h>
 #include <sqlite3.h>
 
 #include "system/Time.h"
@@ -54,6 +55,9 @@ const struct Rop_T sqlite3rops = {
         .next           = SQLiteResultSet_next,
         .isnull         = SQLiteResultSet_isnull,
         .getString      = SQLiteResultSet_getString,
+        .getInt         = SQLiteResultSet_getInt,
+        .getLLong       = SQLiteResultSet_getLLong,
+        .getDouble      = SQLiteResultSet_getDouble,
         .getBlob        = SQLiteResultSet_getBlob,
         .getTimestamp   = SQLiteResultSet_getTimestamp,
         .getDateTime    = SQLiteResultSet_getDateTime
@@ -154,6 +158,42 @@ const char *SQLiteResultSet_getString(T R, int columnIndex) {
 }
 
 
+int SQLiteResultSet_getInt(T R, int columnIndex) {
+        long long n = SQLiteResultSet_getLLong(R, columnIndex);
+        if (n < INT_MIN || n > INT_MAX)
+                THROW(SQLException, "NumberFormatException: Value %lld is out of range for int", n);
+        return (int)n;
+}
+
+
+long long SQLiteResultSet_getLLong(T R, int columnIndex) {
+        assert(R);
+        int i = checkAndSetColumnIndex(columnIndex, R->columnCount);
+        switch (sqlite3_column_type(R->stmt, i)) {
+                case SQLITE_NULL:
+                        return 0;
+                case SQLITE_INTEGER:
+                        return sqlite3_column_int64(R->stmt, i);
+        }
+        // Other storage classes are parsed as before so non-integer values still throw
+        return Str_parseLLong((const char*)sqlite3_column_text(R->stmt, i));
+}
+
+
+double SQLiteResultSet_getDouble(T R, int columnIndex) {
+        assert(R);
+        int i = checkAndSetColumnIndex(columnIndex, R->columnCount);
+        switch (sqlite3_column_type(R->stmt, i)) {
+                case SQLITE_NULL:
+                        return 0.0;
+                case SQLITE_INTEGER:
+                case SQLITE_FLOAT:
+                        return sqlite3_column_double(R->stmt, i);
+        }
+        return Str_parseDouble((const char*)sqlite3_column_text(R->stmt, i));
+}
+
+
 const void *SQLiteResultSet_getBlob(T R, int columnIndex, int *size) {
         assert(R);
         int i = checkAndSetColumnIndex(columnIndex, R->columnCount);
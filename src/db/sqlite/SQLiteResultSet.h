@@ -120,6 +120,9 @@ long SQLiteResultSet_getColumnSize(T R, int columnIndex);
 int SQLiteResultSet_next(T R);
 int SQLiteResultSet_isnull(T R, int columnIndex);
 const char *SQLiteResultSet_getString(T R, int columnIndex);
+int SQLiteResultSet_getInt(T R, int columnIndex);
+long long SQLiteResultSet_getLLong(T R, int columnIndex);
+double SQLiteResultSet_getDouble(T R, int columnIndex);
 const void *SQLiteResultSet_getBlob(T R, int columnIndex, int *size);
 time_t SQLiteResultSet_getTimestamp(T R, int columnIndex);
 struct tm *SQLiteResultSet_getDateTime(T R, int columnIndex, struct tm *tm);
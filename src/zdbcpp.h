@@ -28,8 +28,10 @@
 
 #include "zdb.h"
 #include <string>
+#include <vector>
 #include <utility>
 #include <stdexcept>
+#include <cstdlib>
 
 ZDBCPP_BEGIN
 
@@ -329,6 +331,34 @@ public:
         except_wrapper( return PreparedStatement_getFetchSize(t_) );
     }
 
+    void addBatch() {
+        except_wrapper( PreparedStatement_addBatch(t_) );
+    }
+
+    //bind args and add them to the batch, e.g. p.addBatch(1, "Kamiya Kaoru")
+    template <typename ...Args>
+    void addBatch(Args... args) {
+        bindArgs(args...);
+        addBatch();
+    }
+
+    //returns the number of rows changed by each row in the batch
+    std::vector<long long> executeBatch() {
+        except_wrapper(
+            int size = 0;
+            const long long *counts = PreparedStatement_executeBatch(t_, &size);
+            return std::vector<long long>(counts, counts + size);
+        );
+    }
+
+    void clearBatch() {
+        except_wrapper( PreparedStatement_clearBatch(t_) );
+    }
+
+    int getBatchSize() {
+        except_wrapper( return PreparedStatement_getBatchSize(t_) );
+    }
+
 public: //for c++ template to use
     void bind(int parameterIndex, const char *x) {
         this->setString(parameterIndex, x);
@@ -379,6 +409,90 @@ private:
 
 private:
     PreparedStatement_T t_;
+};
+
+// Writer for COPY .. FROM STDIN, see Connection::copyIn. 
+// If end() is not called, the COPY is aborted when the writer is destroyed
+class CopyWriter : private noncopyable
+{
+public:
+    ~CopyWriter() {
+        abort("COPY was not ended");
+    }
+
+    CopyWriter(CopyWriter&& r)
+        :t_(r.t_)
+    {
+        r.t_ = nullptr;
+    }
+
+protected:
+    friend class Connection;
+
+    CopyWriter(Connection_T C)
+        :t_(C)
+    {}
+
+public:
+    //data is passed to the connection as-is, no copy is made
+    void write(const void *data, int size) {
+        except_wrapper( Connection_putCopyData(t_, data, size) );
+    }
+
+    void write(const std::string& data) {
+        write(data.data(), static_cast<int>(data.size()));
+    }
+
+    //returns the number of rows copied
+    long long end() {
+        Connection_T C = t_;
+        t_ = nullptr;
+        except_wrapper( return Connection_endCopyIn(C) );
+    }
+
+    void abort(const char *error) {
+        if (t_) {
+            Connection_abortCopyIn(t_, error);
+            t_ = nullptr;
+        }
+    }
+
+private:
+    Connection_T t_;
+};
+
+// Reader for COPY .. TO STDOUT, see Connection::copyOut
+class CopyReader : private noncopyable
+{
+public:
+    CopyReader(CopyReader&& r)
+        :t_(r.t_)
+    {
+        r.t_ = nullptr;
+    }
+
+protected:
+    friend class Connection;
+
+    CopyReader(Connection_T C)
+        :t_(C)
+    {}
+
+public:
+    //returns the next buffer, valid until the next call, or nullptr when all data was read
+    const char *read(int *size) {
+        *size = 0;
+        if (!t_)
+            return nullptr;
+        const void *data = nullptr;
+        except_wrapper( data = Connection_getCopyData(t_, size) );
+        if (!data)
+            t_ = nullptr;
+        return static_cast<const char *>(data);
+    }
+
+private:
+    Connection_T t_;
 };
 
 class Connection : private noncopyable
@@ -497,6 +611,34 @@ public:
         except_wrapper( Connection_rollback(t_) );
     }
 
+    //postgresql only, see Connection_beginPipeline
+    void beginPipeline() {
+        except_wrapper( Connection_beginPipeline(t_) );
+    }
+
+    void syncPipeline() {
+        except_wrapper( Connection_syncPipeline(t_) );
+    }
+
+    void endPipeline() {
+        except_wrapper( Connection_endPipeline(t_) );
+    }
+
+    bool isInPipeline() {
+        return Connection_isInPipeline(t_) != 0;
+    }
+
+    //postgresql only, see Connection_copyIn and Connection_copyOut
+    CopyWriter copyIn(const char *sql) {
+        except_wrapper( Connection_copyIn(t_, "%s", sql) );
+        return CopyWriter(t_);
+    }
+
+    CopyReader copyOut(const char *sql) {
+        except_wrapper( Connection_copyOut(t_, "%s", sql) );
+        return CopyReader(t_);
+    }
+
     long long lastRowId() {
         except_wrapper( return Connection_lastRowId(t_) );
     }
@@ -514,11 +656,14 @@ public:
         );
     }
 
+    //one-shot, a cached statement for sql is reused, otherwise no statement is prepared where the database allows
     template<typename ...Args>
     void execute(const char *sql, Args... args) {
-        PreparedStatement p = this->prepareStatement(sql, args...);
-        p.execute();
-        rows_changed_ = p.rowsChanged();
+        Param_T params[] = {param(args)...};
+        rows_changed_ = -1;
+        except_wrapper(
+            rows_changed_ = Connection_executeParams(t_, sql, sizeof...(args), params);
+        );
     }
 
     ResultSet executeQuery(const char *sql) {
@@ -530,8 +675,11 @@ public:
 
     template<typename ...Args>
     ResultSet executeQuery(const char *sql, Args... args) {
-        PreparedStatement p = this->prepareStatement(sql, args...);
-        return p.executeQuery();
+        Param_T params[] = {param(args)...};
+        except_wrapper(
+            ResultSet_T r = Connection_executeQueryParams(t_, sql, sizeof...(args), params);
+            return ResultSet(r);
+        );
     }
 
     PreparedStatement prepareStatement(const char *sql) {
@@ -551,6 +699,18 @@ public:
         );
     }
 
+    void closeStatement(PreparedStatement& p) {
+        except_wrapper( Connection_closeStatement(t_, p) );
+    }
+
+    long long getStatementCacheHits() {
+        except_wrapper( return Connection_getStatementCacheHits(t_) );
+    }
+
+    long long getStatementCacheMisses() {
+        except_wrapper( return Connection_getStatementCacheMisses(t_) );
+    }
+
     const char *getLastError() {
         except_wrapper( return Connection_getLastError(t_) );
     }
@@ -558,6 +718,47 @@ public:
     static int isSupported(const char *url) {
         except_wrapper( return Connection_isSupported(url) );
     }
+
+private:
+    //parameter values for the one-shot execute and executeQuery, as bind() in PreparedStatement
+    static Param_T param(const char *x) {
+        Param_T p = {};
+        p.type = x ? PARAM_STRING : PARAM_NULL;
+        p.value.data = x;
+        return p;
+    }
+
+    static Param_T param(const std::string& x) {
+        return param(x.c_str());
+    }
+
+    static Param_T param(int x) {
+        Param_T p = {};
+        p.type = PARAM_INT;
+        p.value.integer = x;
+        return p;
+    }
+
+    static Param_T param(long long x) {
+        Param_T p = {};
+        p.type = PARAM_LLONG;
+        p.value.integer = x;
+        return p;
+    }
+
+    static Param_T param(double x) {
+        Param_T p = {};
+        p.type = PARAM_DOUBLE;
+        p.value.real = x;
+        return p;
+    }
+
+    static Param_T param(time_t x) {
+        Param_T p = {};
+        p.type = PARAM_TIMESTAMP;
+        p.value.integer = x;
+        return p;
+    }
 
 private:
     Connection_T t_;
@@ -597,6 +798,14 @@ public:
         except_wrapper( return ConnectionPool_getInitialConnections(t_) );
     }
 
+    void setReadyConnections(int connections) {
+        except_wrapper( ConnectionPool_setReadyConnections(t_, connections) );
+    }
+
+    int getReadyConnections() {
+        except_wrapper( return ConnectionPool_getReadyConnections(t_) );
+    }
+
     void setMaxConnections(int maxConnections) {
         except_wrapper( ConnectionPool_setMaxConnections(t_, maxConnections) );
     }
@@ -613,10 +822,98 @@ public:
         except_wrapper( return ConnectionPool_getConnectionTimeout(t_) );
     }
 
+    void setPolicy(PoolPolicy_T policy) {
+        except_wrapper( ConnectionPool_setPolicy(t_, policy) );
+    }
+
+    PoolPolicy_T getPolicy() {
+        except_wrapper( return ConnectionPool_getPolicy(t_) );
+    }
+
+    void setStripes(int stripes) {
+        except_wrapper( ConnectionPool_setStripes(t_, stripes) );
+    }
+
+    int getStripes() {
+        except_wrapper( return ConnectionPool_getStripes(t_) );
+    }
+
+    void setAffinity(bool affinity) {
+        except_wrapper( ConnectionPool_setAffinity(t_, affinity) );
+    }
+
+    bool getAffinity() {
+        except_wrapper( return ConnectionPool_getAffinity(t_) != 0 );
+    }
+
+    void setMaxWaiters(int maxWaiters) {
+        except_wrapper( ConnectionPool_setMaxWaiters(t_, maxWaiters) );
+    }
+
+    int getMaxWaiters() {
+        except_wrapper( return ConnectionPool_getMaxWaiters(t_) );
+    }
+
     void setAbortHandler(void(*abortHandler)(const char *error)) {
         except_wrapper( ConnectionPool_setAbortHandler(t_, abortHandler) );
     }
 
+    void setValidationInterval(int validationInterval) {
+        except_wrapper( ConnectionPool_setValidationInterval(t_, validationInterval) );
+    }
+
+    int getValidationInterval() {
+        except_wrapper( return ConnectionPool_getValidationInterval(t_) );
+    }
+
+    void setMinIdle(int minIdle) {
+        except_wrapper( ConnectionPool_setMinIdle(t_, minIdle) );
+    }
+
+    int getMinIdle() {
+        except_wrapper( return ConnectionPool_getMinIdle(t_) );
+    }
+
+    void setCollectStatistics(bool collect) {
+        except_wrapper( ConnectionPool_setCollectStatistics(t_, collect) );
+    }
+
+    bool getCollectStatistics() {
+        except_wrapper( return ConnectionPool_getCollectStatistics(t_) != 0 );
+    }
+
+    void setAutoscale(int minConnections, int maxConnections) {
+        except_wrapper( ConnectionPool_setAutoscale(t_, minConnections, maxConnections) );
+    }
+
+    bool getAutoscale() {
+        except_wrapper( return ConnectionPool_getAutoscale(t_) != 0 );
+    }
+
+    void setAutoscaleWait(int milliseconds) {
+        except_wrapper( ConnectionPool_setAutoscaleWait(t_, milliseconds) );
+    }
+
+    int getAutoscaleWait() {
+        except_wrapper( return ConnectionPool_getAutoscaleWait(t_) );
+    }
+
+    void setStatementCacheSize(int size) {
+        except_wrapper( ConnectionPool_setStatementCacheSize(t_, size) );
+    }
+
+    int getStatementCacheSize() {
+        except_wrapper( return ConnectionPool_getStatementCacheSize(t_) );
+    }
+
+    void addInitStatement(const char *sql) {
+        except_wrapper( ConnectionPool_addInitStatement(t_, sql) );
+    }
+
+    void addPreparedStatement(const char *sql) {
+        except_wrapper( ConnectionPool_addPreparedStatement(t_, sql) );
+    }
+
     void setReaper(int sweepInterval) {
         except_wrapper( ConnectionPool_setReaper(t_, sweepInterval) );
     }
@@ -629,6 +926,29 @@ public:
         except_wrapper( return ConnectionPool_active(t_) );
     }
 
+    int waiters() {
+        except_wrapper( return ConnectionPool_waiters(t_) );
+    }
+
+    PoolStatistics_T getStatistics() {
+        PoolStatistics_T statistics;
+        except_wrapper( ConnectionPool_getStatistics(t_, &statistics) );
+        return statistics;
+    }
+
+    std::string exportStatistics(const char *labels = nullptr) {
+        except_wrapper(
+            char *text = ConnectionPool_exportStatistics(t_, labels);
+            std::string result(text);
+            free(text);
+            return result;
+        );
+    }
+
+    static long long percentile(const PoolHistogram_T& histogram, double percentile) {
+        return ConnectionPool_percentile(&histogram, percentile);
+    }
+
     void start() {
         except_wrapper( ConnectionPool_start(t_) );
     }
@@ -647,6 +967,26 @@ public:
         );
     }
 
+    Connection getConnection(int timeout) {
+        except_wrapper(
+            Connection_T C = ConnectionPool_getConnectionWithTimeout(t_, timeout);
+            if (NULL == C) {
+                throw sql_exception("timed out waiting for a connection(got null connection)!");
+            }
+            return Connection(C);
+        );
+    }
+
+    Connection getConnectionFor(const char *sql) {
+        except_wrapper(
+            Connection_T C = ConnectionPool_getConnectionFor(t_, sql);
+            if (NULL == C) {
+                throw sql_exception("maxConnection is reached(got null connection)!");
+            }
+            return Connection(C);
+        );
+    }
+
     void returnConnection(Connection& con) {
         except_wrapper(
             con.setClosed();
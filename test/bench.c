@@ -0,0 +1,157 @@
+/*
+ * Copyright (C) Tildeslash Ltd. All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ *
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.
+ */
+
+
+#include "Config.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "URL.h"
+#include "Thread.h"
+#include "Vector.h"
+#include "ResultSet.h"
+#include "PreparedStatement.h"
+#include "Connection.h"
+#include "ConnectionPool.h"
+#include "SQLException.h"
+
+
+/**
+ * libzdb connection pool contention benchmark. A number of threads borrow
+ * and return connections as fast as possible while most of the pool is
+ * held busy. Borrow latency should stay flat as the pool grows.
+ *
+ * Usage: bench [database url]
+ */
+
+#define THREADS 4
+#define ITERATIONS 2000
+#define DEFAULT_URL "sqlite:///tmp/zdbbench.db?synchronous=off"
+
+#define MODE_SHARED 0
+#define MODE_AFFINITY 1
+#define MODE_STRIPED 2
+
+static int sizes[] = {16, 64, 256, 512, 0};
+static const char *modes[] = {"shared", "affinity", "striped"};
+
+typedef struct bench_t {
+        ConnectionPool_T pool;
+        long long *samples;
+        int failed;
+} *bench_t;
+
+
+static long long _nanos(void) {
+        struct timespec t;
+        clock_gettime(CLOCK_MONOTONIC, &t);
+        return (long long)t.tv_sec * 1000000000LL + t.tv_nsec;
+}
+
+
+static int _compare(const void *a, const void *b) {
+        long long x = *(const long long *)a, y = *(const long long *)b;
+        return (x > y) - (x < y);
+}
+
+
+static void *_borrower(void *args) {
+        bench_t b = args;
+        for (int i = 0; i < ITERATIONS; i++) {
+                long long start = _nanos();
+                Connection_T con = ConnectionPool_getConnection(b->pool);
+                b->samples[i] = _nanos() - start;
+                if (! con) {
+                        b->failed++;
+                        continue;
+                }
+                Connection_close(con);
+        }
+        return NULL;
+}
+
+
+static void _run(URL_T url, int size, int mode) {
+        Thread_T threads[THREADS];
+        struct bench_t bench[THREADS];
+        long long *all = CALLOC(THREADS * ITERATIONS, sizeof(long long));
+        Vector_T held = Vector_new(size);
+        ConnectionPool_T pool = ConnectionPool_new(url);
+        ConnectionPool_setMaxConnections(pool, size);
+        ConnectionPool_setInitialConnections(pool, size);
+        ConnectionPool_setAffinity(pool, mode == MODE_AFFINITY);
+        ConnectionPool_setStripes(pool, mode == MODE_STRIPED ? THREADS : 1);
+        ConnectionPool_start(pool);
+        /* Keep most of the pool busy so borrowers compete for the remaining few */
+        for (int i = 0; i < size - THREADS; i++)
+                Vector_push(held, ConnectionPool_getConnection(pool));
+        for (int i = 0; i < THREADS; i++) {
+                bench[i].pool = pool;
+                bench[i].failed = 0;
+                bench[i].samples = all + (i * ITERATIONS);
+                Thread_create(threads[i], _borrower, &bench[i]);
+        }
+        int failed = 0;
+        for (int i = 0; i < THREADS; i++) {
+                Thread_join(threads[i]);
+                failed += bench[i].failed;
+        }
+        qsort(all, THREADS * ITERATIONS, sizeof(long long), _compare);
+        long long sum = 0;
+        for (int i = 0; i < THREADS * ITERATIONS; i++)
+                sum += all[i];
+        printf("\t%-9s %-6d %-6d %-12.2f %-12.2f %-12.2f %d\n", modes[mode], size, size - THREADS,
+               sum / (THREADS * ITERATIONS) / 1000.0,
+               all[(THREADS * ITERATIONS) / 2] / 1000.0,
+               all[(THREADS * ITERATIONS * 99) / 100] / 1000.0,
+               failed);
+        while (! Vector_isEmpty(held))
+                Connection_close(Vector_pop(held));
+        ConnectionPool_free(&pool);
+        Vector_free(&held);
+        FREE(all);
+}
+
+
+int main(int argc, char **argv) {
+        URL_T url = URL_new(argc > 1 ? argv[1] : DEFAULT_URL);
+        if (! url) {
+                printf("Please enter a valid database connection URL\n");
+                exit(1);
+        }
+        Exception_init();
+        printf("============> Start Connection Pool Benchmark\n\n");
+        printf("\t%d threads, %d borrow/return each, %s\n\n", THREADS, ITERATIONS, URL_toString(url));
+        printf("\t%-9s %-6s %-6s %-12s %-12s %-12s %s\n", "mode", "max", "held", "avg (us)", "p50 (us)", "p99 (us)", "failed");
+        for (int mode = MODE_SHARED; mode <= MODE_STRIPED; mode++)
+                for (int i = 0; sizes[i]; i++)
+                        _run(url, sizes[i], mode);
+        printf("\n============> Connection Pool Benchmark: OK\n\n");
+        URL_free(&url);
+        return 0;
+}
@@ -9,6 +9,7 @@
 #include "URL.h"
 #include "Thread.h"
 #include "Vector.h"
+#include "system/Time.h"
 #include "ResultSet.h"
 #include "PreparedStatement.h"
 #include "Connection.h"
@@ -39,6 +40,35 @@ static void TabortHandler(const char *error) {
         exit(1);
 }
 
+static void *Tborrower(void *args) {
+        ConnectionPool_T pool = args;
+        for (int i = 0; i < 100; i++) {
+                Connection_T con = ConnectionPool_getConnection(pool);
+                if (con) {
+                        assert(ConnectionPool_size(pool) <= ConnectionPool_getMaxConnections(pool));
+                        Connection_close(con);
+                }
+        }
+        return NULL;
+}
+
+static void *Tstress(void *args) {
+        ConnectionPool_T pool = args;
+        for (int i = 0; i < 2000; i++) {
+                Connection_T con = ConnectionPool_getConnection(pool);
+                if (con)
+                        Connection_close(con);
+        }
+        return NULL;
+}
+
+static Connection_T Twaited = NULL;
+static void *Twaiter(void *args) {
+        ConnectionPool_T pool = args;
+        Twaited = ConnectionPool_getConnectionWithTimeout(pool, 5000);
+        return NULL;
+}
+
 static void testPool(const char *testURL) {
         URL_T url;
         char *schema;
@@ -677,6 +707,1143 @@ static void testPool(const char *testURL) {
         }
         printf("=> Test10: OK\n\n");
 
+        printf("=> Test11: LIFO and FIFO pool policy\n");
+        {
+                Connection_T a, b, c;
+                url = URL_new(testURL);
+                pool = ConnectionPool_new(url);
+                assert(pool);
+                assert(ConnectionPool_getPolicy(pool) == POOL_LIFO);
+                ConnectionPool_setInitialConnections(pool, 2);
+                ConnectionPool_setAbortHandler(pool, TabortHandler);
+                ConnectionPool_start(pool);
+                a = ConnectionPool_getConnection(pool);
+                b = ConnectionPool_getConnection(pool);
+                assert(a && b && a != b);
+                assert(ConnectionPool_active(pool) == 2);
+                Connection_close(a);
+                Connection_close(b);
+                assert(ConnectionPool_active(pool) == 0);
+                printf("\tResult: LIFO hands out the most recently returned connection..");
+                c = ConnectionPool_getConnection(pool);
+                assert(c == b);
+                Connection_close(c);
+                printf("success\n");
+                ConnectionPool_setPolicy(pool, POOL_FIFO);
+                assert(ConnectionPool_getPolicy(pool) == POOL_FIFO);
+                a = ConnectionPool_getConnection(pool);
+                b = ConnectionPool_getConnection(pool);
+                Connection_close(a);
+                Connection_close(b);
+                printf("\tResult: FIFO hands out the least recently returned connection..");
+                c = ConnectionPool_getConnection(pool);
+                assert(c == a);
+                Connection_close(c);
+                printf("success\n");
+                assert(ConnectionPool_size(pool) == 2);
+                ConnectionPool_stop(pool);
+                ConnectionPool_free(&pool);
+                assert(pool==NULL);
+                URL_free(&url);
+        }
+        printf("=> Test11: OK\n\n");
+
+        printf("=> Test12: Concurrent borrowers connect outside the pool lock\n");
+        {
+                Thread_T threads[8];
+                url = URL_new(testURL);
+                pool = ConnectionPool_new(url);
+                assert(pool);
+                ConnectionPool_setInitialConnections(pool, 0);
+                ConnectionPool_setMaxConnections(pool, 4);
+                ConnectionPool_setAbortHandler(pool, TabortHandler);
+                ConnectionPool_start(pool);
+                for (int i = 0; i < 8; i++)
+                        Thread_create(threads[i], Tborrower, pool);
+                for (int i = 0; i < 8; i++)
+                        Thread_join(threads[i]);
+                printf("\tResult: pool size %d of max %d\n", ConnectionPool_size(pool), ConnectionPool_getMaxConnections(pool));
+                assert(ConnectionPool_size(pool) <= 4);
+                assert(ConnectionPool_active(pool) == 0);
+                ConnectionPool_stop(pool);
+                ConnectionPool_free(&pool);
+                assert(pool==NULL);
+                URL_free(&url);
+        }
+        printf("=> Test12: OK\n\n");
+
+        printf("=> Test13: Wait for a connection with timeout\n");
+        {
+                Thread_T waiter;
+                Connection_T con, got;
+                long long start;
+                url = URL_new(testURL);
+                pool = ConnectionPool_new(url);
+                assert(pool);
+                ConnectionPool_setInitialConnections(pool, 1);
+                ConnectionPool_setMaxConnections(pool, 1);
+                ConnectionPool_setAbortHandler(pool, TabortHandler);
+                ConnectionPool_start(pool);
+                con = ConnectionPool_getConnection(pool);
+                assert(con);
+                assert(ConnectionPool_getConnection(pool) == NULL);
+                start = Time_milli();
+                assert(ConnectionPool_getConnectionWithTimeout(pool, 200) == NULL);
+                assert(Time_milli() - start >= 190);
+                printf("\tResult: timed out after %lldms\n", Time_milli() - start);
+                // A returned connection is handed to the waiting thread
+                Thread_create(waiter, Twaiter, pool);
+                while (ConnectionPool_waiters(pool) == 0)
+                        Time_usleep(1000);
+                Connection_close(con);
+                Thread_join(waiter);
+                got = Twaited;
+                assert(got == con);
+                assert(ConnectionPool_waiters(pool) == 0);
+                printf("\tResult: returned connection handed to waiter\n");
+                // Excess waiters are shed immediately
+                ConnectionPool_setMaxWaiters(pool, 0);
+                start = Time_milli();
+                assert(ConnectionPool_getConnectionWithTimeout(pool, 5000) == NULL);
+                assert(Time_milli() - start < 1000);
+                Connection_close(got);
+                ConnectionPool_stop(pool);
+                ConnectionPool_free(&pool);
+                assert(pool==NULL);
+                URL_free(&url);
+        }
+        printf("=> Test13: OK\n\n");
+
+        printf("=> Test14: Thread affinity\n");
+        {
+                Connection_T a, b, c;
+                url = URL_new(testURL);
+                pool = ConnectionPool_new(url);
+                assert(pool);
+                ConnectionPool_setInitialConnections(pool, 2);
+                ConnectionPool_setPolicy(pool, POOL_FIFO);
+                ConnectionPool_setAffinity(pool, true);
+                assert(ConnectionPool_getAffinity(pool));
+                ConnectionPool_setAbortHandler(pool, TabortHandler);
+                ConnectionPool_start(pool);
+                a = ConnectionPool_getConnection(pool);
+                b = ConnectionPool_getConnection(pool);
+                assert(a && b && a != b);
+                Connection_close(a);
+                Connection_close(b);
+                // FIFO alone would hand out a, affinity hands back the connection returned last
+                c = ConnectionPool_getConnection(pool);
+                assert(c == b);
+                assert(ConnectionPool_active(pool) == 1);
+                // The stale idle link to b is skipped
+                a = ConnectionPool_getConnection(pool);
+                assert(a && a != b);
+                assert(ConnectionPool_active(pool) == 2);
+                Connection_close(a);
+                Connection_close(c);
+                assert(ConnectionPool_active(pool) == 0);
+                assert(ConnectionPool_size(pool) == 2);
+                printf("\tResult: thread got back its last returned connection\n");
+                ConnectionPool_stop(pool);
+                ConnectionPool_free(&pool);
+                assert(pool==NULL);
+                URL_free(&url);
+        }
+        printf("=> Test14: OK\n\n");
+
+        printf("=> Test15: Striped pool\n");
+        {
+                Thread_T threads[8];
+                Connection_T cons[4];
+                url = URL_new(testURL);
+                pool = ConnectionPool_new(url);
+                assert(pool);
+                ConnectionPool_setStripes(pool, 4);
+                assert(ConnectionPool_getStripes(pool) == 4);
+                ConnectionPool_setInitialConnections(pool, 4);
+                ConnectionPool_setMaxConnections(pool, 4);
+                ConnectionPool_setAbortHandler(pool, TabortHandler);
+                ConnectionPool_start(pool);
+                // One initial connection per stripe, a thread must steal from the other stripes
+                for (int i = 0; i < 4; i++) {
+                        cons[i] = ConnectionPool_getConnection(pool);
+                        assert(cons[i]);
+                }
+                assert(ConnectionPool_getConnection(pool) == NULL);
+                assert(ConnectionPool_size(pool) == 4);
+                for (int i = 0; i < 4; i++)
+                        Connection_close(cons[i]);
+                printf("\tResult: borrowed all connections across stripes\n");
+                for (int i = 0; i < 8; i++)
+                        Thread_create(threads[i], Tborrower, pool);
+                for (int i = 0; i < 8; i++)
+                        Thread_join(threads[i]);
+                assert(ConnectionPool_size(pool) <= 4);
+                assert(ConnectionPool_active(pool) == 0);
+                printf("\tResult: max connections enforced across stripes\n");
+                // Two threads per stripe return and borrow on the same stripe
+                for (int i = 0; i < 8; i++)
+                        Thread_create(threads[i], Tstress, pool);
+                for (int i = 0; i < 8; i++)
+                        Thread_join(threads[i]);
+                assert(ConnectionPool_active(pool) == 0);
+                assert(ConnectionPool_size(pool) == 4);
+                // Every idle Connection must still be on a stripe list and can be borrowed
+                for (int i = 0; i < 4; i++) {
+                        cons[i] = ConnectionPool_getConnection(pool);
+                        assert(cons[i]);
+                }
+                for (int i = 0; i < 4; i++)
+                        Connection_close(cons[i]);
+                printf("\tResult: all idle connections are on the stripe lists\n");
+                ConnectionPool_stop(pool);
+                ConnectionPool_free(&pool);
+                assert(pool==NULL);
+                URL_free(&url);
+        }
+        printf("=> Test15: OK\n\n");
+
+        printf("=> Test16: Validation interval\n");
+        {
+                PoolStatistics_T stats;
+                long long pings;
+                Connection_T a, b;
+                url = URL_new(testURL);
+                pool = ConnectionPool_new(url);
+                assert(pool);
+                assert(ConnectionPool_getValidationInterval(pool) == 0);
+                ConnectionPool_setValidationInterval(pool, 500);
+                assert(ConnectionPool_getValidationInterval(pool) == 500);
+                ConnectionPool_setCollectStatistics(pool, true);
+                ConnectionPool_setInitialConnections(pool, 1);
+                ConnectionPool_setAbortHandler(pool, TabortHandler);
+                ConnectionPool_start(pool);
+                a = ConnectionPool_getConnection(pool);
+                assert(a);
+                Connection_close(a);
+                ConnectionPool_getStatistics(pool, &stats);
+                pings = stats.pingTime.count;
+                // Returned a moment ago, handed out again without validation
+                b = ConnectionPool_getConnection(pool);
+                assert(b == a);
+                Connection_close(b);
+                ConnectionPool_getStatistics(pool, &stats);
+                assert(stats.pingTime.count == pings);
+                Time_usleep(600000);
+                // Past the interval, validated before it is handed out
+                b = ConnectionPool_getConnection(pool);
+                assert(b == a);
+                Connection_close(b);
+                ConnectionPool_getStatistics(pool, &stats);
+                assert(stats.pingTime.count == pings + 1);
+                if (Str_startsWith(testURL, "postgresql") || Str_startsWith(testURL, "mysql")) {
+                        int mysql = Str_startsWith(testURL, "mysql");
+                        const char *idQuery = mysql ? "select connection_id();" : "select pg_backend_pid();";
+                        ResultSet_T r;
+                        Connection_T c;
+                        a = ConnectionPool_getConnection(pool);
+                        b = ConnectionPool_getConnection(pool);
+                        assert(a && b);
+                        r = Connection_executeQuery(a, "%s", idQuery);
+                        assert(ResultSet_next(r));
+                        long long id = ResultSet_getLLong(r, 1);
+                        Connection_close(a);
+                        // Kill the idle session, the server sends an error before it closes the socket
+                        if (mysql)
+                                Connection_execute(b, "kill %lld;", id);
+                        else
+                                Connection_executeQuery(b, "select pg_terminate_backend(%lld);", id);
+                        Time_usleep(600000);
+                        c = ConnectionPool_getConnection(pool);
+                        assert(c);
+                        r = Connection_executeQuery(c, "%s", idQuery);
+                        assert(ResultSet_next(r));
+                        assert(ResultSet_getLLong(r, 1) != id);
+                        ConnectionPool_getStatistics(pool, &stats);
+                        assert(stats.validationFailed == 1);
+                        printf("\tResult: killed session %lld was discarded on borrow\n", id);
+                        Connection_close(c);
+                        Connection_close(b);
+                }
+                ConnectionPool_stop(pool);
+                ConnectionPool_free(&pool);
+                assert(pool==NULL);
+                URL_free(&url);
+        }
+        printf("=> Test16: OK\n\n");
+
+        printf("=> Test17: Reaper keeps minIdle warm connections\n");
+        {
+                Connection_T cons[3];
+                url = URL_new(testURL);
+                pool = ConnectionPool_new(url);
+                assert(pool);
+                ConnectionPool_setInitialConnections(pool, 0);
+                ConnectionPool_setMinIdle(pool, 3);
+                assert(ConnectionPool_getMinIdle(pool) == 3);
+                ConnectionPool_setReaper(pool, 1);
+                ConnectionPool_setAbortHandler(pool, TabortHandler);
+                ConnectionPool_start(pool);
+                Time_usleep(500000);
+                assert(ConnectionPool_size(pool) == 3);
+                assert(ConnectionPool_active(pool) == 0);
+                for (int i = 0; i < 3; i++)
+                        cons[i] = ConnectionPool_getConnection(pool);
+                assert(ConnectionPool_size(pool) == 3);
+                printf("Please wait 2 sec for the reaper to top up the pool..");
+                fflush(stdout);
+                sleep(2);
+                assert(ConnectionPool_size(pool) == 6);
+                assert(ConnectionPool_active(pool) == 3);
+                printf("success\n");
+                for (int i = 0; i < 3; i++)
+                        Connection_close(cons[i]);
+                ConnectionPool_stop(pool);
+                ConnectionPool_free(&pool);
+                assert(pool==NULL);
+                URL_free(&url);
+        }
+        printf("=> Test17: OK\n\n");
+
+        printf("=> Test18: Parallel start and ready connections\n");
+        {
+                url = URL_new(testURL);
+                pool = ConnectionPool_new(url);
+                assert(pool);
+                ConnectionPool_setInitialConnections(pool, 12);
+                assert(ConnectionPool_getReadyConnections(pool) == 0);
+                ConnectionPool_start(pool);
+                assert(ConnectionPool_size(pool) == 12);
+                assert(ConnectionPool_active(pool) == 0);
+                ConnectionPool_stop(pool);
+                assert(ConnectionPool_size(pool) == 0);
+                // Return after the first 2 connections, the rest are opened in the background
+                ConnectionPool_setReadyConnections(pool, 2);
+                assert(ConnectionPool_getReadyConnections(pool) == 2);
+                ConnectionPool_start(pool);
+                assert(ConnectionPool_size(pool) >= 2);
+                Connection_T con = ConnectionPool_getConnection(pool);
+                assert(con);
+                Connection_close(con);
+                for (int i = 0; i < 100 && ConnectionPool_size(pool) < 12; i++)
+                        Time_usleep(10000);
+                assert(ConnectionPool_size(pool) == 12);
+                ConnectionPool_stop(pool);
+                // Stop while the background fill may still be in progress
+                ConnectionPool_setReadyConnections(pool, 1);
+                ConnectionPool_start(pool);
+                ConnectionPool_stop(pool);
+                assert(ConnectionPool_size(pool) == 0);
+                ConnectionPool_free(&pool);
+                assert(pool==NULL);
+                URL_free(&url);
+        }
+        printf("=> Test18: OK\n\n");
+
+        printf("=> Test19: Statistics\n");
+        {
+                PoolStatistics_T stats;
+                Connection_T cons[3];
+                url = URL_new(testURL);
+                pool = ConnectionPool_new(url);
+                assert(pool);
+                assert(ConnectionPool_getCollectStatistics(pool) == false);
+                ConnectionPool_setCollectStatistics(pool, true);
+                assert(ConnectionPool_getCollectStatistics(pool) == true);
+                ConnectionPool_setInitialConnections(pool, 2);
+                ConnectionPool_setMaxConnections(pool, 3);
+                ConnectionPool_start(pool);
+                for (int i = 0; i < 3; i++)
+                        cons[i] = ConnectionPool_getConnection(pool);
+                assert(ConnectionPool_getConnection(pool) == NULL);
+                assert(ConnectionPool_getConnectionWithTimeout(pool, 50) == NULL);
+                ConnectionPool_getStatistics(pool, &stats);
+                assert(stats.size == 3);
+                assert(stats.active == 3);
+                assert(stats.idle == 0);
+                assert(stats.maxConnections == 3);
+                assert(stats.borrowed == 3);
+                assert(stats.created == 3);
+                assert(stats.exhausted == 1);
+                assert(stats.timedOut == 1);
+                assert(stats.borrowWait.count == 3);
+                assert(stats.connectTime.count == 3);
+                Time_usleep(2000);
+                for (int i = 0; i < 3; i++)
+                        Connection_close(cons[i]);
+                ConnectionPool_getStatistics(pool, &stats);
+                assert(stats.returned == 3);
+                assert(stats.active == 0);
+                assert(stats.holdTime.count == 3);
+                assert(stats.holdTime.max >= 2000);
+                assert(ConnectionPool_percentile(&stats.holdTime, 50) <= ConnectionPool_percentile(&stats.holdTime, 100));
+                assert(ConnectionPool_percentile(&stats.holdTime, 100) == stats.holdTime.max);
+                assert(stats.pingTime.count == 2); // The initial connections are validated on borrow
+                assert(stats.validationFailed == 0);
+                PoolHistogram_T empty = {0};
+                assert(ConnectionPool_percentile(&empty, 99) == 0);
+                char *text = ConnectionPool_exportStatistics(pool, "pool=\"test\"");
+                assert(Str_startsWith(text, "# HELP zdb_pool_connections"));
+                assert(strstr(text, "zdb_pool_borrowed_total{pool=\"test\"} 3\n"));
+                assert(strstr(text, "zdb_pool_hold_seconds_bucket{pool=\"test\",le=\"+Inf\"} 3\n"));
+                assert(strstr(text, "zdb_pool_hold_seconds_count{pool=\"test\"} 3\n"));
+                free(text);
+                // Not collected when turned off, the gauges are still current
+                ConnectionPool_setCollectStatistics(pool, false);
+                cons[0] = ConnectionPool_getConnection(pool);
+                ConnectionPool_getStatistics(pool, &stats);
+                assert(stats.borrowed == 3);
+                assert(stats.active == 1);
+                Connection_close(cons[0]);
+                ConnectionPool_stop(pool);
+                ConnectionPool_free(&pool);
+                assert(pool==NULL);
+                URL_free(&url);
+        }
+        printf("=> Test19: OK\n\n");
+
+        printf("=> Test20: Autoscale\n");
+        {
+                Connection_T cons[2];
+                url = URL_new(testURL);
+                pool = ConnectionPool_new(url);
+                assert(pool);
+                ConnectionPool_setInitialConnections(pool, 2);
+                ConnectionPool_setMaxConnections(pool, 2);
+                ConnectionPool_setAutoscale(pool, 2, 8);
+                assert(ConnectionPool_getAutoscale(pool));
+                assert(ConnectionPool_getAutoscaleWait(pool) == 10);
+                assert(ConnectionPool_getMaxConnections(pool) == 2);
+                ConnectionPool_setReaper(pool, 1);
+                ConnectionPool_start(pool);
+                Time_usleep(200000);
+                for (int i = 0; i < 2; i++)
+                        cons[i] = ConnectionPool_getConnection(pool);
+                assert(ConnectionPool_getConnection(pool) == NULL);
+                printf("Please wait for the pool to grow and shrink back..");
+                fflush(stdout);
+                for (int i = 0; i < 30 && ConnectionPool_getMaxConnections(pool) == 2; i++)
+                        Time_usleep(100000);
+                assert(ConnectionPool_getMaxConnections(pool) == 3);
+                Connection_T con = ConnectionPool_getConnection(pool);
+                assert(con);
+                Connection_close(con);
+                for (int i = 0; i < 2; i++)
+                        Connection_close(cons[i]);
+                for (int i = 0; i < 80 && ConnectionPool_getMaxConnections(pool) > 2; i++)
+                        Time_usleep(100000);
+                assert(ConnectionPool_getMaxConnections(pool) == 2);
+                for (int i = 0; i < 20 && ConnectionPool_size(pool) > 2; i++)
+                        Time_usleep(100000);
+                assert(ConnectionPool_size(pool) == 2);
+                printf("success\n");
+                ConnectionPool_stop(pool);
+                ConnectionPool_free(&pool);
+                assert(pool==NULL);
+                URL_free(&url);
+        }
+        printf("=> Test20: OK\n\n");
+
+        printf("=> Test21: Statement cache\n");
+        {
+                url = URL_new(testURL);
+                pool = ConnectionPool_new(url);
+                assert(pool);
+                ConnectionPool_setInitialConnections(pool, 1);
+                ConnectionPool_setMaxConnections(pool, 1);
+                ConnectionPool_setStatementCacheSize(pool, 2);
+                assert(ConnectionPool_getStatementCacheSize(pool) == 2);
+                ConnectionPool_start(pool);
+                Connection_T con = ConnectionPool_getConnection(pool);
+                PreparedStatement_T p1 = Connection_prepareStatement(con, "select %d", 1);
+                ResultSet_T r = PreparedStatement_executeQuery(p1);
+                assert(ResultSet_next(r));
+                Connection_close(con);
+                // The statement survives the return and is handed out again
+                con = ConnectionPool_getConnection(pool);
+                PreparedStatement_T p2 = Connection_prepareStatement(con, "select 1");
+                assert(p2 == p1);
+                assert(Connection_getStatementCacheHits(con) == 1);
+                assert(Connection_getStatementCacheMisses(con) == 1);
+                r = PreparedStatement_executeQuery(p2);
+                assert(ResultSet_next(r));
+                assert(ResultSet_getInt(r, 1) == 1);
+                // Already handed out in this borrow, a new statement is prepared
+                PreparedStatement_T p3 = Connection_prepareStatement(con, "select 1");
+                assert(p3 != p2);
+                assert(Connection_getStatementCacheMisses(con) == 2);
+                Connection_closeStatement(con, p3);
+                Connection_closeStatement(con, p2);
+                assert(Connection_prepareStatement(con, "select 1") == p1);
+                assert(Connection_getStatementCacheHits(con) == 2);
+                Connection_close(con);
+                // Fill the cache, "select 1" is least recently used and evicted
+                con = ConnectionPool_getConnection(pool);
+                Connection_prepareStatement(con, "select 2");
+                Connection_prepareStatement(con, "select 3");
+                Connection_close(con);
+                con = ConnectionPool_getConnection(pool);
+                long long hits = Connection_getStatementCacheHits(con);
+                Connection_prepareStatement(con, "select 3");
+                Connection_prepareStatement(con, "select 1");
+                assert(Connection_getStatementCacheHits(con) == hits + 1);
+                Connection_close(con);
+                ConnectionPool_stop(pool);
+                ConnectionPool_free(&pool);
+                assert(pool==NULL);
+                URL_free(&url);
+        }
+        printf("=> Test21: OK\n\n");
+
+        printf("=> Test22: Statement-affinity borrow\n");
+        {
+                Connection_T cons[3];
+                url = URL_new(testURL);
+                pool = ConnectionPool_new(url);
+                assert(pool);
+                ConnectionPool_setInitialConnections(pool, 3);
+                ConnectionPool_setStatementCacheSize(pool, 4);
+                ConnectionPool_start(pool);
+                for (int i = 0; i < 3; i++)
+                        cons[i] = ConnectionPool_getConnection(pool);
+                Connection_prepareStatement(cons[1], "select 22");
+                for (int i = 0; i < 3; i++)
+                        Connection_close(cons[i]);
+                // LIFO hands out cons[2] first, the statement brings back cons[1]
+                Connection_T con = ConnectionPool_getConnectionFor(pool, "select 22");
+                assert(con == cons[1]);
+                long long hits = Connection_getStatementCacheHits(con);
+                Connection_prepareStatement(con, "select 22");
+                assert(Connection_getStatementCacheHits(con) == hits + 1);
+                // No idle Connection has the statement, any is handed out
+                Connection_T other = ConnectionPool_getConnectionFor(pool, "select 23");
+                assert(other == cons[2]);
+                Connection_close(other);
+                Connection_close(con);
+                ConnectionPool_stop(pool);
+                ConnectionPool_free(&pool);
+                assert(pool==NULL);
+                URL_free(&url);
+        }
+        printf("=> Test22: OK\n\n");
+
+        printf("=> Test23: Connection init statements\n");
+        {
+                url = URL_new(testURL);
+                pool = ConnectionPool_new(url);
+                assert(pool);
+                ConnectionPool_setInitialConnections(pool, 2);
+                ConnectionPool_setStatementCacheSize(pool, 4);
+                ConnectionPool_addInitStatement(pool, "create temporary table init_test(i integer)");
+                ConnectionPool_addInitStatement(pool, "insert into init_test values(42)");
+                ConnectionPool_addPreparedStatement(pool, "select i from init_test");
+                ConnectionPool_start(pool);
+                Connection_T con = ConnectionPool_getConnection(pool);
+                assert(con);
+                // The temporary table only exists if the init statements ran on this Connection
+                PreparedStatement_T p = Connection_prepareStatement(con, "select i from init_test");
+                assert(Connection_getStatementCacheHits(con) == 1);
+                assert(Connection_getStatementCacheMisses(con) == 1); // The warm-up prepare
+                ResultSet_T r = PreparedStatement_executeQuery(p);
+                assert(ResultSet_next(r));
+                assert(ResultSet_getInt(r, 1) == 42);
+                Connection_close(con);
+                ConnectionPool_stop(pool);
+                ConnectionPool_free(&pool);
+                assert(pool==NULL);
+                // A failing init statement fails the connect
+                pool = ConnectionPool_new(url);
+                ConnectionPool_addInitStatement(pool, "no such statement");
+                TRY
+                {
+                        ConnectionPool_start(pool);
+                        assert(false); // Should not come here
+                }
+                CATCH(SQLException)
+                {
+                        assert(Str_startsWith(Exception_frame.message, "Failed to start connection pool -- Failed to initialize connection"));
+                }
+                END_TRY;
+                ConnectionPool_free(&pool);
+                URL_free(&url);
+        }
+        printf("=> Test23: OK\n\n");
+
+        printf("=> Test24: Batch\n");
+        {
+                int size;
+                char buf[32];
+                const long long *counts;
+                url = URL_new(testURL);
+                pool = ConnectionPool_new(url);
+                assert(pool);
+                ConnectionPool_start(pool);
+                Connection_T con = ConnectionPool_getConnection(pool);
+                Connection_execute(con, "create temporary table batch_test(i integer primary key, s varchar(255))");
+                PreparedStatement_T p = Connection_prepareStatement(con, "insert into batch_test values(?, ?)");
+                for (int i = 0; i < 100; i++) {
+                        // Values are copied, so buf can be reused for every row
+                        snprintf(buf, sizeof(buf), "row %d", i);
+                        PreparedStatement_setInt(p, 1, i);
+                        PreparedStatement_setString(p, 2, (i % 10) ? buf : NULL);
+                        PreparedStatement_addBatch(p);
+                }
+                assert(PreparedStatement_getBatchSize(p) == 100);
+                counts = PreparedStatement_executeBatch(p, &size);
+                assert(size == 100);
+                for (int i = 0; i < size; i++)
+                        assert(counts[i] == 1 || counts[i] == BATCH_SUCCESS_NO_INFO);
+                assert(PreparedStatement_getBatchSize(p) == 0);
+                ResultSet_T r = Connection_executeQuery(con, "select count(*), count(s) from batch_test");
+                assert(ResultSet_next(r));
+                assert(ResultSet_getInt(r, 1) == 100);
+                assert(ResultSet_getInt(r, 2) == 90);
+                r = Connection_executeQuery(con, "select s from batch_test where i = 7");
+                assert(ResultSet_next(r));
+                assert(Str_isEqual(ResultSet_getString(r, 1), "row 7"));
+                // The parameters are NULL after the batch, not the released values of the last row
+                PreparedStatement_setInt(p, 1, 100);
+                PreparedStatement_execute(p);
+                r = Connection_executeQuery(con, "select s from batch_test where i = 100");
+                assert(ResultSet_next(r));
+                assert(ResultSet_isnull(r, 1));
+                Connection_execute(con, "delete from batch_test where i = 100");
+                // Per-row update counts
+                p = Connection_prepareStatement(con, "update batch_test set s = ? where i >= ?");
+                PreparedStatement_setString(p, 1, "updated");
+                PreparedStatement_setInt(p, 2, 95);
+                PreparedStatement_addBatch(p);
+                PreparedStatement_setInt(p, 2, 99);
+                PreparedStatement_addBatch(p);
+                counts = PreparedStatement_executeBatch(p, &size);
+                assert(size == 2);
+                assert(counts[0] == 5);
+                assert(counts[1] == 1);
+                // A failing row throws and the batch is cleared
+                p = Connection_prepareStatement(con, "insert into batch_test values(?, ?)");
+                PreparedStatement_setString(p, 2, "dup");
+                for (int i = 200; i > 0; i -= 100) {
+                        PreparedStatement_setInt(p, 1, i);
+                        PreparedStatement_addBatch(p);
+                }
+                PreparedStatement_setInt(p, 1, 1);
+                PreparedStatement_addBatch(p);
+                TRY
+                {
+                        PreparedStatement_executeBatch(p, &size);
+                        assert(false); // Should not come here
+                }
+                CATCH(SQLException)
+                {
+                        assert(PreparedStatement_getBatchSize(p) == 0);
+                }
+                END_TRY;
+                r = Connection_executeQuery(con, "select count(*) from batch_test");
+                assert(ResultSet_next(r));
+                assert(ResultSet_getInt(r, 1) == 100);
+                // A batch joins the caller's transaction
+                Connection_beginTransaction(con);
+                PreparedStatement_setInt(p, 1, 300);
+                PreparedStatement_setString(p, 2, "rolled back");
+                PreparedStatement_addBatch(p);
+                PreparedStatement_executeBatch(p, &size);
+                assert(size == 1);
+                Connection_rollback(con);
+                r = Connection_executeQuery(con, "select count(*) from batch_test");
+                assert(ResultSet_next(r));
+                assert(ResultSet_getInt(r, 1) == 100);
+                Connection_close(con);
+                ConnectionPool_stop(pool);
+                ConnectionPool_free(&pool);
+                assert(pool==NULL);
+                URL_free(&url);
+        }
+        printf("=> Test24: OK\n\n");
+
+        printf("=> Test25: Pipeline mode\n");
+        {
+                url = URL_new(testURL);
+                pool = ConnectionPool_new(url);
+                assert(pool);
+                ConnectionPool_start(pool);
+                Connection_T con = ConnectionPool_getConnection(pool);
+                if (Str_startsWith(testURL, "postgresql")) {
+                        Connection_execute(con, "create temporary table pipeline_test(i integer primary key)");
+                        PreparedStatement_T p = Connection_prepareStatement(con, "insert into pipeline_test values(?)");
+                        Connection_beginPipeline(con);
+                        assert(Connection_isInPipeline(con));
+                        Connection_beginTransaction(con);
+                        for (int i = 0; i < 10; i++) {
+                                PreparedStatement_setInt(p, 1, i);
+                                PreparedStatement_execute(p);
+                        }
+                        Connection_execute(con, "update pipeline_test set i = i + 100 where i < 5");
+                        Connection_commit(con);
+                        Connection_syncPipeline(con);
+                        assert(Connection_rowsChanged(con) == 0); // COMMIT was the last statement
+                        // A failing statement skips the rest and rolls back the transaction
+                        Connection_beginTransaction(con);
+                        PreparedStatement_setInt(p, 1, 1000);
+                        PreparedStatement_execute(p);
+                        PreparedStatement_setInt(p, 1, 100);
+                        PreparedStatement_execute(p);
+                        Connection_commit(con);
+                        TRY
+                        {
+                                Connection_endPipeline(con);
+                                assert(false); // Should not come here
+                        }
+                        CATCH(SQLException)
+                        {
+                                assert(! Connection_isInPipeline(con));
+                        }
+                        END_TRY;
+                        ResultSet_T r = Connection_executeQuery(con, "select count(*), max(i) from pipeline_test");
+                        assert(ResultSet_next(r));
+                        assert(ResultSet_getInt(r, 1) == 10);
+                        assert(ResultSet_getInt(r, 2) == 104);
+                } else {
+                        TRY
+                        {
+                                Connection_beginPipeline(con);
+                                assert(false); // Should not come here
+                        }
+                        CATCH(SQLException)
+                        {
+                                assert(Str_startsWith(Exception_frame.message, "Pipeline mode is not supported"));
+                        }
+                        END_TRY;
+                        assert(! Connection_isInPipeline(con));
+                }
+                Connection_close(con);
+                ConnectionPool_stop(pool);
+                ConnectionPool_free(&pool);
+                assert(pool==NULL);
+                URL_free(&url);
+        }
+        printf("=> Test25: OK\n\n");
+
+        printf("=> Test26: COPY\n");
+        {
+                url = URL_new(testURL);
+                pool = ConnectionPool_new(url);
+                assert(pool);
+                ConnectionPool_start(pool);
+                Connection_T con = ConnectionPool_getConnection(pool);
+                if (Str_startsWith(testURL, "postgresql")) {
+                        char row[64];
+                        Connection_execute(con, "create temporary table copy_test(i integer, s text)");
+                        Connection_copyIn(con, "COPY copy_test(i, s) FROM STDIN");
+                        for (int i = 0; i < 1000; i++) {
+                                int n = snprintf(row, sizeof(row), "%d\trow %d\n", i, i);
+                                Connection_putCopyData(con, row, n);
+                        }
+                        assert(Connection_endCopyIn(con) == 1000);
+                        // Malformed data fails the COPY and nothing is copied
+                        Connection_copyIn(con, "COPY copy_test(i, s) FROM STDIN");
+                        Connection_putCopyData(con, "x\ty\n", 4);
+                        TRY
+                        {
+                                Connection_endCopyIn(con);
+                                assert(false); // Should not come here
+                        }
+                        CATCH(SQLException)
+                        {
+                                assert(Exception_frame.message[0]);
+                        }
+                        END_TRY;
+                        // An aborted COPY is rolled back
+                        Connection_copyIn(con, "COPY copy_test(i, s) FROM STDIN");
+                        Connection_putCopyData(con, "1\tabort\n", 8);
+                        Connection_abortCopyIn(con, "aborted");
+                        int size, rows = 0;
+                        const void *data;
+                        Connection_copyOut(con, "COPY (SELECT i, s FROM copy_test ORDER BY i) TO STDOUT");
+                        while ((data = Connection_getCopyData(con, &size))) {
+                                int n = snprintf(row, sizeof(row), "%d\trow %d\n", rows, rows);
+                                assert(size == n);
+                                assert(memcmp(data, row, size) == 0);
+                                rows++;
+                        }
+                        assert(size == 0);
+                        assert(rows == 1000);
+                        assert(Connection_rowsChanged(con) == 1000);
+                        // Binary format round trip
+                        Connection_execute(con, "create temporary table copy_test2(i integer, s text)");
+                        int length = 0;
+                        char *binary = NULL;
+                        Connection_copyOut(con, "COPY copy_test TO STDOUT (FORMAT binary)");
+                        while ((data = Connection_getCopyData(con, &size))) {
+                                binary = realloc(binary, length + size);
+                                memcpy(binary + length, data, size);
+                                length += size;
+                        }
+                        assert(memcmp(binary, "PGCOPY\n\377\r\n\0", 11) == 0);
+                        Connection_copyIn(con, "COPY copy_test2 FROM STDIN (FORMAT binary)");
+                        for (int i = 0; i < length; i += 100)
+                                Connection_putCopyData(con, binary + i, length - i < 100 ? length - i : 100);
+                        assert(Connection_endCopyIn(con) == 1000);
+                        free(binary);
+                        ResultSet_T r = Connection_executeQuery(con, "select count(*) from copy_test2 where s = 'row ' || i");
+                        assert(ResultSet_next(r));
+                        assert(ResultSet_getInt(r, 1) == 1000);
+                        // A COPY left open is ended when the Connection is returned
+                        Connection_copyOut(con, "COPY copy_test TO STDOUT");
+                } else {
+                        TRY
+                        {
+                                Connection_copyIn(con, "COPY x FROM STDIN");
+                                assert(false); // Should not come here
+                        }
+                        CATCH(SQLException)
+                        {
+                                assert(Str_startsWith(Exception_frame.message, "COPY is not supported"));
+                        }
+                        END_TRY;
+                }
+                Connection_close(con);
+                ConnectionPool_stop(pool);
+                ConnectionPool_free(&pool);
+                assert(pool==NULL);
+                URL_free(&url);
+        }
+        printf("=> Test26: OK\n\n");
+
+        printf("=> Test27: Fetch size\n");
+        {
+                url = URL_new(testURL);
+                pool = ConnectionPool_new(url);
+                assert(pool);
+                ConnectionPool_start(pool);
+                Connection_T con = ConnectionPool_getConnection(pool);
+                int rows = 0;
+                Connection_execute(con, "create table zild_fetch(i integer)");
+                PreparedStatement_T p = Connection_prepareStatement(con, "insert into zild_fetch values(?)");
+                for (int i = 0; i < 100; i++) {
+                        PreparedStatement_setInt(p, 1, i);
+                        PreparedStatement_addBatch(p);
+                }
+                PreparedStatement_executeBatch(p, &rows);
+                Connection_setDefaultRowPrefetch(con, 10);
+                assert(Connection_getDefaultRowPrefetch(con) == 10);
+                ResultSet_T r = Connection_executeQuery(con, "select i from zild_fetch order by i");
+                ResultSet_setFetchSize(r, 20);
+                assert(ResultSet_getColumnCount(r) == 1);
+                rows = 0;
+                while (ResultSet_next(r))
+                        assert(ResultSet_getInt(r, 1) == rows++);
+                assert(rows == 100);
+                // A ResultSet which is not read to the end is closed by the next statement
+                r = Connection_executeQuery(con, "select i from zild_fetch order by i");
+                assert(ResultSet_next(r));
+                r = Connection_executeQuery(con, "select count(*) from zild_fetch where i > 1000");
+                assert(ResultSet_next(r));
+                assert(ResultSet_getInt(r, 1) == 0);
+                assert(! ResultSet_next(r));
+                p = Connection_prepareStatement(con, "select i from zild_fetch where i >= ? order by i");
+                PreparedStatement_setFetchSize(p, 1);
+                assert(PreparedStatement_getFetchSize(p) == 1);
+                PreparedStatement_setInt(p, 1, 50);
+                r = PreparedStatement_executeQuery(p);
+                for (rows = 0; ResultSet_next(r); rows++)
+                        assert(ResultSet_getInt(r, 1) == 50 + rows);
+                assert(rows == 50);
+                Connection_setMaxRows(con, 5);
+                r = Connection_executeQuery(con, "select i from zild_fetch");
+                for (rows = 0; ResultSet_next(r); rows++) ;
+                assert(rows == 5);
+                // An empty result
+                PreparedStatement_setInt(p, 1, 1000);
+                r = PreparedStatement_executeQuery(p);
+                assert(! ResultSet_next(r));
+                TRY
+                {
+                        Connection_executeQuery(con, "select no_such_column from zild_fetch");
+                        assert(false); // Should not come here
+                }
+                CATCH(SQLException)
+                {
+                        assert(Exception_frame.message[0]);
+                }
+                END_TRY;
+                // A ResultSet left open is closed when the Connection is returned
+                r = Connection_executeQuery(con, "select i from zild_fetch");
+                assert(ResultSet_next(r));
+                Connection_close(con);
+                con = ConnectionPool_getConnection(pool);
+                assert(Connection_getDefaultRowPrefetch(con) == 0);
+                Connection_execute(con, "drop table zild_fetch");
+                Connection_close(con);
+                ConnectionPool_stop(pool);
+                ConnectionPool_free(&pool);
+                assert(pool==NULL);
+                URL_free(&url);
+        }
+        printf("=> Test27: OK\n\n");
+
+        printf("=> Test28: Typed column values\n");
+        {
+                // On PostgreSQL the result is requested in binary format
+                char *typedURL = Str_startsWith(testURL, "postgresql") ? Str_cat("%s%sbinary-result=true", testURL, strchr(testURL, '?') ? "&" : "?") : Str_dup(testURL);
+                url = URL_new(typedURL);
+                pool = ConnectionPool_new(url);
+                assert(pool);
+                ConnectionPool_start(pool);
+                Connection_T con = ConnectionPool_getConnection(pool);
+                if (Str_startsWith(testURL, "postgresql"))
+                        Connection_execute(con, "create table zild_typed(i integer, l bigint, d float8, n numeric(12,4), s varchar(32), ts timestamptz, b bytea)");
+                else if (Str_startsWith(testURL, "oracle"))
+                        Connection_execute(con, "create table zild_typed(i number(10), l number(19), d binary_double, n number(12,4), s varchar2(32), ts timestamp, b blob)");
+                else
+                        Connection_execute(con, "create table zild_typed(i integer, l bigint, d double precision, n numeric(12,4), s varchar(32), ts timestamp, b blob)");
+                PreparedStatement_T p = Connection_prepareStatement(con, "insert into zild_typed values(?, ?, ?, ?, ?, ?, ?)");
+                PreparedStatement_setInt(p, 1, -42);
+                PreparedStatement_setLLong(p, 2, 9000000000LL);
+                PreparedStatement_setDouble(p, 3, 3.25);
+                PreparedStatement_setString(p, 4, "-12345.678");
+                PreparedStatement_setString(p, 5, "typed");
+                PreparedStatement_setTimestamp(p, 6, 1387066378);
+                PreparedStatement_setBlob(p, 7, "\0\1\2", 3);
+                PreparedStatement_execute(p);
+                for (int i = 1; i <= 7; i++)
+                        PreparedStatement_setString(p, i, NULL);
+                PreparedStatement_execute(p);
+                ResultSet_T r = Connection_executeQuery(con, "select i, l, d, n, s, ts, b from zild_typed where i is not null");
+                assert(ResultSet_next(r));
+                assert(ResultSet_getInt(r, 1) == -42);
+                assert(ResultSet_getLLong(r, 1) == -42);
+                assert(Str_isEqual(ResultSet_getString(r, 1), "-42"));
+                assert(ResultSet_getLLong(r, 2) == 9000000000LL);
+                assert(ResultSet_getDouble(r, 2) == 9000000000.0);
+                TRY
+                {
+                        ResultSet_getInt(r, 2);
+                        assert(false); // Should not come here
+                }
+                CATCH(SQLException)
+                {
+                        assert(Exception_frame.message[0]);
+                }
+                END_TRY;
+                assert(ResultSet_getDouble(r, 3) == 3.25);
+                assert(ResultSet_getDouble(r, 4) == -12345.678);
+                assert(Str_isEqual(ResultSet_getString(r, 5), "typed"));
+                assert(ResultSet_getTimestamp(r, 6) == 1387066378);
+                assert(ResultSet_getDateTime(r, 6).tm_year == 2013);
+                if (Str_startsWith(testURL, "postgresql"))
+                        assert(Str_isEqual(ResultSet_getString(r, 7), "\\x000102")); // Same as a text result
+                int size;
+                const void *blob = ResultSet_getBlob(r, 7, &size);
+                assert(size == 3 && memcmp(blob, "\0\1\2", 3) == 0);
+                assert(! ResultSet_next(r));
+                r = Connection_executeQuery(con, "select i, l, d, n, s, ts, b from zild_typed where i is null");
+                assert(ResultSet_next(r));
+                for (int i = 1; i <= 7; i++)
+                        assert(ResultSet_isnull(r, i));
+                assert(ResultSet_getInt(r, 1) == 0);
+                assert(ResultSet_getLLong(r, 2) == 0);
+                assert(ResultSet_getDouble(r, 3) == 0.0);
+                assert(ResultSet_getTimestamp(r, 6) == 0);
+                assert(! ResultSet_next(r));
+                // Values bound to parameters of another numeric type, as text and, in a cached statement, binary on PostgreSQL
+                for (int cache = 0; cache <= 4; cache += 4) {
+                        ConnectionPool_setStatementCacheSize(pool, cache);
+                        Connection_execute(con, "delete from zild_typed");
+                        p = Connection_prepareStatement(con, "insert into zild_typed(i, l, d) values(?, ?, ?)");
+                        PreparedStatement_setLLong(p, 1, 7);
+                        PreparedStatement_setInt(p, 2, -7);
+                        PreparedStatement_setInt(p, 3, 7);
+                        PreparedStatement_execute(p);
+                        r = Connection_executeQuery(con, "select i, l, d from zild_typed");
+                        assert(ResultSet_next(r));
+                        assert(ResultSet_getInt(r, 1) == 7);
+                        assert(ResultSet_getLLong(r, 2) == -7);
+                        assert(ResultSet_getDouble(r, 3) == 7.0);
+                }
+                Connection_execute(con, "drop table zild_typed");
+                Connection_close(con);
+                ConnectionPool_stop(pool);
+                ConnectionPool_free(&pool);
+                assert(pool==NULL);
+                URL_free(&url);
+                FREE(typedURL);
+        }
+        printf("=> Test28: OK\n\n");
+
+        printf("=> Test29: One-shot parameterized execution\n");
+        {
+                url = URL_new(testURL);
+                pool = ConnectionPool_new(url);
+                assert(pool);
+                ConnectionPool_start(pool);
+                Connection_T con = ConnectionPool_getConnection(pool);
+                if (Str_startsWith(testURL, "postgresql"))
+                        Connection_execute(con, "create table zild_params(i integer, s varchar(32), b bytea)");
+                else if (Str_startsWith(testURL, "oracle"))
+                        Connection_execute(con, "create table zild_params(i number(10), s varchar2(32), b blob)");
+                else
+                        Connection_execute(con, "create table zild_params(i integer, s varchar(32), b blob)");
+                for (int i = 0; i < 10; i++) {
+                        Param_T params[] = {
+                                {.type = PARAM_INT, .value.integer = i},
+                                {.type = PARAM_STRING, .value.data = "it's a '?'"},
+                                {.type = PARAM_BLOB, .value.data = "a\0b", .size = 3}
+                        };
+                        assert(Connection_executeParams(con, "insert into zild_params values(?, ?, ?)", 3, params) == 1);
+                }
+                Param_T null[] = {{.type = PARAM_INT, .value.integer = 10}, {.type = PARAM_NULL}, {.type = PARAM_NULL}};
+                Connection_executeParams(con, "insert into zild_params values(?, ?, ?)", 3, null);
+                Param_T range[] = {{.type = PARAM_LLONG, .value.integer = 5}};
+                assert(Connection_executeParams(con, "update zild_params set i = i + 100 where i < ?", 1, range) == 5);
+                ResultSet_T r = Connection_executeQueryParams(con, "select i, s, b from zild_params where i >= ? order by i", 1, range);
+                for (int i = 5; i < 10; i++) {
+                        int size;
+                        assert(ResultSet_next(r));
+                        assert(ResultSet_getInt(r, 1) == i);
+                        assert(Str_isEqual(ResultSet_getString(r, 2), "it's a '?'"));
+                        const void *blob = ResultSet_getBlob(r, 3, &size);
+                        assert(size == 3 && memcmp(blob, "a\0b", 3) == 0);
+                }
+                assert(ResultSet_next(r));
+                assert(ResultSet_getInt(r, 1) == 10);
+                assert(ResultSet_isnull(r, 2) && ResultSet_isnull(r, 3));
+                // The result stays valid until the next statement on the Connection
+                Connection_execute(con, "delete from zild_params where i >= 100");
+                r = Connection_executeQueryParams(con, "select count(*) from zild_params", 0, NULL);
+                assert(ResultSet_next(r) && ResultSet_getInt(r, 1) == 6);
+                TRY
+                {
+                        Connection_executeParams(con, "delete from zild_params where i = ? and s = ?", 1, range);
+                        assert(false); // Should not come here
+                }
+                CATCH(SQLException)
+                {
+                        assert(Exception_frame.message[0]);
+                }
+                END_TRY;
+                Connection_execute(con, "drop table zild_params");
+                Connection_close(con);
+                ConnectionPool_stop(pool);
+                ConnectionPool_free(&pool);
+                assert(pool==NULL);
+                URL_free(&url);
+        }
+        printf("=> Test29: OK\n\n");
+
+        printf("=> Test30: Column name index\n");
+        {
+                url = URL_new(testURL);
+                pool = ConnectionPool_new(url);
+                assert(pool);
+                ConnectionPool_start(pool);
+                Connection_T con = ConnectionPool_getConnection(pool);
+                Connection_execute(con, "create table zild_index(a integer, b varchar(8), c integer)");
+                Connection_execute(con, "insert into zild_index values(1, 'one', 10)");
+                PreparedStatement_T p = Connection_prepareStatement(con, "select a, b, c from zild_index where a = ?");
+                // The index is built on the first lookup and kept across executions
+                for (int i = 0; i < 3; i++) {
+                        PreparedStatement_setInt(p, 1, 1);
+                        ResultSet_T r = PreparedStatement_executeQuery(p);
+                        assert(ResultSet_next(r));
+                        assert(ResultSet_getIntByName(r, "c") == 10);
+                        assert(Str_isEqual(ResultSet_getStringByName(r, "b"), "one"));
+                        assert(ResultSet_getIntByName(r, "a") == 1);
+                        TRY
+                        {
+                                ResultSet_getIntByName(r, "d");
+                                assert(false); // Should not come here
+                        }
+                        CATCH(SQLException)
+                        {
+                                assert(Str_startsWith(Exception_frame.message, "Invalid column name"));
+                        }
+                        END_TRY;
+                        assert(! ResultSet_next(r));
+                }
+                if (Str_startsWith(testURL, "sqlite")) {
+                        // SQLite prepares the statement again when the table changes, the kept index is rebuilt
+                        Connection_execute(con, "drop table zild_index");
+                        Connection_execute(con, "create table zild_index(c integer, a integer, b varchar(8))");
+                        Connection_execute(con, "insert into zild_index values(20, 2, 'two')");
+                        p = Connection_prepareStatement(con, "select * from zild_index");
+                        ResultSet_T r = PreparedStatement_executeQuery(p);
+                        assert(ResultSet_next(r) && ResultSet_getIntByName(r, "a") == 2);
+                        assert(! ResultSet_next(r));
+                        Connection_execute(con, "drop table zild_index");
+                        Connection_execute(con, "create table zild_index(b varchar(8), a integer, c integer)");
+                        Connection_execute(con, "insert into zild_index values('three', 3, 30)");
+                        r = PreparedStatement_executeQuery(p);
+                        assert(ResultSet_next(r));
+                        assert(ResultSet_getIntByName(r, "a") == 3);
+                        assert(ResultSet_getIntByName(r, "c") == 30);
+                        assert(Str_isEqual(ResultSet_getStringByName(r, "b"), "three"));
+                        assert(! ResultSet_next(r));
+                }
+                Connection_execute(con, "drop table zild_index");
+                Connection_close(con);
+                ConnectionPool_stop(pool);
+                ConnectionPool_free(&pool);
+                assert(pool==NULL);
+                URL_free(&url);
+        }
+        printf("=> Test30: OK\n\n");
+
+        printf("=> Test31: Oracle shared environment and session pool\n");
+        {
+                if (Str_startsWith(testURL, "oracle")) {
+                        char *sessionURL = Str_cat("%s%ssession-pool=true", testURL, strchr(testURL, '?') ? "&" : "?");
+                        const char *urls[] = {testURL, sessionURL};
+                        for (int i = 0; i < 2; i++) {
+                                Connection_T cons[3];
+                                url = URL_new(urls[i]);
+                                pool = ConnectionPool_new(url);
+                                assert(pool);
+                                ConnectionPool_setInitialConnections(pool, 3);
+                                ConnectionPool_setAbortHandler(pool, TabortHandler);
+                                ConnectionPool_start(pool);
+                                // The Connections share one OCI environment, the last one closed frees it
+                                for (int j = 0; j < 3; j++) {
+                                        cons[j] = ConnectionPool_getConnection(pool);
+                                        assert(cons[j]);
+                                        ResultSet_T r = Connection_executeQuery(cons[j], "select %d from dual", j);
+                                        assert(ResultSet_next(r));
+                                        assert(ResultSet_getInt(r, 1) == j);
+                                }
+                                // A statement that fails is still released, the Connection stays usable
+                                TRY
+                                {
+                                        Connection_execute(cons[0], "select from where");
+                                        assert(false); // Should not come here
+                                }
+                                CATCH(SQLException)
+                                {
+                                        assert(Exception_frame.message[0]);
+                                }
+                                END_TRY;
+                                assert(ResultSet_next(Connection_executeQuery(cons[0], "select 1 from dual")));
+                                // The same statement twice, the second is taken from the statement cache
+                                for (int j = 0; j < 2; j++) {
+                                        PreparedStatement_T p = Connection_prepareStatement(cons[1], "select count(*) from dual where 1 = ?");
+                                        PreparedStatement_setInt(p, 1, 1);
+                                        ResultSet_T r = PreparedStatement_executeQuery(p);
+                                        assert(ResultSet_next(r));
+                                        assert(ResultSet_getInt(r, 1) == 1);
+                                }
+                                for (int j = 0; j < 3; j++)
+                                        Connection_close(cons[j]);
+                                ConnectionPool_stop(pool);
+                                ConnectionPool_free(&pool);
+                                assert(pool==NULL);
+                                URL_free(&url);
+                                printf("\tResult: %s\n", i ? "sessions taken from an OCI session pool" : "connections share one OCI environment");
+                        }
+                        FREE(sessionURL);
+                } else {
+                        printf("\tResult: skipped, not an Oracle URL\n");
+                }
+        }
+        printf("=> Test31: OK\n\n");
+
 
         printf("============> Connection Pool Tests: OK\n\n");
 }